@@ -0,0 +1,226 @@
+/*
+ * Copyright 2016 Fermin, Yaneury <fermin.yaneury@gmail.com>
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+#include <cstddef>
+
+#include <Bitboard.hpp>
+#include <Protocol.hpp>
+#include <Zobrist.hpp>
+
+namespace Gungi
+{
+    class Game;
+    class Player;
+
+    constexpr size_t MAX_ACTIONS = 4096; /**< Upper bound of actions in a single position. */
+
+    /**
+     * Enum that stores the kind of an action.
+     */
+    enum class ActionType : SizeType
+    { None, Drop, Move, Immobile };
+
+    /**
+     * This struct holds a fully resolved action of the player to move. Unlike Move, which is
+     * relative to a piece and its orientation, an action's points are positive orientation
+     * board points with the tier already resolved, so it can be applied and undone without
+     * consulting move sets again.
+     * An immobile attack captures the enemy directly above or below the acting piece in its
+     * own tower: destination is the victim's point, the acting piece stays and the pieces
+     * above the victim descend a tier.
+     */
+    struct Action
+    {
+        /**
+         * This constructor instantiates a null action.
+         */
+        Action();
+
+        Action(const ActionType& type, const SizeType& index, const SmallPoint3& origin,
+                const SmallPoint3& destination, bool onOpponent);
+
+        ActionType type; /**< Kind of action. */
+        SizeType index; /**< Index of the acting piece in its player's piece set. */
+        SmallPoint3 origin; /**< Point the piece leaves, UBD_PT3 for drops. */
+        SmallPoint3 destination; /**< Point the piece lands on, or the immobile victim's. */
+        bool onOpponent; /**< True if the action captures an enemy piece. */
+    };
+
+    /**
+     * Two actions are equal if they move the same piece between the same points. The
+     * onOpponent flag is derived from the position and is not compared.
+     */
+    bool operator == (const Action& lhs, const Action& rhs);
+
+    bool operator != (const Action& lhs, const Action& rhs);
+
+    const Action NULL_ACTION; /**< A null action. */
+
+    /**
+     * This class is a fixed-capacity list of actions with a score slot per action for move
+     * ordering. It never allocates after construction.
+     */
+    class ActionList
+    {
+        public:
+
+            ActionList();
+
+            void clear();
+
+            void push(const Action& action);
+
+            size_t size() const;
+
+            bool empty() const;
+
+            Action& operator [] (const size_t& i);
+
+            const Action& operator [] (const size_t& i) const;
+
+            int32_t& scoreAt(const size_t& i);
+
+            /**
+             * This method swaps two actions along with their scores.
+             * @param i index of the first action
+             * @param j index of the second action
+             */
+            void swap(const size_t& i, const size_t& j);
+
+        private:
+            Action _actions[MAX_ACTIONS]; /**< Action storage. */
+            int32_t _scores[MAX_ACTIONS]; /**< Ordering score of each action. */
+            size_t _size; /**< Amount of actions in the list. */
+    };
+
+    /**
+     * This struct holds the legal running phase drop squares of every distinct kind in the
+     * hand of a player.
+     */
+    struct DropMasks
+    {
+        SizeType kindCt; /**< Amount of distinct kinds in hand. */
+        SizeType indices[2 * STD_PIECE_CT]; /**< Set index of a piece of each kind. */
+        Bitboard squares[2 * STD_PIECE_CT]; /**< Legal drop squares of each kind. */
+        SizeType tiers[BOARD_SQUARES]; /**< Tier a drop lands on, per square. */
+    };
+
+    /**
+     * This function returns true if the piece at pt3 is the top of its tower, the only
+     * piece of a tower that can move.
+     * @param board a game board
+     * @param pt3 a point holding a piece
+     * @return true if nothing stands above pt3
+     */
+    bool isTopAt(const Board& board, const SmallPoint3& pt3);
+
+    /**
+     * This function evaluates if the piece at origin can move onto target using its move
+     * set and tier, regardless of what stands on target.
+     * @param board a game board
+     * @param player the owner of the piece
+     * @param origin the point of the piece
+     * @param target the x,y pair to reach
+     * @return true if one of the piece's moves lands on target
+     */
+    bool canReach(const Board& board, const Player& player, const SmallPoint3& origin,
+            const SmallPoint2& target);
+
+    /**
+     * This function computes the drop squares of the player to move in one pass over the
+     * board: a kind may drop on the empty squares, or on top of an allied drop-stackable
+     * piece in a tower with a free tier, except Catapult and Fortress which are limited to
+     * the empty squares. It agrees with validRunningDrop square by square.
+     * @param game a game in the running phase
+     * @param masks an out parameter: the masks of each distinct kind in hand
+     */
+    void genDropMasks(const Game& game, DropMasks& masks);
+
+    /**
+     * This function generates the pseudo-legal actions of the player to move: moves of the
+     * top pieces of its towers during the running phase and drops from its hand, one per
+     * distinct kind in hand and square. Legality with respect to check is not tested, a
+     * game ends when a commander is captured.
+     * @param game a started game
+     * @param actions the list to fill: an out parameter, cleared first
+     */
+    void genActions(const Game& game, ActionList& actions);
+
+    /**
+     * This function generates the placement drops of the player to move. Identical pieces
+     * in hand produce identical positions, so each kind is dropped once per square.
+     * The soldier rule is a bit test against the player's soldier files.
+     * @param game a game in the placement phase
+     * @param actions the list to fill: an out parameter, cleared first
+     * @param mirror if true and the board is left-right symmetric, only drops on the left
+     * half and the center file are generated: the others lead to mirror images
+     */
+    void genPlacementActions(const Game& game, ActionList& actions, bool mirror = false);
+
+    /**
+     * This function returns true if the board is its own left-right mirror image.
+     * @param board a game board
+     * @return true if every tower matches the tower of the mirrored file
+     */
+    bool isMirrorSymmetric(const Board& board);
+
+    /**
+     * This function returns the smaller of the Zobrist keys of the position and of its
+     * left-right mirror image, so mirrored positions share a key.
+     * @param game a started game
+     * @return the canonical key of the position
+     */
+    Key canonicalKey(const Game& game);
+
+    /**
+     * This function generates the moves of the player to move during the running phase,
+     * leaving out drops.
+     * @param game a started game
+     * @param actions the list to fill: an out parameter, cleared first
+     */
+    void genMoveActions(const Game& game, ActionList& actions);
+
+    /**
+     * This function generates the immobile attacks of the player to move: every allied
+     * piece but a Catapult or Fortress attacks an enemy one tier above or below it in the
+     * same tower.
+     * @param game a started game
+     * @param actions the list to append to: an in-out parameter
+     */
+    void genImmobileAttacks(const Game& game, ActionList& actions);
+
+    /**
+     * This function generates the moves and immobile attacks of a single piece of the
+     * player to move.
+     * @param game a started game
+     * @param i index of the piece in the player's set
+     * @param actions the list to fill: an out parameter, cleared first
+     */
+    void genMoveActions(const Game& game, const SizeType& i, ActionList& actions);
+
+    /**
+     * This function generates only the actions of the player to move that capture: moves
+     * onto the top of an enemy tower and immobile attacks. Quiet moves and drops are never
+     * built, so this is much cheaper than filtering genActions.
+     * @param game a started game
+     * @param actions the list to fill: an out parameter, cleared first
+     * @see genActions
+     */
+    void genCaptures(const Game& game, ActionList& actions);
+}
@@ -0,0 +1,112 @@
+/*
+ * Copyright 2016 Fermin, Yaneury <fermin.yaneury@gmail.com>
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <PositionStore.hpp>
+
+/**
+ * Analytics are chunk-parallel scans of a position store. Each one reads only the columns it
+ * needs, every thread sums into its own part and the parts are merged once at the end.
+ */
+
+namespace Gungi
+{
+    /**
+     * This struct holds the material of the positions found at one ply.
+     */
+    struct MaterialPoint
+    {
+        uint64_t positions; /**< Positions at the ply. */
+        uint64_t material[2]; /**< Summed material of Black and White, board and hand. */
+    };
+
+    /**
+     * This struct points at the bitboard columns of one tier of a store chunk and decodes
+     * the pieces of its positions.
+     */
+    struct TierColumns
+    {
+        TierColumns(const PositionStore& store, const size_t& k, const SizeType& tier);
+
+        Bitboard occupied(const size_t& i) const;
+
+        Bitboard white(const size_t& i) const;
+
+        /**
+         * This method reads the piece code on a square of a position from the code planes.
+         * @param i a position of the chunk
+         * @param square an occupied square
+         * @return the active piece code
+         */
+        SizeType codeAt(const size_t& i, const uint32_t& square) const;
+
+        const uint64_t* lo[STORE_PLANES]; /**< Low words of every plane of the tier. */
+        const uint64_t* hi[STORE_PLANES]; /**< High words of every plane of the tier. */
+    };
+
+    /**
+     * This function returns the material value of an active piece code, its getHeadValue()
+     * or getTailValue().
+     * @param code an active piece code
+     * @return the rank value
+     */
+    SizeType codeValue(const SizeType& code);
+
+    /**
+     * This function counts the towers of every height over all the squares of all the
+     * positions of a store. It only reads the occupancy columns.
+     * @param store an open store
+     * @param counts an out parameter: squares holding a tower of each height, counts[0]
+     * being the empty squares
+     * @param threads amount of threads, 0 for one per core
+     */
+    void towerHeights(const PositionStore& store, uint64_t counts[BOARD_HEIGHT + 1],
+            SizeType threads = 0);
+
+    /**
+     * This function sums the material of both sides ply by ply. It reads the occupancy,
+     * color, piece code, hand and ply columns.
+     * @param store an open store
+     * @param curve an out parameter: a point per ply, up to the last stored ply
+     * @param threads amount of threads, 0 for one per core
+     */
+    void materialCurve(const PositionStore& store, std::vector<MaterialPoint>& curve,
+            SizeType threads = 0);
+
+    inline Bitboard TierColumns::occupied(const size_t& i) const
+    {
+        return Bitboard(lo[STORE_OCCUPIED][i], hi[STORE_OCCUPIED][i]);
+    }
+
+    inline Bitboard TierColumns::white(const size_t& i) const
+    {
+        return Bitboard(lo[STORE_WHITE][i], hi[STORE_WHITE][i]);
+    }
+
+    inline SizeType TierColumns::codeAt(const size_t& i, const uint32_t& square) const
+    {
+        const uint64_t* const* words = square < 64 ? lo : hi;
+        const uint32_t shift = square < 64 ? square : square - 64;
+        SizeType code = 0;
+        for (size_t b = 0; b < STORE_CODE_BITS; ++b)
+            code |= static_cast<SizeType>((words[STORE_CODE + b][i] >> shift) & 1) << b;
+        return code;
+    }
+}
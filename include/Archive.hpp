@@ -0,0 +1,162 @@
+/*
+ * Copyright 2016 Fermin, Yaneury <fermin.yaneury@gmail.com>
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <GameRecord.hpp>
+
+/**
+ * An archive stores games as the index of each ply in the ordered legal actions of its
+ * position (see orderActions), range coded with an adaptive model, so a ply costs about as
+ * many bits as it takes to tell the played action from the likely ones. While the phase can
+ * advance, index count stands for PHASE_CODE.
+ * Layout: uint32 magic ARCHIVE_MAGIC, uint32 version ARCHIVE_VERSION, then blocks, then
+ * the block index: per block a uint64 offset and a uint64 number of its first game, then
+ * a uint64 offset of the block index, a uint64 game count and a uint32 block count.
+ * A block is a uint32 game count, count + 1 uint32 game offsets relative to the end of the
+ * offsets, then the games. Games are coded independently of each other, so blocks and the
+ * games within them can be coded and decoded in parallel and read out of order.
+ * A game is a flags byte (1 if it starts from the standard start), the record header
+ * (uint64 id, uint32 time, uint16 plies, uint8 result, uint8 termination), the packed start
+ * position unless it is the standard one, then the coded plies. Integers are little endian.
+ */
+
+namespace Gungi
+{
+    constexpr uint32_t ARCHIVE_MAGIC      = 0x43524147; /**< "GARC", the archive magic. */
+    constexpr uint32_t ARCHIVE_VERSION    = 2; /**< Archive layout version. */
+    constexpr size_t ARCHIVE_BLOCK_GAMES  = 256; /**< Games per block. */
+
+    /**
+     * This function puts actions in the deterministic order plies are coded against:
+     * captures by decreasing gain, then every other action in generation order.
+     * @param game the position the actions were generated for
+     * @param actions the generated actions, reordered in place
+     */
+    void orderActions(const Game& game, ActionList& actions);
+
+    /**
+     * This function codes a recorded game and appends it to out.
+     * @param record a record
+     * @param out the buffer to append to
+     * @return false if the start position is invalid or a ply isn't legal
+     */
+    bool compressGame(const RecordView& record, std::vector<uint8_t>& out);
+
+    /**
+     * This function decodes a game coded by compressGame.
+     * @param data the coded game
+     * @param size the size of the coded game
+     * @param header an out parameter: the record header
+     * @param start an out parameter: the start position
+     * @param actions an out parameter: the action codes of the plies
+     * @return false if the game is malformed
+     */
+    bool expandGame(const uint8_t* data, const size_t& size, RecordHeader& header,
+            PackedPosition& start, std::vector<uint32_t>& actions);
+
+    /**
+     * This function codes every game of a record file into an archive, a block per thread
+     * at a time.
+     * @param records an open record file
+     * @param path path of the archive, overwritten
+     * @param threads amount of threads, 0 for one per core
+     * @return false if a game couldn't be coded or the archive couldn't be written
+     */
+    bool writeArchive(const GameRecordReader& records, const std::string& path,
+            SizeType threads = 0);
+
+    /**
+     * This class maps an archive and decodes its games on demand.
+     */
+    class ArchiveReader
+    {
+        public:
+
+            ArchiveReader();
+
+            /**
+             * This destructor unmaps the archive.
+             */
+            ~ArchiveReader();
+
+            ArchiveReader(const ArchiveReader&) = delete;
+            ArchiveReader& operator = (const ArchiveReader&) = delete;
+
+            /**
+             * This method maps an archive.
+             * @param path path of the archive
+             * @return false if the file couldn't be mapped or has a bad header or index
+             */
+            bool open(const std::string& path);
+
+            void close();
+
+            /**
+             * This method returns the amount of games.
+             * @return the amount of games
+             */
+            size_t size() const;
+
+            size_t blockCount() const;
+
+            /**
+             * This method returns the number of the first game of a block.
+             * @param b a block number, blockCount() for the end of the last block
+             * @return the number of the first game of the block
+             */
+            size_t blockStart(const size_t& b) const;
+
+            /**
+             * This method decodes a game, only its block is touched.
+             * @param i a game number below size()
+             * @param header an out parameter: the record header
+             * @param start an out parameter: the start position
+             * @param actions an out parameter: the action codes of the plies
+             * @return false if the game is malformed
+             */
+            bool game(const size_t& i, RecordHeader& header, PackedPosition& start,
+                    std::vector<uint32_t>& actions) const;
+
+        private:
+            /**
+             * This method finds a game in its block.
+             * @return false if the block is malformed
+             */
+            bool _locate(const size_t& i, const uint8_t*& data, size_t& size) const;
+
+            const uint8_t* _data; /**< Mapped archive. */
+            size_t _size; /**< Size of the archive. */
+            const uint8_t* _index; /**< Block index. */
+            size_t _blocks; /**< Amount of blocks. */
+            size_t _games; /**< Amount of games. */
+    };
+
+    /**
+     * This function decodes every game of an archive into a record file, a block per
+     * thread at a time.
+     * @param archive an open archive
+     * @param writer an open record writer
+     * @param threads amount of threads, 0 for one per core
+     * @return false if a game is malformed or couldn't be written
+     */
+    bool extractArchive(const ArchiveReader& archive, GameRecordWriter& writer,
+            SizeType threads = 0);
+}
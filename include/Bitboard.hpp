@@ -0,0 +1,200 @@
+/*
+ * Copyright 2016 Fermin, Yaneury <fermin.yaneury@gmail.com>
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+#pragma once
+
+#include <cstdint>
+
+namespace Gungi
+{
+    /**
+     * Bitboard is a set of the 81 squares of a tier, square = z * 9 + x as in squareOf.
+     * Squares 0 to 63 live in the low word, 64 to 80 in the low bits of the high word; the
+     * other high bits are always clear.
+     */
+    class Bitboard
+    {
+        public:
+
+            constexpr Bitboard();
+
+            constexpr Bitboard(const uint64_t& lo, const uint64_t& hi);
+
+            /**
+             * This method returns the set holding only the given square.
+             * @param square index in [0, 81)
+             * @return a set of one square
+             */
+            static constexpr Bitboard of(const uint32_t& square);
+
+            /**
+             * This method returns the set of all 81 squares.
+             * @return the full set
+             */
+            static constexpr Bitboard full();
+
+            bool test(const uint32_t& square) const;
+
+            void set(const uint32_t& square);
+
+            void clear(const uint32_t& square);
+
+            bool empty() const;
+
+            uint32_t count() const;
+
+            /**
+             * This method removes the lowest square of a non-empty set.
+             * @return the removed square
+             */
+            uint32_t popLowest();
+
+            Bitboard operator & (const Bitboard& rhs) const;
+            Bitboard operator | (const Bitboard& rhs) const;
+            Bitboard operator ^ (const Bitboard& rhs) const;
+
+            /**
+             * This operator returns the complement within the 81 squares.
+             * @return the squares not in the set
+             */
+            Bitboard operator ~ () const;
+
+            Bitboard& operator &= (const Bitboard& rhs);
+            Bitboard& operator |= (const Bitboard& rhs);
+            Bitboard& operator ^= (const Bitboard& rhs);
+
+            bool operator == (const Bitboard& rhs) const;
+            bool operator != (const Bitboard& rhs) const;
+
+            uint64_t lo; /**< Squares 0 to 63. */
+            uint64_t hi; /**< Squares 64 to 80. */
+    };
+
+    constexpr uint64_t BITBOARD_HI_MASK = (uint64_t(1) << 17) - 1; /**< Valid bits of hi. */
+
+    constexpr Bitboard::Bitboard()
+    : lo (0)
+    , hi (0)
+    {}
+
+    constexpr Bitboard::Bitboard(const uint64_t& lo, const uint64_t& hi)
+    : lo (lo)
+    , hi (hi)
+    {}
+
+    constexpr Bitboard Bitboard::of(const uint32_t& square)
+    {
+        return square < 64 ? Bitboard(uint64_t(1) << square, 0) :
+            Bitboard(0, uint64_t(1) << (square - 64));
+    }
+
+    constexpr Bitboard Bitboard::full()
+    {
+        return Bitboard(~uint64_t(0), BITBOARD_HI_MASK);
+    }
+
+    inline bool Bitboard::test(const uint32_t& square) const
+    {
+        return square < 64 ? (lo >> square) & 1 : (hi >> (square - 64)) & 1;
+    }
+
+    inline void Bitboard::set(const uint32_t& square)
+    {
+        *this |= of(square);
+    }
+
+    inline void Bitboard::clear(const uint32_t& square)
+    {
+        *this &= ~of(square);
+    }
+
+    inline bool Bitboard::empty() const
+    {
+        return (lo | hi) == 0;
+    }
+
+    inline uint32_t Bitboard::count() const
+    {
+        return static_cast<uint32_t>(__builtin_popcountll(lo) + __builtin_popcountll(hi));
+    }
+
+    inline uint32_t Bitboard::popLowest()
+    {
+        if (lo != 0)
+        {
+            const uint32_t square = static_cast<uint32_t>(__builtin_ctzll(lo));
+            lo &= lo - 1;
+            return square;
+        }
+
+        const uint32_t square = 64 + static_cast<uint32_t>(__builtin_ctzll(hi));
+        hi &= hi - 1;
+        return square;
+    }
+
+    inline Bitboard Bitboard::operator & (const Bitboard& rhs) const
+    {
+        return Bitboard(lo & rhs.lo, hi & rhs.hi);
+    }
+
+    inline Bitboard Bitboard::operator | (const Bitboard& rhs) const
+    {
+        return Bitboard(lo | rhs.lo, hi | rhs.hi);
+    }
+
+    inline Bitboard Bitboard::operator ^ (const Bitboard& rhs) const
+    {
+        return Bitboard(lo ^ rhs.lo, hi ^ rhs.hi);
+    }
+
+    inline Bitboard Bitboard::operator ~ () const
+    {
+        return Bitboard(~lo, ~hi & BITBOARD_HI_MASK);
+    }
+
+    inline Bitboard& Bitboard::operator &= (const Bitboard& rhs)
+    {
+        lo &= rhs.lo;
+        hi &= rhs.hi;
+        return *this;
+    }
+
+    inline Bitboard& Bitboard::operator |= (const Bitboard& rhs)
+    {
+        lo |= rhs.lo;
+        hi |= rhs.hi;
+        return *this;
+    }
+
+    inline Bitboard& Bitboard::operator ^= (const Bitboard& rhs)
+    {
+        lo ^= rhs.lo;
+        hi ^= rhs.hi;
+        return *this;
+    }
+
+    inline bool Bitboard::operator == (const Bitboard& rhs) const
+    {
+        return lo == rhs.lo && hi == rhs.hi;
+    }
+
+    inline bool Bitboard::operator != (const Bitboard& rhs) const
+    {
+        return !(*this == rhs);
+    }
+}
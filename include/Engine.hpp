@@ -17,10 +17,13 @@
 #pragma once
 
 #include <tuple>
+#include <vector>
 #include <algorithm>
 
 #include <Matrix.hpp>
 #include <Protocol.hpp>
+#include <Action.hpp>
+#include <Zobrist.hpp>
 
 /**
  * The control of evaluating good/bad moves should under the control of the game engine. The
@@ -32,7 +35,6 @@
  * Player remove method, can return a piece&& so that move-semantics can be applied during
  * transfer
  * Remove SmallPoint3 maneuvering where possible, the game should in two-dimensional manner.
- * Consider adding idle player *, since access to opponent is needed at times as well.
  */
 
 namespace Gungi
@@ -48,14 +50,61 @@ namespace Gungi
             Player(Board* gameBoard, const Color& color, const Color& oppColor, 
                     Orientation o);
 
+            /**
+             * This constructor copies a player onto another board. The board must already
+             * hold a copy of the other player's board, its entries are re-pointed to the
+             * copied pieces.
+             * @param other the player to copy
+             * @param gameBoard the board of the copy
+             */
+            Player(const Player& other, Board* gameBoard);
+
+            Player(const Player&) = delete;
+
             void drop(const SizeType& i, const SmallPoint3& pt3);
 
             void updatePoint(const SizeType& i, const SmallPoint3& pt3);
             
+            /**
+             * This method removes a piece that was captured off the board. Pieces after i
+             * shift down, so their board entries are re-pointed.
+             * @param i index of piece
+             */
             void remove(const SizeType& i);
 
+            /**
+             * This method reverses remove by inserting the piece back at i on the board.
+             * @param i index the piece had
+             * @param pc the piece
+             * @param pt3 the point the piece had
+             */
+            void insert(const SizeType& i, const Piece& pc, const SmallPoint3& pt3);
+
             void append(const Piece& pc);
 
+            /**
+             * This method reverses append by removing the last piece of the hand.
+             */
+            void pop();
+
+            /**
+             * This method reverses drop by taking the piece at i off the board and back
+             * into the hand.
+             * @param i index of piece
+             */
+            void lift(const SizeType& i);
+
+            /**
+             * This method replaces the player's set with the given pieces, dropping those
+             * on the board. The board entries of the old set must already be cleared and
+             * the capacity of the set must not be exceeded.
+             * @param pieces the pieces, in set order
+             * @param locations the location of each piece
+             * @param count the amount of pieces
+             * @see locationOf
+             */
+            void assign(const Piece* pieces, const uint16_t* locations, const SizeType& count);
+
             /**
              * This method accesses the player's piece set on a read-only basis.
              * @param i index of piece
@@ -112,11 +161,42 @@ namespace Gungi
              */
             const SizeType& numPieces() const;
 
+            /**
+             * This method returns the files holding at least one of the player's soldiers.
+             * The mask is kept up to date by drops, moves and captures.
+             * @return a 9-bit mask, bit x is set if file x holds a soldier of the player
+             */
+            const uint16_t& soldierFiles() const;
+
+            /**
+             * This method returns how many pieces of a kind the player has in hand.
+             * @param kind a hand kind
+             * @return the count of the kind in hand
+             * @see getHandKind
+             */
+            const SizeType& handCount(const SizeType& kind) const;
+
+            /**
+             * This method lists one hand piece per distinct kind in hand.
+             * @param indices an out parameter: set indices of the representatives, at least
+             * STD_PIECE_CT long
+             * @return the amount of distinct kinds
+             */
+            SizeType handKinds(SizeType* indices) const;
+
             SizeType getIndexAt(const SmallPoint3& pt3) const;
 
         private:
             void _nullifyIndex(const SizeType& i);
 
+            void _repoint(const SizeType& from);
+
+            /**
+             * This method counts the piece at i in or out of the soldier files, if it is a
+             * soldier on the board.
+             */
+            void _trackSoldier(const SizeType& i, bool add);
+
             PieceSet _pieces; /**< Player's piece set. */
             Board* _gameBoard; /**< Pointer to the game board. */
             const Color _color; /**< The color of the player. */
@@ -125,6 +205,24 @@ namespace Gungi
             SizeType _onBoard; /**< Amount of player's pieces on board. */
             SizeType _onHand; /**< Amount of player's pieces on hand. */
             SizeType _numPieces; /**< Amount of player's pieces total. */
+            uint16_t _soldierFiles; /**< Files holding a soldier of the player. */
+            SizeType _soldierCts[BOARD_WIDTH]; /**< Soldiers of the player per file. */
+            SizeType _handCts[HAND_KIND_CT]; /**< Pieces in hand per kind. */
+    };
+
+    constexpr SizeType MAX_SET_CT = 2 * STD_PIECE_CT; /**< Capacity of a player's set. */
+
+    /**
+     * This struct is a plain description of a position, what Game::setPosition loads. The
+     * pieces of a player show its color, [0] is Black and [1] is White.
+     */
+    struct Position
+    {
+        Phase phase;
+        Color toMove;
+        SizeType counts[2]; /**< Amount of pieces of each player. */
+        Piece pieces[2][MAX_SET_CT]; /**< Pieces of each player. */
+        uint16_t locations[2][MAX_SET_CT]; /**< Location of each piece, as in locationOf. */
     };
 
     /**
@@ -141,6 +239,15 @@ namespace Gungi
              */
             Game();
 
+            /**
+             * This constructor copies a game with its own board and players, so the copy
+             * can be made and unmade independently, e.g. by another thread.
+             * @param other the game to copy
+             */
+            Game(const Game& other);
+
+            Game& operator = (const Game&) = delete;
+
             /**
              * This destructor will set the current player pointer to nullptr.
              */
@@ -161,9 +268,43 @@ namespace Gungi
             IndexState drop(const SizeType& i, SmallPoint3 pt3);
 
             IndexState move(const SizeType& i, const Move& move);
+
+            /**
+             * This method makes piece i capture the enemy directly above or below it in its
+             * own tower. The pieces above the captured one descend a tier.
+             * @param i index of the attacking piece
+             * @param target the board point of the enemy, tier included
+             * @return the state of the attack, invalid if nothing was done
+             */
+            IndexState attack(const SizeType& i, const SmallPoint3& target);
     
             IndexState assessDrop(bool playerOne, const SizeType& i, SmallPoint3 pt3) const;
             IndexState assessMove(bool playerOne, const SizeType& i, const Move& move) const;
+            IndexState assessAttack(bool playerOne, const SizeType& i,
+                    const SmallPoint3& target) const;
+
+            /**
+             * This method replaces the whole game with the given position. The history is
+             * cleared and the winner is the holder of a captured commander, if any.
+             * @param position the position to load
+             * @return false, leaving the game untouched, if a count exceeds MAX_SET_CT, a
+             * piece doesn't show its player's color, is off the board or shares a point, or a
+             * tower has a gap
+             */
+            bool setPosition(const Position& position);
+
+            /**
+             * This method applies a generated action without validating it and records
+             * what is needed to undo it. Unlike move/drop, it never logs.
+             * @param action an action generated for the current position
+             * @see genActions
+             */
+            void make(const Action& action);
+
+            /**
+             * This method undoes the last action applied with make.
+             */
+            void unmake();
 
             const Board* gameBoard() const;
 
@@ -172,6 +313,46 @@ namespace Gungi
             const Player* playerTwo() const;
 
             const Player* currentPlayer() const;
+
+            /**
+             * This method returns the player that is not to move.
+             * @return the idle player, nullptr before the game is started
+             */
+            const Player* idlePlayer() const;
+
+            /**
+             * This method returns the color that captured the opposing commander.
+             * @return the winner's color, Color::None while the game is undecided
+             */
+            const Color& getWinner() const;
+
+            /**
+             * This method returns the Zobrist key of the position.
+             * @return the key of the board, hands and side to move
+             */
+            Key getKey() const;
+
+            /**
+             * This method returns how many times the current position occurred before. Only
+             * the reversible plies since the last drop or capture are scanned, no position
+             * before them can repeat.
+             * @return the count of earlier occurrences of the current position
+             */
+            uint16_t repetitions() const;
+
+            /**
+             * This method returns the count of plies since the last drop or capture.
+             * @return the count of consecutive reversible plies
+             */
+            uint16_t reversiblePlies() const;
+
+            /**
+             * This method returns the tower masks of the board, kept up to date by every
+             * method that changes the board.
+             * @return the tower masks of the board
+             */
+            const TowerMasks& towers() const;
+
             /**
              * This method will return the current phase of the game.
              * @return a const reference to the current phase of the game.
@@ -180,6 +361,20 @@ namespace Gungi
 
         private:
 
+            /**
+             * This struct holds what make needs to restore a position.
+             */
+            struct Undo
+            {
+                Action action;
+                Key boardKey;
+                Key handKey;
+                Color winner;
+                bool captured;
+                SizeType capturedIndex;
+                Piece capturedPiece;
+            };
+
             /**
              * This method will set the current player pointer to the other player.
              * @see _currentPlayer
@@ -195,11 +390,64 @@ namespace Gungi
 
             void _takeAndTransfer(const SizeType& i, const SmallPoint3& pt3);
 
+            /**
+             * This method computes the Zobrist keys from scratch.
+             */
+            void _computeKey();
+
+            /**
+             * This struct holds a position of the game history.
+             */
+            struct Ply
+            {
+                Key key; /**< Key of the position. */
+                uint16_t reversible; /**< Reversible plies that led to the position. */
+            };
+
+            /**
+             * This method pushes the current position on the history.
+             * @param reversible true if the action that led to it was neither a drop nor a
+             * capture
+             */
+            void _pushPly(bool reversible);
+
+            /**
+             * This method refreshes the tower masks of the squares an action touched.
+             */
+            void _refreshTowers(const Action& action);
+
+            /**
+             * This method moves the enemy piece at pt3 into the player's hand, flipped.
+             */
+            void _capture(Player* player, Player* opponent, const SmallPoint3& pt3,
+                    Undo& undo);
+
+            /**
+             * This method lowers every piece above the emptied pt3 by a tier.
+             */
+            void _collapse(SmallPoint3 pt3);
+
+            /**
+             * This method reverses _collapse, leaving pt3 empty.
+             */
+            void _uncollapse(const SmallPoint3& pt3);
+
+            /**
+             * This method returns the player whose set holds the piece, its active color's.
+             */
+            Player* _ownerOf(const Piece& piece);
+
             bool _onesTurn; /**< Flag indicating player one's turn. */
             Board _gameBoard; /**< The game board. */
             Player _one; /**< Player one. */
             Player _two; /**< Player two. */
             Phase _phase; /** Phase of the game. */
             Player* _currentPlayer; /**< Pointer to current player. */
+            Color _winner; /**< Color that captured a commander, if any. */
+            Key _boardKey; /**< Xor of piece keys and the side key. */
+            Key _handKey; /**< Sum of hand keys. */
+            TowerMasks _towers; /**< Kinds, tops and openness of every tower. */
+            std::vector<Undo> _history; /**< Undo records of make. */
+            std::vector<Ply> _plies; /**< Positions of the game, one per ply. */
     };
 }
@@ -0,0 +1,134 @@
+/*
+ * Copyright 2016 Fermin, Yaneury <fermin.yaneury@gmail.com>
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <GameRecord.hpp>
+
+/**
+ * An explorer table maps the key of every position reached in a set of records to how often
+ * it was reached, the results of the games that reached it and its most played actions.
+ * Layout: uint32 magic EXPLORER_MAGIC, uint32 version EXPLORER_VERSION, uint64 entry count,
+ * uint64 reserved, uint64 reserved, then the keys in increasing order (uint64 each), then
+ * one row per key: uint32 count, uint32 results indexed by Color (None counting drawn and
+ * unfinished games), then EXPLORER_ACTIONS pairs of uint32 action code and uint32 count,
+ * most played first, a zero code ending the list early. The header is little endian, keys
+ * and rows are in host order.
+ * Keys are kept apart from the rows so a search only touches the key pages.
+ */
+
+namespace Gungi
+{
+    constexpr uint32_t EXPLORER_MAGIC     = 0x50584547; /**< "GEXP", the table magic. */
+    constexpr uint32_t EXPLORER_VERSION   = 2; /**< Table layout version. */
+    constexpr size_t EXPLORER_ACTIONS     = 4; /**< Actions kept per position. */
+    constexpr size_t EXPLORER_SHARD_BITS  = 8; /**< Key bits choosing a shard. */
+
+    /**
+     * This struct holds what the table knows of a position.
+     */
+    struct ExplorerEntry
+    {
+        uint32_t count; /**< Times the position was reached. */
+        uint32_t results[3]; /**< Results of the games that reached it, indexed by Color. */
+        size_t actionCt; /**< Amount of actions listed. */
+        uint32_t actions[EXPLORER_ACTIONS]; /**< Action codes, most played first. */
+        uint32_t actionCounts[EXPLORER_ACTIONS]; /**< Times each action was played. */
+    };
+
+    /**
+     * This struct holds the totals of a table build.
+     */
+    struct ExplorerBuild
+    {
+        size_t games; /**< Amount of games read. */
+        size_t skipped; /**< Games dropped at a start or action that didn't decode. */
+        uint64_t positions; /**< Amount of positions counted, repeats included. */
+        uint64_t entries; /**< Amount of distinct positions written. */
+    };
+
+    /**
+     * This function builds a table from record files. Threads replay chunks of games and
+     * tally the positions of each chunk into hash tables sharded by the top key bits, so
+     * memory grows with the distinct positions and actions, 24 bytes each, not with the
+     * games. The shards are then sorted and folded a shard per thread, so they come out in
+     * key order and the build doesn't depend on the thread count.
+     * @param paths paths of record files
+     * @param path path of the table, overwritten
+     * @param build an out parameter: the totals
+     * @param threads amount of threads, 0 for one per core
+     * @return false if a record file couldn't be opened or the table couldn't be written
+     */
+    bool buildExplorer(const std::vector<std::string>& paths, const std::string& path,
+            ExplorerBuild& build, SizeType threads = 0);
+
+    /**
+     * This class maps a table and looks positions up by interpolation search, which the
+     * uniform spread of Zobrist keys makes take a handful of probes.
+     */
+    class Explorer
+    {
+        public:
+
+            Explorer();
+
+            /**
+             * This destructor unmaps the table.
+             */
+            ~Explorer();
+
+            Explorer(const Explorer&) = delete;
+            Explorer& operator = (const Explorer&) = delete;
+
+            /**
+             * This method maps a table.
+             * @param path path of the table
+             * @return false if the file couldn't be mapped or has a bad header or size
+             */
+            bool open(const std::string& path);
+
+            void close();
+
+            /**
+             * This method returns the amount of positions in the table.
+             * @return the amount of positions
+             */
+            uint64_t size() const;
+
+            /**
+             * This method looks a position up.
+             * @param key the key of the position
+             * @param entry an out parameter: the entry of the position
+             * @return false if the position isn't in the table
+             */
+            bool find(const Key& key, ExplorerEntry& entry) const;
+
+            bool find(const Game& game, ExplorerEntry& entry) const;
+
+        private:
+            Key _keyAt(const uint64_t& i) const;
+
+            const uint8_t* _data; /**< Mapped table. */
+            size_t _size; /**< Size of the table. */
+            const uint8_t* _keys; /**< Key column. */
+            const uint8_t* _rows; /**< Row column. */
+            uint64_t _count; /**< Amount of positions. */
+    };
+}
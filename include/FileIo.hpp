@@ -0,0 +1,116 @@
+/*
+ * Copyright 2016 Fermin, Yaneury <fermin.yaneury@gmail.com>
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * Helpers shared by the binary file formats: little endian integers and read-only file
+ * mappings.
+ */
+
+namespace Gungi
+{
+    inline void writeU16(uint8_t* out, const uint16_t& value)
+    {
+        out[0] = static_cast<uint8_t>(value);
+        out[1] = static_cast<uint8_t>(value >> 8);
+    }
+
+    inline uint16_t readU16(const uint8_t* in)
+    {
+        return static_cast<uint16_t>(in[0] | in[1] << 8);
+    }
+
+    inline void writeU32(uint8_t* out, const uint32_t& value)
+    {
+        for (size_t b = 0; b < 4; ++b)
+            out[b] = static_cast<uint8_t>(value >> (8 * b));
+    }
+
+    inline uint32_t readU32(const uint8_t* in)
+    {
+        return static_cast<uint32_t>(in[0]) | static_cast<uint32_t>(in[1]) << 8 |
+            static_cast<uint32_t>(in[2]) << 16 | static_cast<uint32_t>(in[3]) << 24;
+    }
+
+    inline void writeU64(uint8_t* out, const uint64_t& value)
+    {
+        writeU32(out, static_cast<uint32_t>(value));
+        writeU32(out + 4, static_cast<uint32_t>(value >> 32));
+    }
+
+    inline uint64_t readU64(const uint8_t* in)
+    {
+        return static_cast<uint64_t>(readU32(in)) |
+            static_cast<uint64_t>(readU32(in + 4)) << 32;
+    }
+
+    /**
+     * This function maps a whole file read-only.
+     * @param path path of the file
+     * @param size an out parameter: the size of the file
+     * @param minimum the smallest size accepted, at least 1
+     * @param advice the expected access pattern, an madvise advice
+     * @return the mapping, or nullptr if the file couldn't be mapped or is too small
+     */
+    inline const uint8_t* mapFile(const std::string& path, size_t& size,
+            const size_t& minimum = 1, const int& advice = MADV_NORMAL)
+    {
+        size = 0;
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return nullptr;
+
+        struct stat info;
+        if (::fstat(fd, &info) != 0 || info.st_size <= 0 ||
+                static_cast<size_t>(info.st_size) < minimum)
+        {
+            ::close(fd);
+            return nullptr;
+        }
+
+        const size_t length = static_cast<size_t>(info.st_size);
+        void* mapping = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (mapping == MAP_FAILED)
+            return nullptr;
+
+        if (advice != MADV_NORMAL)
+            ::madvise(mapping, length, advice);
+        size = length;
+        return static_cast<const uint8_t*>(mapping);
+    }
+
+    /**
+     * This function unmaps a mapping of mapFile.
+     * @param data the mapping, nullptr does nothing
+     * @param size the size of the mapping
+     */
+    inline void unmapFile(const uint8_t* data, const size_t& size)
+    {
+        if (data)
+            ::munmap(const_cast<uint8_t*>(data), size);
+    }
+}
@@ -0,0 +1,331 @@
+/*
+ * Copyright 2016 Fermin, Yaneury <fermin.yaneury@gmail.com>
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <Action.hpp>
+#include <Notation.hpp>
+
+/**
+ * A game record file starts with uint32 magic RECORD_MAGIC and uint32 version
+ * GAME_RECORD_VERSION, followed by records. A record is:
+ *   uint32 size of the rest of the record,
+ *   header: uint64 id, uint32 time, uint16 ply count, uint8 result (0 none, 1 black,
+ *   2 white), uint8 termination,
+ *   the packed start position (PACKED_SIZE bytes),
+ *   one uint32 action code per ply.
+ * Files are only ever appended to. The index file, the record path plus ".idx", holds the
+ * uint64 offset of every record and is appended to along with it. Integers are little
+ * endian.
+ *
+ * An action code doesn't depend on the order of the piece sets: type << 30 |
+ * destination << 21 | origin << 12 | onOpponent << 11 | state, the points being locations.
+ * A drop stores the packed state of the dropped piece and the in hand origin, a move or an
+ * immobile attack stores its origin and no state. PHASE_CODE, type None with both points in
+ * hand, stands for Game::start() advancing the phase, so a game can be logged from the
+ * start of the placement phase.
+ */
+
+namespace Gungi
+{
+    constexpr uint32_t RECORD_MAGIC       = 0x43455247; /**< "GREC", the record file magic. */
+    constexpr uint32_t GAME_RECORD_VERSION = 1; /**< Record file layout version. */
+    constexpr size_t RECORD_FILE_HEADER   = 8; /**< Bytes before the first record. */
+    constexpr size_t RECORD_HEADER_SIZE   = 16; /**< Bytes of a record header. */
+    /** Bytes of a record without its actions. */
+    constexpr size_t RECORD_FIXED_SIZE    = 4 + RECORD_HEADER_SIZE + PACKED_SIZE;
+    /** Action code of a phase advance. */
+    constexpr uint32_t PHASE_CODE         = static_cast<uint32_t>(LOCATION_IN_HAND) << 21 |
+        static_cast<uint32_t>(LOCATION_IN_HAND) << 12;
+
+    /**
+     * Enum that stores why a recorded game ended.
+     */
+    enum class Termination : uint8_t
+    { None, Commander, NoActions, Repetition, PlyLimit };
+
+    /**
+     * This struct holds the metadata of a recorded game.
+     */
+    struct RecordHeader
+    {
+        uint64_t id; /**< Caller-chosen game id. */
+        uint32_t time; /**< Seconds since the epoch the game ended at. */
+        uint16_t plies; /**< Amount of recorded actions. */
+        Color result; /**< Winner, Color::None for a draw or an unfinished game. */
+        Termination termination;
+    };
+
+    /**
+     * This function encodes an action of the player to move, see the layout above.
+     * @param game the game the action is about to be applied to
+     * @param action a generated action
+     * @return the action code
+     */
+    uint32_t encodeAction(const Game& game, const Action& action);
+
+    /**
+     * This function reverses encodeAction against the game the code was recorded in.
+     * @param game the game the action is about to be applied to
+     * @param code an action code
+     * @param action an out parameter: the action with the index of the acting piece
+     * @return false if the code is malformed or there is no piece to act in game
+     */
+    bool decodeAction(const Game& game, const uint32_t& code, Action& action);
+
+    /**
+     * This function returns true if the phase of a game can be advanced: it hasn't reached
+     * the running phase and nobody has won.
+     * @param game a game
+     * @return true if PHASE_CODE is legal in game
+     */
+    bool canAdvance(const Game& game);
+
+    /**
+     * This function applies an action code if it is one of the legal actions of the
+     * position or a legal phase advance.
+     * @param game the game to apply the code to
+     * @param code an action code
+     * @param actions scratch space for the generated actions
+     * @return false if the code isn't legal in game, which is then left unchanged
+     */
+    bool playCode(Game& game, const uint32_t& code, ActionList& actions);
+
+    /**
+     * This class collects a game as it is played: the start position, then each action
+     * before it is applied. A phase advance between two actions is recorded as PHASE_CODE.
+     */
+    class GameLog
+    {
+        public:
+
+            GameLog();
+
+            /**
+             * This method clears the log and records the start position.
+             * @param game the game at its start position
+             * @return false if the position couldn't be packed
+             */
+            bool begin(const Game& game);
+
+            /**
+             * This method records an action of the player to move, after a PHASE_CODE if
+             * the phase of game has advanced since the last record.
+             * @param game the game the action is about to be applied to
+             * @param action the action
+             */
+            void record(const Game& game, const Action& action);
+
+            const PackedPosition& start() const;
+
+            const std::vector<uint32_t>& actions() const;
+
+        private:
+            PackedPosition _start; /**< Packed start position. */
+            std::vector<uint32_t> _actions; /**< Action codes, one per ply. */
+            Phase _phase; /**< Phase of the game at the last record. */
+    };
+
+    /**
+     * This class appends records to a game record file and to its index.
+     */
+    class GameRecordWriter
+    {
+        public:
+
+            GameRecordWriter();
+
+            /**
+             * This destructor closes both files.
+             */
+            ~GameRecordWriter();
+
+            GameRecordWriter(const GameRecordWriter&) = delete;
+            GameRecordWriter& operator = (const GameRecordWriter&) = delete;
+
+            /**
+             * This method opens a record file for appending, writing the file header if
+             * the file is new. An index that doesn't reach the last record is rebuilt and a
+             * record torn by a crash is cut off.
+             * @param path path of the record file
+             * @return false if either file couldn't be opened or the existing file isn't a
+             * record file
+             */
+            bool open(const std::string& path);
+
+            /**
+             * This method appends a record.
+             * @param header the metadata, its ply count must match the actions
+             * @param start the packed start position
+             * @param actions the action codes
+             * @return false if the files couldn't be written
+             */
+            bool write(const RecordHeader& header, const PackedPosition& start,
+                    const uint32_t* actions);
+
+            /**
+             * This method appends the record of a log.
+             * @param header the metadata, its ply count is taken from the log
+             * @param log a log
+             * @return false if the files couldn't be written
+             */
+            bool write(RecordHeader header, const GameLog& log);
+
+            /**
+             * This method closes both files.
+             * @return false if buffered records couldn't be written
+             */
+            bool close();
+
+        private:
+            std::FILE* _records; /**< Record file. */
+            std::FILE* _index; /**< Index file. */
+            uint64_t _offset; /**< Offset of the next record. */
+    };
+
+    /**
+     * This class is a view of a record in a mapped file. It is valid while its reader is.
+     */
+    class RecordView
+    {
+        public:
+
+            explicit RecordView(const uint8_t* record);
+
+            RecordHeader header() const;
+
+            const PackedPosition& start() const;
+
+            /**
+             * This method returns the action code of a ply.
+             * @param ply a ply below the ply count
+             * @return the action code
+             */
+            uint32_t action(const uint16_t& ply) const;
+
+            /**
+             * This method returns the size of the record, its size field included.
+             * @return the size of the record in bytes
+             */
+            uint32_t size() const;
+
+        private:
+            const uint8_t* _record; /**< Start of the size field of the record. */
+    };
+
+    /**
+     * This class maps a game record file and iterates its records without copying them.
+     * The index file is mapped too if it matches the record file, otherwise the records
+     * are scanned once to build it in memory.
+     */
+    class GameRecordReader
+    {
+        public:
+
+            /**
+             * This class walks the records of a file in order.
+             */
+            class Iterator
+            {
+                public:
+
+                    Iterator(const uint8_t* at, const uint8_t* end);
+
+                    RecordView operator * () const;
+
+                    Iterator& operator ++ ();
+
+                    bool operator != (const Iterator& rhs) const;
+
+                private:
+                    const uint8_t* _at; /**< Current record. */
+                    const uint8_t* _end; /**< End of the mapped file. */
+            };
+
+            GameRecordReader();
+
+            /**
+             * This destructor unmaps the files.
+             */
+            ~GameRecordReader();
+
+            GameRecordReader(const GameRecordReader&) = delete;
+            GameRecordReader& operator = (const GameRecordReader&) = delete;
+
+            /**
+             * This method maps a record file and its index.
+             * @param path path of the record file
+             * @return false if the file couldn't be mapped or has a bad header or record
+             */
+            bool open(const std::string& path);
+
+            void close();
+
+            /**
+             * This method returns the amount of records.
+             * @return the amount of records
+             */
+            size_t size() const;
+
+            /**
+             * This method returns a record by its position in the file.
+             * @param i a record number below size()
+             * @return a view of the record
+             */
+            RecordView operator [] (const size_t& i) const;
+
+            Iterator begin() const;
+
+            Iterator end() const;
+
+        private:
+            const uint8_t* _data; /**< Mapped record file. */
+            size_t _size; /**< Size of the record file. */
+            const uint8_t* _indexData; /**< Mapped index file, null if it was rebuilt. */
+            size_t _indexSize; /**< Size of the mapped index file. */
+            std::vector<uint64_t> _offsets; /**< Offsets when the index file is unusable. */
+            size_t _count; /**< Amount of records. */
+    };
+
+    /**
+     * This struct names a run of records of one of several files.
+     */
+    struct RecordChunk
+    {
+        size_t file; /**< Number of the file in the list. */
+        size_t first; /**< Number of the first record in its file. */
+        size_t count; /**< Amount of records. */
+    };
+
+    /**
+     * This function opens record files and splits their records into chunks, the unit of
+     * work the batch tools hand their threads.
+     * @param paths paths of record files
+     * @param readers an out parameter: a reader per file
+     * @param chunks an out parameter: chunks of at most size records, file by file
+     * @param size records per chunk
+     * @return false if a file couldn't be opened
+     */
+    bool chunkRecords(const std::vector<std::string>& paths,
+            std::vector<std::unique_ptr<GameRecordReader>>& readers,
+            std::vector<RecordChunk>& chunks, const size_t& size);
+}
@@ -0,0 +1,102 @@
+/*
+ * Copyright 2016 Fermin, Yaneury <fermin.yaneury@gmail.com>
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <Archive.hpp>
+
+/**
+ * A heatmap counts, over every position of a set of games, how often each piece kind stands
+ * on each square of each tier and how the games of the positions ended for the owner of the
+ * piece. Squares are seen from the owner's side, White's board being rotated as it is for
+ * the network features, so both colors add to the same cells. The tower map counts how
+ * often each square holds a tower at least as high as each tier, on the board as it is.
+ */
+
+namespace Gungi
+{
+    constexpr size_t HEATMAP_CELLS    = PIECE_CODE_CT * BOARD_HEIGHT * BOARD_SQUARES;
+    constexpr size_t HEATMAP_TOWERS   = BOARD_HEIGHT * BOARD_SQUARES; /**< Tower cells. */
+
+    /**
+     * Enum that stores the outcome of a game for the owner of a piece.
+     */
+    enum class Outcome : uint8_t
+    { Win, Draw, Loss };
+
+    /**
+     * This function returns the number of a heatmap cell.
+     * @param code an active piece code
+     * @param tier a tier
+     * @param square a square on the tier, z * BOARD_WIDTH + x, seen from the owner's side
+     * @return the cell number
+     */
+    constexpr size_t heatmapCell(const size_t& code, const size_t& tier, const size_t& square)
+    {
+        return (code * BOARD_HEIGHT + tier) * BOARD_SQUARES + square;
+    }
+
+    /**
+     * This struct holds the counts of a heatmap.
+     */
+    struct Heatmap
+    {
+        Heatmap();
+
+        uint64_t games; /**< Amount of games counted. */
+        uint64_t skipped; /**< Games dropped at a start or action that didn't decode. */
+        uint64_t positions; /**< Amount of positions counted. */
+        uint64_t sides[3]; /**< Positions by outcome for each side, the baseline. */
+        std::vector<uint64_t> cells[3]; /**< Piece occurrences by outcome and cell. */
+        std::vector<uint64_t> towers; /**< Squares with a tower of at least tier + 1. */
+    };
+
+    /**
+     * This function returns the outcome of a game for a color.
+     * @param result the winner of the game, Color::None for a draw or no result
+     * @param owner Color::Black or Color::White
+     * @return the outcome
+     */
+    Outcome outcomeOf(const Color& result, const Color& owner);
+
+    /**
+     * This function adds a position to a heatmap.
+     * @param game a game
+     * @param result the winner of the game, Color::None for a draw or no result
+     * @param map the heatmap to add to
+     */
+    void addPosition(const Game& game, const Color& result, Heatmap& map);
+
+    /**
+     * This function adds the counts of a heatmap to another.
+     * @param part the heatmap to add
+     * @param map the heatmap to add to
+     */
+    void mergeHeatmap(const Heatmap& part, Heatmap& map);
+
+    /**
+     * This function counts every position of every game of an archive into a heatmap.
+     * Threads decode blocks of games into heatmaps of their own, which are merged at the
+     * end, so the result doesn't depend on the thread count.
+     * @param archive an open archive
+     * @param map an out parameter: the heatmap, added to
+     * @param threads amount of threads, 0 for one per core
+     */
+    void buildHeatmap(const ArchiveReader& archive, Heatmap& map, SizeType threads = 0);
+}
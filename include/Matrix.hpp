@@ -286,8 +286,11 @@ namespace Gungi
     Matrix2<T, SizeType>::Matrix2(const Matrix2& rhs)
     : _width  (rhs._width)
     , _length (rhs._length)
-    , _matrix (std::move(rhs._matrix))
-    {}
+    , _matrix (std::make_unique<T[]>(rhs.getSize()))
+    {
+        for (SizeType i = 0; i < getSize(); ++i)
+            _matrix[i] = rhs._matrix[i];
+    }
 
     template <class T, class SizeType>
     Matrix2<T, SizeType>::Matrix2(Matrix2&& rhs)
@@ -299,9 +302,15 @@ namespace Gungi
     template <class T, class SizeType>
     Matrix2<T, SizeType>& Matrix2<T, SizeType>::operator = (const Matrix2& rhs)
     {
-        _width  = rhs._width;
-        _length = rhs._length;
-        _matrix = std::move(rhs._matrix);
+        if (this != &rhs)
+        {
+            _width  = rhs._width;
+            _length = rhs._length;
+            _matrix = std::make_unique<T[]>(rhs.getSize());
+            for (SizeType i = 0; i < getSize(); ++i)
+                _matrix[i] = rhs._matrix[i];
+        }
+        return *this;
     }
 
     template <class T, class SizeType>
@@ -310,6 +319,7 @@ namespace Gungi
         _width  = rhs._width;
         _length = rhs._length;
         _matrix = std::move(rhs._matrix);
+        return *this;
     }
 
     template <class T, class SizeType>
@@ -396,8 +406,11 @@ namespace Gungi
     : _width  (rhs._width)
     , _depth  (rhs._depth)
     , _height (rhs._height)
-    , _matrix (std::move(rhs._matrix))
-    {}
+    , _matrix (std::make_unique<T[]>(rhs.getSize()))
+    {
+        for (SizeType i = 0; i < getSize(); ++i)
+            _matrix[i] = rhs._matrix[i];
+    }
 
     template <class T, class SizeType>
     Matrix3<T, SizeType>::Matrix3(Matrix3&& rhs)
@@ -410,10 +423,16 @@ namespace Gungi
     template <class T, class SizeType>
     Matrix3<T, SizeType>& Matrix3<T, SizeType>::operator = (const Matrix3& rhs)
     {
-        _width  = rhs._width;
-        _depth  = rhs._depth;
-        _height = rhs._height;
-        _matrix = std::move(rhs._matrix);
+        if (this != &rhs)
+        {
+            _width  = rhs._width;
+            _depth  = rhs._depth;
+            _height = rhs._height;
+            _matrix = std::make_unique<T[]>(rhs.getSize());
+            for (SizeType i = 0; i < getSize(); ++i)
+                _matrix[i] = rhs._matrix[i];
+        }
+        return *this;
     }
 
     template <class T, class SizeType>
@@ -423,6 +442,7 @@ namespace Gungi
         _depth  = rhs._depth;
         _height = rhs._height;
         _matrix = std::move(rhs._matrix);
+        return *this;
     }
 
     template <class T, class SizeType>
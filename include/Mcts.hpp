@@ -0,0 +1,225 @@
+/*
+ * Copyright 2016 Fermin, Yaneury <fermin.yaneury@gmail.com>
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <Engine.hpp>
+#include <Playout.hpp>
+
+/**
+ * The tree lives in a fixed arena of nodes allocated up front. Children of a node are a
+ * contiguous block claimed with a single atomic add, so threads never lock: a node is
+ * expanded by whichever thread flips its state first, the others evaluate it as a leaf.
+ * Virtual loss steers concurrent traversals away from the path another thread is on.
+ */
+
+namespace Gungi
+{
+    constexpr SizeType MCTS_MAX_DEPTH  = 255; /**< Deepest path a simulation descends. */
+    constexpr int64_t MCTS_VALUE_SCALE = 1 << 16; /**< Fixed point scale of node values. */
+
+    /**
+     * Enum that stores the child selection formula.
+     */
+    enum class Selection : SizeType
+    { Uct, Puct };
+
+    /**
+     * This struct holds the settings of an MCTS search.
+     */
+    struct MctsConfig
+    {
+        MctsConfig();
+
+        Selection selection; /**< Child selection formula. */
+        float exploration; /**< Exploration constant of the formula. */
+        SizeType threads; /**< Threads sharing the tree, the caller included. */
+        uint32_t playouts; /**< Simulations per search. */
+        int32_t virtualLoss; /**< Visits a traversal charges as losses until it backs up. */
+        size_t maxNodes; /**< Capacity of the node arena. */
+        uint64_t seed; /**< Seed of the threads' generators. */
+    };
+
+    /**
+     * This struct holds a node of the tree. Values are stored as fixed point sums from the
+     * point of view of the player that made the node's action.
+     */
+    struct MctsNode
+    {
+        MctsNode();
+
+        static constexpr uint8_t LEAF      = 0; /**< Children not generated. */
+        static constexpr uint8_t EXPANDING = 1; /**< A thread is generating children. */
+        static constexpr uint8_t EXPANDED  = 2; /**< Children are published. */
+
+        Action action; /**< Action leading to the node. */
+        float prior; /**< Prior probability of the action. */
+        std::atomic<uint32_t> firstChild; /**< Arena index of the first child. */
+        std::atomic<uint16_t> childCount; /**< Amount of children. */
+        std::atomic<uint8_t> state; /**< LEAF, EXPANDING or EXPANDED. */
+        std::atomic<int32_t> visits; /**< Visits, virtual losses included. */
+        std::atomic<int64_t> valueSum; /**< Sum of values times MCTS_VALUE_SCALE. */
+    };
+
+    /**
+     * This struct holds the scratch memory a thread hands to leaf evaluators.
+     */
+    struct LeafContext
+    {
+        explicit LeafContext(uint64_t seed);
+
+        ActionList actions;
+        float priors[MAX_ACTIONS];
+        Playout playout;
+    };
+
+    /**
+     * This class is the interface of leaf evaluation. Evaluators are shared by every
+     * thread of a search, per thread state lives in the LeafContext.
+     */
+    class LeafEvaluator
+    {
+        public:
+
+            virtual ~LeafEvaluator();
+
+            /**
+             * This method evaluates a position.
+             * @param game the position, restored before returning
+             * @param context the calling thread's scratch memory
+             * @return a value in [-1, 1] from the point of view of the player to move
+             */
+            virtual float evaluate(Game& game, LeafContext& context) const = 0;
+
+            /**
+             * This method assigns prior probabilities to the actions of a position. The
+             * default is uniform.
+             * @param game the position
+             * @param actions its actions
+             * @param priors an out parameter: one prior per action
+             */
+            virtual void priors(const Game& game, const ActionList& actions,
+                    float* priors) const;
+    };
+
+    /**
+     * This class evaluates a leaf with a playout. Reaching the ply cap scores as a draw.
+     */
+    class RolloutEvaluator : public LeafEvaluator
+    {
+        public:
+
+            explicit RolloutEvaluator(uint16_t plyCap = 200);
+
+            float evaluate(Game& game, LeafContext& context) const override;
+
+        private:
+            uint16_t _plyCap;
+    };
+
+    /**
+     * This class evaluates a leaf by squashing the material balance into [-1, 1].
+     */
+    class StaticEvaluator : public LeafEvaluator
+    {
+        public:
+
+            /**
+             * @param scale material balance that maps to a value of about 0.46
+             */
+            explicit StaticEvaluator(float scale = 16.0f);
+
+            float evaluate(Game& game, LeafContext& context) const override;
+
+        private:
+            float _scale;
+    };
+
+    /**
+     * This struct holds the outcome of a root action.
+     */
+    struct RootStat
+    {
+        Action action;
+        uint32_t visits;
+        float value; /**< Mean value for the player to move at the root. */
+    };
+
+    /**
+     * This class runs a parallel Monte Carlo tree search.
+     */
+    class Mcts
+    {
+        public:
+
+            /**
+             * @param config the search settings
+             * @param evaluator the leaf evaluator, must outlive the searcher
+             */
+            Mcts(const MctsConfig& config, const LeafEvaluator& evaluator);
+
+            Mcts(const Mcts&) = delete;
+            Mcts& operator = (const Mcts&) = delete;
+
+            /**
+             * This method runs config.playouts simulations from the game on config.threads
+             * threads. Each thread works on its own copy of the game.
+             * @param game the root position
+             * @return the most visited root action, NULL_ACTION if there is none
+             */
+            Action search(const Game& game);
+
+            /**
+             * This method returns the root actions of the last search with their visits.
+             * @return the root statistics, in generation order
+             */
+            const std::vector<RootStat>& rootStats() const;
+
+            /**
+             * This method returns the amount of arena nodes the last search used.
+             * @return used nodes
+             */
+            size_t nodesUsed() const;
+
+        private:
+            void _worker(const Game& root, uint64_t seed);
+
+            void _simulate(Game& game, LeafContext& context);
+
+            uint32_t _select(const MctsNode& node) const;
+
+            bool _expand(MctsNode& node, Game& game, LeafContext& context);
+
+            void _addVirtualLoss(MctsNode& node);
+
+            void _backup(MctsNode& node, const float& value);
+
+            MctsConfig _config;
+            const LeafEvaluator& _evaluator;
+            std::unique_ptr<MctsNode[]> _nodes; /**< Node arena, the root is node 0. */
+            std::atomic<size_t> _used; /**< Arena nodes claimed so far. */
+            std::atomic<uint32_t> _started; /**< Simulations handed out so far. */
+            std::vector<RootStat> _rootStats;
+            uint64_t _searches; /**< Searches run, varies the seeds between searches. */
+    };
+}
@@ -0,0 +1,248 @@
+/*
+ * Copyright 2016 Fermin, Yaneury <fermin.yaneury@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+#include <Engine.hpp>
+
+/**
+ * The network is a small NNUE-style evaluator:
+ *   features (NET_FEATURE_CT) -> accumulator (NET_HIDDEN x 2 perspectives)
+ *   -> dense (NET_L1) -> dense (NET_L2) -> output.
+ * The first layer is sparse and only ever touched through the Accumulator, which is
+ * updated feature by feature as pieces come and go. The dense layers run on int8 weights
+ * with an AVX2 kernel when compiled with -mavx2 and a scalar kernel otherwise.
+ */
+
+namespace Gungi
+{
+    class Accumulator;
+
+    constexpr uint32_t NET_MAGIC      = 0x45554E47; /**< "GNUE", the weight file magic. */
+    constexpr uint32_t NET_VERSION    = 1; /**< Weight file layout version. */
+    constexpr size_t NET_SQUARE_CT    = BOARD_WIDTH * BOARD_DEPTH; /**< Squares per tier. */
+    constexpr size_t NET_HAND_SLOTS   = 18; /**< Max copies of a piece code tracked in hand. */
+    constexpr size_t NET_BOARD_FEATS  = 2 * PIECE_CODE_CT * BOARD_HEIGHT * NET_SQUARE_CT;
+    constexpr size_t NET_HAND_FEATS   = 2 * PIECE_CODE_CT * NET_HAND_SLOTS;
+    constexpr size_t NET_FEATURE_CT   = NET_BOARD_FEATS + NET_HAND_FEATS;
+    constexpr size_t NET_HIDDEN       = 256; /**< Accumulator width per perspective. */
+    constexpr size_t NET_L1           = 32; /**< Width of the first dense layer. */
+    constexpr size_t NET_L2           = 32; /**< Width of the second dense layer. */
+    constexpr int NET_WEIGHT_SHIFT    = 6; /**< Fixed point shift of the dense layers. */
+    constexpr int NET_CLIP            = 127; /**< Upper bound of the clipped ReLU. */
+    constexpr SizeType NET_PERSPECTIVES = 2; /**< Black and White. */
+
+    /**
+     * This function returns the feature index of a piece on the board as seen from the
+     * given perspective. The board is rotated for White so both perspectives see their own
+     * territory at the bottom.
+     * @param perspective the color whose point of view is used
+     * @param piece a non-null piece
+     * @param pt3 the positive orientation point of the piece
+     * @return index in [0, NET_BOARD_FEATS)
+     */
+    uint16_t boardFeature(const Color& perspective, const Piece& piece, const SmallPoint3& pt3);
+
+    /**
+     * This function returns the feature index of the nth copy of a piece code in a hand.
+     * @param perspective the color whose point of view is used
+     * @param owner the color of the hand
+     * @param code the piece code
+     * @param nth the 1-based copy count
+     * @return index in [NET_BOARD_FEATS, NET_FEATURE_CT), or NET_FEATURE_CT if nth is beyond
+     * NET_HAND_SLOTS
+     */
+    uint16_t handFeature(const Color& perspective, const Color& owner, const SizeType& code,
+            const SizeType& nth);
+
+    /**
+     * This class holds the network weights. The weights are mapped straight from a binary
+     * file, nothing is copied.
+     * Layout: magic, version, int16 ftWeights[NET_FEATURE_CT][NET_HIDDEN],
+     * int16 ftBias[NET_HIDDEN], int8 l1Weights[NET_L1][2 * NET_HIDDEN], int32 l1Bias[NET_L1],
+     * int8 l2Weights[NET_L2][NET_L1], int32 l2Bias[NET_L2], int8 outWeights[NET_L2],
+     * int32 outBias.
+     */
+    class Network
+    {
+        public:
+
+            Network();
+
+            /**
+             * This destructor will unmap the weight file if one is loaded.
+             */
+            ~Network();
+
+            Network(const Network&) = delete;
+            Network& operator = (const Network&) = delete;
+
+            /**
+             * This method maps the weight file at path. Any previously loaded file is
+             * unmapped first.
+             * @param path path to the weight file
+             * @return true if the file was mapped and its layout is valid
+             */
+            bool load(const std::string& path);
+
+            /**
+             * This method unmaps the weight file.
+             */
+            void unload();
+
+            /**
+             * This method returns true if weights are loaded.
+             * @return true if weights are loaded
+             */
+            bool loaded() const;
+
+            const int16_t* featureWeights(const uint16_t& feature) const;
+
+            const int16_t* featureBias() const;
+
+            /**
+             * This method runs the dense layers on top of an accumulator.
+             * @param acc an up to date accumulator
+             * @param toMove the color to evaluate for
+             * @return evaluation from toMove's point of view
+             */
+            int32_t evaluate(const Accumulator& acc, const Color& toMove) const;
+
+        private:
+            const uint8_t* _mapping; /**< Base of the mapped file. */
+            size_t _size; /**< Size of the mapped file. */
+            const int16_t* _ftWeights;
+            const int16_t* _ftBias;
+            const int8_t* _l1Weights;
+            const int32_t* _l1Bias;
+            const int8_t* _l2Weights;
+            const int32_t* _l2Bias;
+            const int8_t* _outWeights;
+            const int32_t* _outBias;
+    };
+
+    /**
+     * This class holds the first layer output for both perspectives. It is refreshed once
+     * from a game and then updated incrementally as pieces are placed, removed and
+     * added to hands.
+     */
+    class Accumulator
+    {
+        public:
+
+            /**
+             * This method recomputes both perspectives from scratch.
+             * @param net loaded network
+             * @param game the game to read the board and hands from
+             */
+            void refresh(const Network& net, const Game& game);
+
+            void addPiece(const Network& net, const Piece& piece, const SmallPoint3& pt3);
+
+            void removePiece(const Network& net, const Piece& piece, const SmallPoint3& pt3);
+
+            /**
+             * This method accounts for a piece code entering a hand.
+             * @param net loaded network
+             * @param owner the color of the hand
+             * @param code the piece code
+             * @param count the count of code in hand after the piece was added
+             */
+            void addHand(const Network& net, const Color& owner, const SizeType& code,
+                    const SizeType& count);
+
+            /**
+             * This method accounts for a piece code leaving a hand.
+             * @param net loaded network
+             * @param owner the color of the hand
+             * @param code the piece code
+             * @param count the count of code in hand before the piece was removed
+             */
+            void removeHand(const Network& net, const Color& owner, const SizeType& code,
+                    const SizeType& count);
+
+            const int16_t* perspective(const Color& color) const;
+
+            /**
+             * This method checks the accumulator against a refresh from a game.
+             * @param net loaded network
+             * @param game the game the accumulator should match
+             * @return true if both perspectives equal those of a full refresh
+             */
+            bool matches(const Network& net, const Game& game) const;
+
+        private:
+            void _add(const Network& net, const uint16_t& black, const uint16_t& white);
+            void _sub(const Network& net, const uint16_t& black, const uint16_t& white);
+
+            int16_t _values[NET_PERSPECTIVES][NET_HIDDEN];
+    };
+
+    /**
+     * This class is a fixed-depth stack of accumulators for make/unmake. Pushing copies the
+     * top so the new entry can be updated in place, popping restores the previous state
+     * without undoing any feature. make() pushes and updates only the features of the
+     * towers and hands an action touches.
+     */
+    class AccumulatorStack
+    {
+        public:
+            static constexpr size_t MAX_DEPTH = 128; /**< Max nesting supported. */
+
+            AccumulatorStack();
+
+            void reset(const Network& net, const Game& game);
+
+            /**
+             * This method pushes a copy of the current accumulator.
+             * @return false, nothing being pushed, if the stack is MAX_DEPTH deep
+             */
+            bool push();
+
+            void pop();
+
+            /**
+             * This method makes an action on a game and pushes the accumulator of the new
+             * position, updated from the towers at the origin and destination of the action
+             * and the hand counts that changed.
+             * @param net loaded network
+             * @param game the game to make the action on, in the position top() was built for
+             * @param action an action generated for the game
+             * @return false, nothing being made, if the stack is MAX_DEPTH deep
+             */
+            bool make(const Network& net, Game& game, const Action& action);
+
+            /**
+             * This method unmakes the last action of a game and pops its accumulator.
+             * @param game the game make() was called with
+             */
+            void unmake(Game& game);
+
+            size_t depth() const;
+
+            const Accumulator& top() const;
+
+            Accumulator& top();
+
+        private:
+            Accumulator _stack[MAX_DEPTH];
+            size_t _depth;
+    };
+}
@@ -0,0 +1,134 @@
+/*
+ * Copyright 2016 Fermin, Yaneury <fermin.yaneury@gmail.com>
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <Engine.hpp>
+
+/**
+ * The text notation of a position is four fields separated by single spaces:
+ *   board hands side phase
+ * The board lists ranks from z = 8 down to z = 0 separated by '/', each rank from x = 0 to
+ * x = 8. A digit skips that many empty squares, a lone piece letter is a tower of one and
+ * a tower of more is its letters bottom to top within parentheses, e.g. "(SK)".
+ * Hands lists the letters of every piece in hand, or '-' if both hands are empty.
+ * Side is 'b' or 'w', phase is 's' (standby), 'p' (placement) or 'r' (running).
+ *
+ * A letter names the side a piece shows and, when that side doesn't tell it, the hidden
+ * one. Uppercase pieces show Black and lowercase pieces show White.
+ *   head up: C Commander, K Captain, M Samurai, N Ninja, Y Catapult, F Fortress,
+ *            D Hidden Dragon, P Prodigy, A Archer, S Soldier (Bronze), G Soldier (Gold),
+ *            V Soldier (Silver)
+ *   tail up: H captured Commander, I Pistol, E Pike, J Jounin, L Lance (Catapult),
+ *            T Lance (Fortress), R Dragon King, X Phoenix, W Arrow, B Bronze, O Gold,
+ *            Q Silver
+ *
+ * The packed encoding is PACKED_SIZE bytes: a little endian uint16 header, phase | side to
+ * move << 2 with White as 1, then PACKED_PIECES little endian uint16 entries,
+ * location << 6 | state, in ascending order and padded with PACKED_EMPTY. The state is the
+ * letter index of the piece in the table above, head up letters first, plus 24 if its head
+ * side is White. Equal positions pack to equal bytes, whatever the order of the sets.
+ */
+
+namespace Gungi
+{
+    constexpr size_t NOTATION_MAX = 256; /**< Longest notation of any position. */
+    constexpr size_t PACKED_PIECES = 2 * STD_PIECE_CT; /**< Piece entries of a packed position. */
+    constexpr size_t PACKED_SIZE = 2 + 2 * PACKED_PIECES; /**< Bytes of a packed position. */
+    constexpr uint16_t PACKED_EMPTY = 0xFFFF; /**< Entry past the last piece. */
+
+    /**
+     * This struct is a position packed into a fixed amount of bytes. It holds no pointers,
+     * it can be copied, hashed and compared as plain bytes.
+     */
+    struct PackedPosition
+    {
+        uint8_t bytes[PACKED_SIZE];
+    };
+
+    /**
+     * This function writes the notation of a game. Hands are written in letter table order,
+     * so equal positions have equal notations.
+     * @param game the game to write
+     * @param out the buffer to write to, not null-terminated
+     * @param capacity the size of out, NOTATION_MAX is always enough
+     * @return the length written, 0 if out is too small
+     */
+    size_t writeNotation(const Game& game, char* out, const size_t& capacity);
+
+    /**
+     * This function parses a notation into a position. Hand pieces come after the board
+     * pieces of their player, both in the order they are read.
+     * @param text the notation, it need not be null-terminated
+     * @param length the length of text
+     * @param position an out parameter: the parsed position
+     * @return true if text is a well-formed notation
+     */
+    bool parseNotation(const char* text, const size_t& length, Position& position);
+
+    /**
+     * This function parses a notation and loads it into a game.
+     * @param text the notation, it need not be null-terminated
+     * @param length the length of text
+     * @param game an out parameter: the game to load the position into
+     * @return true if text is a well-formed notation of a loadable position
+     * @see Game::setPosition
+     */
+    bool readNotation(const char* text, const size_t& length, Game& game);
+
+    /**
+     * This function returns the packed state of a piece, see the layout above.
+     * @param piece a non-null piece of a standard set
+     * @return the state, in [0, 48)
+     */
+    uint16_t packedState(const Piece& piece);
+
+    /**
+     * This function reverses packedState.
+     * @param state a state in [0, 48)
+     * @return the piece of the state
+     */
+    Piece pieceOfState(const uint16_t& state);
+
+    /**
+     * This function packs the position of a game.
+     * @param game the game to pack
+     * @param packed an out parameter: the packed position
+     * @return false if the game holds more than PACKED_PIECES pieces
+     */
+    bool packPosition(const Game& game, PackedPosition& packed);
+
+    /**
+     * This function unpacks a position. Pieces come in packed order, board pieces before
+     * hand pieces.
+     * @param packed a packed position
+     * @param position an out parameter: the unpacked position
+     * @return false if an entry is malformed or a player has more than MAX_SET_CT pieces
+     */
+    bool unpackPosition(const PackedPosition& packed, Position& position);
+
+    /**
+     * This function unpacks a position and loads it into a game.
+     * @param packed a packed position
+     * @param game an out parameter: the game to load the position into
+     * @return true if the position was unpacked and loaded
+     * @see Game::setPosition
+     */
+    bool loadPacked(const PackedPosition& packed, Game& game);
+}
@@ -0,0 +1,78 @@
+/*
+ * Copyright 2016 Fermin, Yaneury <fermin.yaneury@gmail.com>
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+#include <Protocol.hpp>
+
+namespace Gungi
+{
+    /**
+     * This function resolves a requested thread count.
+     * @param threads a thread count, 0 for one per core
+     * @return the thread count, at least 1
+     */
+    inline SizeType threadCount(const SizeType& threads)
+    {
+        return threads != 0 ? threads : static_cast<SizeType>(std::min(255u,
+                    std::max(1u, std::thread::hardware_concurrency())));
+    }
+
+    /**
+     * This function runs task on every number below count, the threads pulling numbers as
+     * they go. The calling thread is one of them. Each call also gets the index of the
+     * thread making it, so tasks can keep scratch state or partial results per thread.
+     * @param count amount of numbers
+     * @param threads amount of threads
+     * @param task a callable taking a SizeType thread index, below threads, and a size_t
+     */
+    template <typename Task>
+    void parallelForWorkers(const size_t& count, const SizeType& threads, Task task)
+    {
+        std::atomic<size_t> next(0);
+        auto run = [&] (const SizeType& worker)
+        {
+            for (size_t i = next++; i < count; i = next++)
+                task(worker, i);
+        };
+
+        std::vector<std::thread> pool;
+        for (SizeType t = 1; t < threads && t < count; ++t)
+            pool.emplace_back(run, t);
+        run(0);
+        for (auto& thread : pool)
+            thread.join();
+    }
+
+    /**
+     * This function runs task on every number below count, the threads pulling numbers as
+     * they go. The calling thread is one of them. Tasks must not share unguarded state.
+     * @param count amount of numbers
+     * @param threads amount of threads
+     * @param task a callable taking a size_t
+     */
+    template <typename Task>
+    void parallelFor(const size_t& count, const SizeType& threads, Task task)
+    {
+        parallelForWorkers(count, threads, [&] (const SizeType&, const size_t& i) { task(i); });
+    }
+}
@@ -0,0 +1,133 @@
+/*
+ * Copyright 2016 Fermin, Yaneury <fermin.yaneury@gmail.com>
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <PositionStore.hpp>
+
+/**
+ * A pattern is a conjunction of clauses, a clause a set of terms on the tiers of one tower.
+ * A position matches a clause if some square of the clause holds a tower meeting every
+ * term, and matches the pattern if it matches every clause. "A black Fortress under a white
+ * Archer on tier 2" is one clause of two terms, black Fortress on tier 1 and white Archer
+ * on tier 2.
+ * Patterns are compiled into literals on the bitboard columns of a position store, so a
+ * scan is an AND of a few columns per clause and never builds a Game.
+ */
+
+namespace Gungi
+{
+    /**
+     * This struct holds a requirement on one tier of a tower.
+     */
+    struct PatternTerm
+    {
+        SizeType tier; /**< Tier the term is about. */
+        bool occupied; /**< False if the tier must be empty, color and code are ignored. */
+        Color color; /**< Color of the piece, Color::None for either. */
+        SizeType code; /**< Active piece code, PIECE_CODE_CT for any. */
+    };
+
+    /**
+     * This struct holds the terms a single tower must meet.
+     */
+    struct PatternClause
+    {
+        /**
+         * This constructor instantiates a clause over every square without terms.
+         */
+        PatternClause();
+
+        Bitboard squares; /**< Squares the tower may stand on. */
+        std::vector<PatternTerm> terms; /**< Requirements on the tiers of the tower. */
+    };
+
+    /**
+     * This struct holds the clauses a position must meet.
+     */
+    struct Pattern
+    {
+        std::vector<PatternClause> clauses;
+    };
+
+    /**
+     * This struct holds a clause compiled to bitboard column literals: a position matches
+     * if the squares ANDed with every column, flipped by its literal, aren't empty.
+     */
+    struct CompiledClause
+    {
+        Bitboard squares; /**< Squares the tower may stand on, empty if never met. */
+        size_t literalCt; /**< Amount of literals. */
+        size_t columns[STORE_MASKS]; /**< Bitboard column of each literal. */
+        uint64_t flips[STORE_MASKS]; /**< All ones to take the complement of a column. */
+    };
+
+    /**
+     * This type receives the matches of a scan, a chunk at a time. Calls are serialized.
+     */
+    using PatternSink = std::function<void(const uint64_t* positions, const size_t& count)>;
+
+    /**
+     * This function returns the name of an active piece code, as used in patterns.
+     * @param code an active piece code
+     * @return a lowercase name, "any" for PIECE_CODE_CT
+     */
+    const char* pieceCodeName(const SizeType& code);
+
+    /**
+     * This function parses a pattern. Clauses are separated by ';' and terms by spaces.
+     * A term is "empty@tier" or "[black:|white:]kind@tier", kind being a piece name such as
+     * "fortress" or "dragon-king", or "any", and tier counting from 1.
+     * @param text a pattern
+     * @param pattern an out parameter: the pattern
+     * @return false if the text isn't a pattern
+     */
+    bool parsePattern(const std::string& text, Pattern& pattern);
+
+    /**
+     * This function compiles a pattern.
+     * @param pattern a pattern
+     * @param clauses an out parameter: the compiled clauses
+     * @return false if a term names a tier or a code out of range
+     */
+    bool compilePattern(const Pattern& pattern, std::vector<CompiledClause>& clauses);
+
+    /**
+     * This function tells whether a position meets compiled clauses.
+     * @param clauses compiled clauses
+     * @param row a position
+     * @return true if the position matches
+     */
+    bool matchPattern(const std::vector<CompiledClause>& clauses, const StoreRow& row);
+
+    /**
+     * This function scans a store for the positions meeting compiled clauses, a chunk per
+     * thread at a time. Matches reach the sink chunk by chunk as chunks finish, in
+     * increasing order within a chunk.
+     * @param store an open store
+     * @param clauses compiled clauses
+     * @param sink the receiver of the matches
+     * @param threads amount of threads, 0 for one per core
+     * @return the amount of matches
+     */
+    uint64_t scanPattern(const PositionStore& store, const std::vector<CompiledClause>& clauses,
+            const PatternSink& sink, SizeType threads = 0);
+}
@@ -0,0 +1,133 @@
+/*
+ * Copyright 2016 Fermin, Yaneury <fermin.yaneury@gmail.com>
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+#pragma once
+
+#include <cstdint>
+
+#include <Engine.hpp>
+
+namespace Gungi
+{
+    /**
+     * This struct is a xorshift64* generator, cheap enough to call once per action.
+     */
+    struct Rng
+    {
+        explicit Rng(uint64_t seed = 0x9E3779B97F4A7C15ull);
+
+        uint64_t next();
+
+        /**
+         * This method returns a number in [0, bound).
+         * @param bound a non-zero bound
+         * @return a random number below bound
+         */
+        uint32_t below(const uint32_t& bound);
+
+        uint64_t state;
+    };
+
+    /**
+     * This struct holds how a playout chooses its actions.
+     */
+    struct PlayoutConfig
+    {
+        PlayoutConfig();
+
+        float dropRate; /**< Chance of trying a drop while moves are available. */
+        float captureRate; /**< Chance of picking among the piece's captures if any. */
+        SizeType dropTries; /**< Random squares tested before a drop attempt gives up. */
+        SizeType pieceTries; /**< Random pieces tried before generating every move. */
+    };
+
+    /**
+     * This struct holds the outcome of a playout.
+     */
+    struct PlayoutResult
+    {
+        Color winner; /**< Winning color, Color::None if the ply cap was reached. */
+        uint16_t plies; /**< Plies played. */
+    };
+
+    /**
+     * This class plays random actions from a position until a commander is captured, the
+     * player to move has no action (and loses) or a ply cap is reached. It owns all the
+     * memory it needs, so one playout object per thread is reused for every playout and
+     * nothing is allocated per action.
+     * A ply never generates every action: it picks a random board piece and generates its
+     * moves and immobile attacks only, or with probability dropRate samples random hand
+     * pieces and squares until one is a valid drop. The distribution is thus uniform over
+     * pieces rather than actions. Full generation is only the fallback of a player that seems stuck.
+     */
+    class Playout
+    {
+        public:
+
+            /**
+             * @param seed seed of the generator
+             * @param config how actions are chosen
+             */
+            explicit Playout(uint64_t seed = 0x9E3779B97F4A7C15ull,
+                    const PlayoutConfig& config = PlayoutConfig());
+
+            /**
+             * This method plays a game out.
+             * @param game a started game
+             * @param plyCap the maximum amount of plies to play
+             * @param restore if true, every ply is unmade before returning, otherwise the
+             * game is left in the final position
+             * @return the outcome of the playout
+             */
+            PlayoutResult run(Game& game, const uint16_t& plyCap, bool restore = true);
+
+            /**
+             * This method picks a random action of the player to move.
+             * @param game a started game
+             * @param action the chosen action: an out parameter
+             * @return false if the player to move has no action
+             */
+            bool pick(const Game& game, Action& action);
+
+            /**
+             * This method returns the generator, to be shared with the caller.
+             * @return the generator of the playout
+             */
+            Rng& rng();
+
+            /**
+             * This method returns the scratch action list. It is overwritten by every pick.
+             * @return the scratch list
+             */
+            ActionList& scratch();
+
+        private:
+            bool _chance(const float& rate);
+
+            bool _sampleDrop(const Game& game, Action& action);
+
+            bool _sampleMove(const Game& game, Action& action);
+
+            void _pickFrom(Action& action);
+
+            PlayoutConfig _config;
+            Rng _rng;
+            ActionList _actions; /**< Scratch list of generated actions. */
+            SizeType _indices[2 * STD_PIECE_CT]; /**< Scratch indices of sampled pieces. */
+    };
+}
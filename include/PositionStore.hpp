@@ -0,0 +1,257 @@
+/*
+ * Copyright 2016 Fermin, Yaneury <fermin.yaneury@gmail.com>
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <Bitboard.hpp>
+#include <GameRecord.hpp>
+
+/**
+ * A position store keeps positions column by column so a scan reads only the columns it
+ * needs. Positions are grouped in chunks of STORE_CHUNK, the unit of a parallel scan, and
+ * within a chunk every column is a contiguous array.
+ * The board is kept as STORE_MASKS bitboard columns, STORE_PLANES per tier: the occupied
+ * squares, the squares holding a white piece, then the bits of the active piece code
+ * (getPieceCode) of each piece, low bit first. A bitboard column is stored as an array of
+ * the low words of the chunk followed by an array of the high words.
+ * The bitboard columns of a chunk are followed by STORE_HANDS uint8 columns counting the
+ * pieces in hand by color and active piece code, then uint8 columns of the color to move
+ * and of the winner of the game (Color::None for drawn or unfinished games), then a uint16
+ * column of the ply of the position in its game.
+ * Layout: uint32 magic STORE_MAGIC, uint32 version STORE_VERSION, uint64 position count,
+ * uint32 chunk size, uint32 reserved, uint64 reserved, then the chunks, each of the full
+ * chunk size, the last one zero padded. Integers are in host order.
+ */
+
+namespace Gungi
+{
+    constexpr uint32_t STORE_MAGIC    = 0x4C4F4347; /**< "GCOL", the store magic. */
+    constexpr uint32_t STORE_VERSION  = 2; /**< Store layout version. */
+    constexpr size_t STORE_CHUNK      = 4096; /**< Positions per chunk. */
+    constexpr size_t STORE_CODE_BITS  = 5; /**< Bits of a piece code. */
+    constexpr size_t STORE_PLANES     = 2 + STORE_CODE_BITS; /**< Bitboard columns per tier. */
+    constexpr size_t STORE_MASKS      = STORE_PLANES * BOARD_HEIGHT; /**< Bitboard columns. */
+    constexpr size_t STORE_OCCUPIED   = 0; /**< Plane of the occupied squares. */
+    constexpr size_t STORE_WHITE      = 1; /**< Plane of the squares holding white pieces. */
+    constexpr size_t STORE_CODE       = 2; /**< Plane of the low bit of piece codes. */
+    constexpr size_t STORE_HANDS      = 2 * PIECE_CODE_CT; /**< Hand count columns. */
+
+    /**
+     * This function returns the number of a bitboard column.
+     * @param tier a tier
+     * @param plane a plane of the tier
+     * @return the column number
+     */
+    constexpr size_t maskColumn(const size_t& tier, const size_t& plane)
+    {
+        return tier * STORE_PLANES + plane;
+    }
+
+    /**
+     * This function returns the number of a hand count column.
+     * @param color Color::Black or Color::White
+     * @param code an active piece code
+     * @return the column number
+     */
+    constexpr size_t handColumn(const Color& color, const size_t& code)
+    {
+        return (color == Color::White) * PIECE_CODE_CT + code;
+    }
+
+    /**
+     * This struct holds a position as the store keeps it.
+     */
+    struct StoreRow
+    {
+        Bitboard masks[STORE_MASKS]; /**< Bitboard columns. */
+        uint8_t hands[STORE_HANDS]; /**< Hand count columns. */
+        Color toMove; /**< Color to move, Color::None before the game starts. */
+        Color result; /**< Winner of the game, Color::None for a draw or no result. */
+        uint16_t ply; /**< Ply of the position in its game. */
+    };
+
+    /**
+     * This function fills a row from a game. The result and the ply aren't known to the
+     * game and are cleared.
+     * @param game a game
+     * @param row an out parameter: the row
+     */
+    void fillRow(const Game& game, StoreRow& row);
+
+    /**
+     * This class writes a store a chunk at a time.
+     */
+    class PositionStoreWriter
+    {
+        public:
+
+            PositionStoreWriter();
+
+            /**
+             * This destructor closes the store.
+             */
+            ~PositionStoreWriter();
+
+            PositionStoreWriter(const PositionStoreWriter&) = delete;
+            PositionStoreWriter& operator = (const PositionStoreWriter&) = delete;
+
+            /**
+             * This method creates a store, overwriting any file at path.
+             * @param path path of the store
+             * @return false if the file couldn't be written
+             */
+            bool open(const std::string& path);
+
+            /**
+             * This method appends a position.
+             * @param row the position
+             * @return false if a full chunk couldn't be written
+             */
+            bool append(const StoreRow& row);
+
+            /**
+             * This method writes the last chunk and the position count, then closes the
+             * store.
+             * @return false if the store couldn't be written
+             */
+            bool close();
+
+        private:
+            bool _flush();
+
+            std::FILE* _file; /**< Store file. */
+            std::vector<uint8_t> _chunk; /**< Chunk being filled. */
+            size_t _fill; /**< Positions in the chunk being filled. */
+            uint64_t _count; /**< Positions written. */
+    };
+
+    /**
+     * This function stores every position of record files, the start position and the
+     * position after each ply of every game, games in file order. Threads replay chunks of
+     * games a window at a time and the rows are written in order.
+     * @param paths paths of record files
+     * @param path path of the store, overwritten
+     * @param threads amount of threads, 0 for one per core
+     * @return false if a file couldn't be opened or written; games that don't replay are
+     * skipped
+     */
+    bool buildPositionStore(const std::vector<std::string>& paths, const std::string& path,
+            SizeType threads = 0);
+
+    /**
+     * This class maps a store.
+     */
+    class PositionStore
+    {
+        public:
+
+            PositionStore();
+
+            /**
+             * This destructor unmaps the store.
+             */
+            ~PositionStore();
+
+            PositionStore(const PositionStore&) = delete;
+            PositionStore& operator = (const PositionStore&) = delete;
+
+            /**
+             * This method maps a store.
+             * @param path path of the store
+             * @return false if the file couldn't be mapped or has a bad header or size
+             */
+            bool open(const std::string& path);
+
+            void close();
+
+            /**
+             * This method returns the amount of positions.
+             * @return the amount of positions
+             */
+            uint64_t size() const;
+
+            size_t chunkCount() const;
+
+            /**
+             * This method returns the amount of positions in a chunk.
+             * @param k a chunk number
+             * @return STORE_CHUNK, or less for the last chunk
+             */
+            size_t chunkSize(const size_t& k) const;
+
+            /**
+             * This method returns the low words of a bitboard column in a chunk.
+             * @param k a chunk number
+             * @param mask a bitboard column
+             * @return STORE_CHUNK low words
+             */
+            const uint64_t* maskLo(const size_t& k, const size_t& mask) const;
+
+            /**
+             * This method returns the high words of a bitboard column in a chunk.
+             * @param k a chunk number
+             * @param mask a bitboard column
+             * @return STORE_CHUNK high words
+             */
+            const uint64_t* maskHi(const size_t& k, const size_t& mask) const;
+
+            /**
+             * This method returns a hand count column in a chunk.
+             * @param k a chunk number
+             * @param hand a hand count column
+             * @return STORE_CHUNK counts
+             */
+            const uint8_t* hands(const size_t& k, const size_t& hand) const;
+
+            /**
+             * This method returns the colors to move in a chunk.
+             * @param k a chunk number
+             * @return STORE_CHUNK colors
+             */
+            const uint8_t* toMove(const size_t& k) const;
+
+            /**
+             * This method returns the results in a chunk.
+             * @param k a chunk number
+             * @return STORE_CHUNK winners
+             */
+            const uint8_t* results(const size_t& k) const;
+
+            /**
+             * This method returns the plies in a chunk.
+             * @param k a chunk number
+             * @return STORE_CHUNK plies
+             */
+            const uint16_t* plies(const size_t& k) const;
+
+            /**
+             * This method gathers a stored position.
+             * @param i a position number
+             * @param row an out parameter: the position
+             */
+            void row(const uint64_t& i, StoreRow& row) const;
+
+        private:
+            const uint8_t* _data; /**< Mapped store. */
+            size_t _size; /**< Size of the store. */
+            uint64_t _count; /**< Amount of positions. */
+    };
+}
@@ -22,6 +22,7 @@
 #include <algorithm>
 #include <string>
 
+#include <Bitboard.hpp>
 #include <Matrix.hpp>
 
 /**
@@ -31,7 +32,13 @@
  * All the orientation switching is trouble-some, fix it
  */
 
-#define DEBUG 1
+#ifndef DEBUG
+    #define DEBUG 1
+#endif
+
+#ifndef TUNED_RANKS
+    #define TUNED_RANKS 0
+#endif
 
 #if (DEBUG)
     #include <iostream>
@@ -71,6 +78,9 @@ namespace Gungi
     constexpr SizeType NO_TIERS_FREE         = ~0; /**< Indicates lack of available tiers. */
     constexpr SizeType VALID_PLCMT_DEPTH     = 3; /**< Placement phase allowable depth limit. */
     constexpr SizeType STD_PIECE_CT          = 23; /**< Standard initial piece count per player. */
+    #if (TUNED_RANKS)
+        #include <TunedRanks.hpp>
+    #else
     constexpr SizeType CAPTAIN_RANK          = 12; /**< Rank value of captain. */
     constexpr SizeType SAMURAI_RANK          = 10; /**< Rank value of samurai. */
     constexpr SizeType NINJA_RANK            = 8; /**< Rank value of ninja. */
@@ -92,7 +102,12 @@ namespace Gungi
     constexpr SizeType SILVER_RANK           = 4; /**< Rank value of silver. */
     constexpr SizeType BRONZE_RANK           = 2; /**< Rank value of bronze. */
     constexpr SizeType NO_TAIL               = 0; /**< Indicates piece without tail. */
+    #endif
     constexpr SizeType DROP_STACKABLE_PIECES = 4; /**< Number of pieces that can be dropped on. */
+    constexpr SizeType PIECE_CODE_CT         = 20; /**< Count of distinct active piece codes. */
+    constexpr SizeType BOARD_SQUARES         = 81; /**< Count of squares on a tier. */
+    constexpr SizeType HAND_KIND_CT          = 242; /**< Count of (side, head, tail) kinds. */
+    constexpr uint16_t LOCATION_IN_HAND      = 0x1FF; /**< Location of a piece in hand. */
     constexpr Orientation ORIENTATION_POS    = true; /**< Indicates positive board orientation. */
     constexpr Orientation ORIENTATION_NEG    = false; /**< Indicates negative board orientation. */
 
@@ -320,6 +335,85 @@ namespace Gungi
 
     const Piece NULL_PIECE; /**< A null piece. */
 
+    /**
+     * This class keeps, for every tower of a board, the set of (color, active kind) pairs
+     * in it, which of its squares are topped by each color, and which are open to drops of
+     * each color. Every question about a tower is a bit test, the board is only read when a
+     * tower changes.
+     */
+    class TowerMasks
+    {
+        public:
+
+            TowerMasks();
+
+            /**
+             * This method recomputes every tower of the board.
+             * @param board a game board
+             */
+            void refresh(const Board& board);
+
+            /**
+             * This method recomputes the tower on the given square. It must be called for
+             * every square whose tower changed.
+             * @param board a game board
+             * @param square the square of the tower, as in squareOf
+             */
+            void refresh(const Board& board, const SizeType& square);
+
+            /**
+             * This method returns true if the tower holds a piece of the same color and
+             * active kind as the given piece, which forbids adding the piece to it.
+             * @param square the square of the tower, as in squareOf
+             * @param piece a non-null piece
+             * @return true if the tower holds an allied piece of the same name
+             */
+            bool contains(const SizeType& square, const Piece& piece) const;
+
+            /**
+             * This method returns the towers holding a piece of the same color and active
+             * kind as the given piece.
+             * @param piece a non-null piece
+             * @return squares the piece can't join
+             */
+            const Bitboard& holding(const Piece& piece) const;
+
+            /**
+             * This method returns the towers whose top piece has the given active color.
+             * @param color Black or White
+             * @return squares topped by color
+             */
+            const Bitboard& toppedBy(const Color& color) const;
+
+            /**
+             * This method returns the towers with a free tier whose top piece is a
+             * drop-stackable piece of the given active color.
+             * @param color Black or White
+             * @return squares a piece of color can be dropped onto
+             * @see Piece::dropStackable
+             */
+            const Bitboard& stackable(const Color& color) const;
+
+            /**
+             * This method returns the empty squares.
+             * @return squares without any piece
+             */
+            const Bitboard& empty() const;
+
+        private:
+
+            /**
+             * This method adds the tower on the given square to masks that don't hold it.
+             */
+            void _build(const Board& board, const SizeType& square);
+
+            uint64_t _kinds[BOARD_SQUARES]; /**< Bit color * PIECE_CODE_CT + code per tower. */
+            Bitboard _holding[2 * PIECE_CODE_CT]; /**< Towers holding each (color, kind). */
+            Bitboard _tops[2]; /**< Towers topped by each color. */
+            Bitboard _stackable[2]; /**< Open towers topped by a stackable piece. */
+            Bitboard _empty; /**< Empty squares. */
+    };
+
     /**
      * This convenience operator overload increments a tier enum.
      */
@@ -374,6 +468,61 @@ namespace Gungi
      */
     SizeType getTailValue(const Piece& piece);
 
+    /**
+     * This function returns the code of the active side of the given piece. Head sides map
+     * to [0, 10) and tail sides map to [10, 20).
+     * @param piece the Piece to evaluate
+     * @return piece's active code, PIECE_CODE_CT if the piece is null or has no active side,
+     * as a captured commander
+     * @see PIECE_CODE_CT
+     */
+    SizeType getPieceCode(const Piece& piece);
+
+    /**
+     * This function returns the rank value of the active side of the given piece.
+     * @param piece the Piece to evaluate
+     * @return piece's head rank value if on head, otherwise its tail rank value
+     */
+    SizeType getRankValue(const Piece& piece);
+
+    /**
+     * This function returns the kind of a piece in hand: its head, its tail and the side it
+     * shows. Pieces of the same kind are interchangeable.
+     * @param piece a non-null piece
+     * @return index in [0, HAND_KIND_CT)
+     * @see HAND_KIND_CT
+     */
+    SizeType getHandKind(const Piece& piece);
+
+    /**
+     * This function returns the square index of a point, ignoring its tier.
+     * @param pt2 a bounded x,y pair
+     * @return index in [0, BOARD_SQUARES)
+     */
+    SizeType squareOf(const SmallPoint2& pt2);
+
+    /**
+     * This function returns the square index of a point, ignoring its tier.
+     * @param pt3 a bounded x,z pair
+     * @return index in [0, BOARD_SQUARES)
+     */
+    SizeType squareOf(const SmallPoint3& pt3);
+
+    /**
+     * This function returns the location of a point: tier * BOARD_SQUARES + square, or
+     * LOCATION_IN_HAND for an unbounded point. It fits in 9 bits.
+     * @param pt3 a point on the board or UBD_PT3
+     * @return the location of pt3
+     */
+    uint16_t locationOf(const SmallPoint3& pt3);
+
+    /**
+     * This function reverses locationOf.
+     * @param location a location in [0, BOARD_SQUARES * BOARD_HEIGHT) or LOCATION_IN_HAND
+     * @return the point of the location, UBD_PT3 for LOCATION_IN_HAND
+     */
+    SmallPoint3 pointOf(const uint16_t& location);
+
     /**
      * This function will append the moves that the commander can use before being filtered out.
      * @param moveset a reference to a MoveSet to append to: an in-out parameter
@@ -516,11 +665,47 @@ namespace Gungi
      */
     MoveSet genTailMoveSet(const Piece& piece, const Tier& tier);
 
-    Indices2 genFortressRangeSet(const Board& board, const SmallPoint2& origin, 
-            Orientation o = ORIENTATION_POS);
-    
-    Indices2 genCatapultRangeSet(const Board& board, const SmallPoint2& origin, 
-            Orientation o = ORIENTATION_POS);
+    /**
+     * This function returns the moveset of the active side of a piece at the given tier.
+     * Movesets of every piece code and tier are generated once and cached, so unlike
+     * genHeadMoveSet and genTailMoveSet nothing is allocated per call.
+     * @param piece a non-null piece
+     * @param tier the piece's tier
+     * @return unfiltered moveset of the piece given its' tier
+     */
+    const MoveSet& activeMoveSet(const Piece& piece, const Tier& tier);
+
+    /**
+     * This function returns the mobile range expansion of a Fortress on the given square: the
+     * square itself, for the pieces towered with it, and every square in front of it up to
+     * the other side of the board. Ranges are computed once per square and orientation.
+     * @param square the board square of the Fortress, as in squareOf
+     * @param o the orientation of the Fortress's owner
+     * @return the squares that receive mobile range expansion
+     */
+    const Bitboard& fortressRange(const SizeType& square, Orientation o = ORIENTATION_POS);
+
+    /**
+     * This function returns the mobile range expansion of a Catapult on the given square: the
+     * square itself and the pattern of RULESET.md for the territory row it stands on. A
+     * Catapult outside its owner's territory has an empty range.
+     * @param square the board square of the Catapult, as in squareOf
+     * @param o the orientation of the Catapult's owner
+     * @return the squares that receive mobile range expansion
+     */
+    const Bitboard& catapultRange(const SizeType& square, Orientation o = ORIENTATION_POS);
+
+    /**
+     * This function returns the union of the ranges of every tier one Catapult and Fortress
+     * of the given color. Intersect it with a set of allied squares to find the pieces whose
+     * mobile range is expanded.
+     * @param board a game board
+     * @param color the active color of the Catapults and Fortresses
+     * @param o the orientation of the player of that color
+     * @return the squares that receive mobile range expansion from the color's pieces
+     * @see Piece::canExpandMobileRange
+     */
+    Bitboard expansionRange(const Board& board, const Color& color, Orientation o);
 
     /**
      * This convenience function subtracts two unsigned operands. If lhs operand < rhs operand,
@@ -752,12 +937,14 @@ namespace Gungi
      * @param board a game board
      * @param piece the piece
      * @param pt3 the desired pt3 to place the piece in
+     * @param soldierFiles bit x is set if the player has a soldier in file x
      * @param o the orientation in which to evaluate the piece
      * @return true if piece can be dropped on the specified pt3
      * @see validRunningDrop
+     * @see Player::soldierFiles
      */
     bool validPlacementDrop(const Board& board, const Piece& piece, SmallPoint3 pt3,
-            Orientation o = ORIENTATION_POS);
+            const uint16_t& soldierFiles, Orientation o = ORIENTATION_POS);
 
     /**
      * This function will evaluate if the given piece can be dropped('placed') at the given
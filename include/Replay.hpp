@@ -0,0 +1,98 @@
+/*
+ * Copyright 2016 Fermin, Yaneury <fermin.yaneury@gmail.com>
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <GameRecord.hpp>
+
+namespace Gungi
+{
+    constexpr size_t REPLAY_CHUNK = 256; /**< Games a thread takes at a time. */
+
+    /**
+     * Enum that stores the outcome of replaying a recorded game.
+     */
+    enum class ReplayStatus : uint8_t
+    { Valid, BadStart, BadAction, IllegalAction, ResultMismatch };
+
+    /**
+     * This function returns the name of a replay status.
+     * @param status a status
+     * @return a lowercase name
+     */
+    const char* replayStatusName(const ReplayStatus& status);
+
+    /**
+     * This struct holds a recorded game that failed to replay.
+     */
+    struct ReplayIssue
+    {
+        size_t file; /**< Number of the file in the replayed list. */
+        size_t game; /**< Number of the record in its file. */
+        uint64_t id; /**< Id of the game. */
+        uint16_t ply; /**< Ply that failed, the ply count for a result mismatch. */
+        ReplayStatus status;
+    };
+
+    /**
+     * This struct holds the totals of a replay.
+     */
+    struct ReplayReport
+    {
+        ReplayReport();
+
+        size_t files; /**< Amount of files replayed. */
+        size_t games; /**< Amount of games replayed. */
+        uint64_t plies; /**< Amount of plies replayed, up to the failing ones. */
+        size_t valid; /**< Amount of games that replayed without an issue. */
+        size_t results[3]; /**< Final winners of the valid games, indexed by Color. */
+        double seconds; /**< Wall time of the replay. */
+        std::vector<ReplayIssue> issues; /**< Failed games by file, then game. */
+    };
+
+    /**
+     * This function replays a record, checking every action against the legal actions of
+     * its position and the recorded result against the final position.
+     * @param record a record
+     * @param game the game to replay in, its previous state is discarded
+     * @param ply an out parameter: the amount of plies replayed
+     * @return the outcome of the replay
+     */
+    ReplayStatus replayGame(const RecordView& record, Game& game, uint16_t& ply);
+
+    /**
+     * This function lists the record files of a directory, index files aside, by name.
+     * @param directory path of a directory
+     * @param paths an out parameter: the paths are appended to it
+     * @return false if the directory couldn't be read
+     */
+    bool listRecordFiles(const std::string& directory, std::vector<std::string>& paths);
+
+    /**
+     * This function replays every game of the record files, chunks of REPLAY_CHUNK games
+     * spread across threads that each keep their own Game and totals.
+     * @param paths paths of record files
+     * @param report an out parameter: the totals
+     * @param threads amount of threads, 0 for one per core
+     * @return false if a file couldn't be opened
+     */
+    bool replayFiles(const std::vector<std::string>& paths, ReplayReport& report,
+            SizeType threads = 0);
+}
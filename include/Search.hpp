@@ -0,0 +1,302 @@
+/*
+ * Copyright 2016 Fermin, Yaneury <fermin.yaneury@gmail.com>
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <Engine.hpp>
+#include <Network.hpp>
+
+namespace Gungi
+{
+    constexpr SizeType MAX_PLY    = 64; /**< Deepest ply the search can reach. */
+    constexpr int32_t INF_SCORE   = 32000; /**< Bound above any score. */
+    constexpr int32_t WIN_SCORE   = 30000; /**< Score of capturing the commander at the root. */
+    constexpr int32_t DRAW_SCORE  = 0; /**< Score of a repeated position. */
+    constexpr int32_t DELTA_MARGIN = 2 * SOLDIER_RANK; /**< Slack of quiescence delta pruning. */
+
+    /**
+     * Enum that stores how a transposition table score bounds the true score.
+     */
+    enum class Bound : SizeType
+    { None, Upper, Lower, Exact };
+
+    /**
+     * This struct holds a transposition table entry.
+     */
+    struct TTEntry
+    {
+        Key key;
+        Action move;
+        int32_t score;
+        SizeType depth;
+        Bound bound;
+    };
+
+    /**
+     * This class is an always-replace transposition table indexed by the low bits of the
+     * Zobrist key.
+     */
+    class TranspositionTable
+    {
+        public:
+
+            /**
+             * This constructor allocates the table. The size is rounded down to a power of
+             * two.
+             * @param entries the desired number of entries
+             */
+            explicit TranspositionTable(size_t entries);
+
+            void clear();
+
+            /**
+             * This method looks up a key.
+             * @param key the key of the position
+             * @return the matching entry, or nullptr if the key isn't stored
+             */
+            const TTEntry* probe(const Key& key) const;
+
+            void store(const Key& key, const Action& move, const int32_t& score,
+                    const SizeType& depth, const Bound& bound);
+
+        private:
+            std::vector<TTEntry> _entries;
+            size_t _mask;
+    };
+
+    /**
+     * This class holds two quiet moves per ply that caused a beta cutoff.
+     */
+    class KillerTable
+    {
+        public:
+
+            KillerTable();
+
+            void clear();
+
+            void store(const SizeType& ply, const Action& action);
+
+            const Action& killerAt(const SizeType& ply, const SizeType& slot) const;
+
+        private:
+            Action _killers[MAX_PLY][2];
+    };
+
+    /**
+     * This class scores quiet moves by how often the same piece code moving to the same
+     * square caused a cutoff, weighted by the remaining depth.
+     */
+    class HistoryTable
+    {
+        public:
+
+            HistoryTable();
+
+            void clear();
+
+            void reward(const Color& color, const SizeType& code, const SizeType& square,
+                    const SizeType& depth);
+
+            int32_t scoreOf(const Color& color, const SizeType& code,
+                    const SizeType& square) const;
+
+        private:
+            int32_t _scores[2][PIECE_CODE_CT][BOARD_SQUARES];
+    };
+
+    /**
+     * This struct counts beta cutoffs and how many came from the first action tried, the
+     * usual measure of move ordering quality.
+     */
+    struct OrderingStats
+    {
+        OrderingStats();
+
+        void clear();
+
+        /**
+         * This method records a cutoff.
+         * @param moveNumber 1-based position of the cutting action in the picked order
+         */
+        void recordCutoff(const size_t& moveNumber);
+
+        /**
+         * This method returns the share of cutoffs produced by the first action.
+         * @return a ratio in [0, 1], 0 if there were no cutoffs
+         */
+        double firstMoveRate() const;
+
+        uint64_t nodes; /**< Nodes searched. */
+        uint64_t cutoffs; /**< Beta cutoffs. */
+        uint64_t firstMoveCutoffs; /**< Beta cutoffs on the first action. */
+    };
+
+    /**
+     * This class hands out the actions of a list one at a time in stages: the TT move,
+     * captures by victim rank minus attacker rank, killers, quiet moves by history and
+     * finally drops. Stages are scored lazily and each pick is a linear selection over the
+     * remaining actions of the stage, so nothing is sorted up front and a cutoff on an
+     * early action skips the work of the later stages.
+     */
+    class MovePicker
+    {
+        public:
+
+            /**
+             * @param game the position the actions were generated for
+             * @param actions the generated actions, reordered in place
+             * @param ttMove the transposition table move, NULL_ACTION if none
+             * @param killers the killer table of the search
+             * @param history the history table of the search
+             * @param ply the current ply
+             */
+            MovePicker(const Game& game, ActionList& actions, const Action& ttMove,
+                    const KillerTable& killers, const HistoryTable& history,
+                    const SizeType& ply);
+
+            /**
+             * This method returns the next action to try.
+             * @param action the next action: an out parameter
+             * @return false once every action has been handed out
+             */
+            bool next(Action& action);
+
+        private:
+            enum class Stage : SizeType
+            { TTMove, InitCaptures, Captures, Killers, InitQuiets, Quiets, Drops, Done };
+
+            void _partition();
+            void _scoreCaptures();
+            void _scoreQuiets();
+            bool _selectBest(const size_t& end, Action& action);
+            bool _findKiller(const Action& killer);
+
+            const Game& _game;
+            ActionList& _actions;
+            Action _ttMove;
+            const KillerTable& _killers;
+            const HistoryTable& _history;
+            SizeType _ply;
+            Stage _stage;
+            size_t _cursor; /**< Next unpicked action. */
+            size_t _capturesEnd; /**< End of the captures partition. */
+            size_t _quietsEnd; /**< End of the quiet moves partition, drops follow. */
+            SizeType _killerSlot;
+    };
+
+    /**
+     * This function returns the material balance of the position from the point of view of
+     * the player to move, using the rank values of the active sides of the pieces on the
+     * board and in hand.
+     * @param game a started game
+     * @return the static evaluation
+     */
+    int32_t evaluate(const Game& game);
+
+    /**
+     * This function returns the material swing of capturing a piece: the victim leaves the
+     * opponent and its flipped side joins the capturer's hand.
+     * @param victim the captured piece
+     * @return the gain for the capturer
+     */
+    int32_t captureGain(const Piece& victim);
+
+    /**
+     * This function runs a static exchange evaluation of an action: both sides keep
+     * capturing the top of the destination tower with their least valuable attacker and
+     * may stop whenever continuing would lose material. Pieces uncovered in the attackers'
+     * own towers join the exchange. Nothing is made or unmade.
+     * @param game the position the action was generated for
+     * @param action the action to evaluate
+     * @return the material outcome for the player to move, 0 for non-captures
+     */
+    int32_t see(const Game& game, const Action& action);
+
+    /**
+     * This class runs an iterative deepening negamax alpha-beta search over make/unmake.
+     * Leaves are resolved by a capture-only quiescence search with stand-pat cutoffs and
+     * delta pruning. Positions are scored by evaluate() or, once a network is set, by the
+     * network through accumulators updated on every make.
+     */
+    class Searcher
+    {
+        public:
+
+            /**
+             * @param ttEntries the desired number of transposition table entries
+             */
+            explicit Searcher(size_t ttEntries = 1 << 20);
+
+            /**
+             * This method searches the game to the given depth.
+             * @param game the game to search, restored before returning
+             * @param depth the depth to reach
+             * @return the best action found, NULL_ACTION if there is none
+             */
+            Action search(Game& game, const SizeType& depth);
+
+            /**
+             * This method returns the score of the last completed iteration.
+             * @return score from the point of view of the player to move
+             */
+            int32_t score() const;
+
+            const OrderingStats& stats() const;
+
+            /**
+             * This method clears the tables and statistics between games.
+             */
+            void clear();
+
+            /**
+             * This method scores positions with a network instead of the material balance.
+             * @param network a loaded network that outlives the searcher, nullptr to go back
+             * to the material balance
+             */
+            void setNetwork(const Network* network);
+
+        private:
+            void _make(Game& game, const Action& action);
+
+            void _unmake(Game& game);
+
+            int32_t _evaluate(const Game& game) const;
+
+            int32_t _alphaBeta(Game& game, int32_t alpha, int32_t beta, SizeType depth,
+                    const SizeType& ply);
+
+            int32_t _quiescence(Game& game, int32_t alpha, int32_t beta, const SizeType& ply);
+
+            void _rewardQuiet(const Game& game, const Action& action, const SizeType& depth,
+                    const SizeType& ply);
+
+            TranspositionTable _tt;
+            KillerTable _killers;
+            HistoryTable _history;
+            OrderingStats _stats;
+            std::vector<ActionList> _lists; /**< One action list per ply. */
+            Action _rootBest;
+            int32_t _score;
+            const Network* _network; /**< Network scoring positions, or nullptr. */
+            std::unique_ptr<AccumulatorStack> _accumulators; /**< One per ply. */
+    };
+}
@@ -0,0 +1,140 @@
+/*
+ * Copyright 2016 Fermin, Yaneury <fermin.yaneury@gmail.com>
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <Notation.hpp>
+
+/**
+ * A shard is a sequence of records, each a uint32 payload length followed by the payload.
+ * A game payload is laid out as:
+ *   uint8 version, uint8 winner (0 none, 1 black, 2 white), uint16 ply count,
+ *   then per ply: position, action, uint16 n, n x (action, uint32 visits).
+ * A position is uint8 side to move (0 black, 1 white), uint8 piece count, then per piece
+ * a uint16: location << 6 | packed state, the entry of a packed position (see
+ * Notation.hpp), the location being tier * 81 + square or RECORD_IN_HAND. Black's pieces
+ * come first, both sets in set order. An action is
+ * uint8 type, uint8 index, origin x, z, y and destination x, z, y. Integers are little
+ * endian.
+ */
+
+namespace Gungi
+{
+    constexpr uint8_t RECORD_VERSION  = 2; /**< Layout version of game payloads. */
+    constexpr uint16_t RECORD_IN_HAND = LOCATION_IN_HAND; /**< Location of a piece in hand. */
+    constexpr size_t RECORD_BUFFER    = 1 << 20; /**< Bytes buffered before a write. */
+
+    /**
+     * This class writes length-prefixed records to a file through its own buffer, so a
+     * writer owned by a single thread never contends on a shared stream.
+     */
+    class RecordWriter
+    {
+        public:
+
+            RecordWriter();
+
+            /**
+             * This destructor flushes and closes the file.
+             */
+            ~RecordWriter();
+
+            RecordWriter(const RecordWriter&) = delete;
+            RecordWriter& operator = (const RecordWriter&) = delete;
+
+            /**
+             * This method opens a file for writing, truncating it.
+             * @param path path of the file
+             * @return true if the file was opened
+             */
+            bool open(const std::string& path);
+
+            /**
+             * This method appends a record.
+             * @param data the payload
+             * @param size the payload size
+             * @return false if the file couldn't be written
+             */
+            bool write(const uint8_t* data, const uint32_t& size);
+
+            bool flush();
+
+            /**
+             * This method flushes and closes the file.
+             * @return false if the pending data couldn't be written
+             */
+            bool close();
+
+        private:
+            std::FILE* _file;
+            std::unique_ptr<uint8_t[]> _buffer;
+            size_t _used; /**< Bytes pending in the buffer. */
+    };
+
+    void appendAction(std::vector<uint8_t>& out, const Action& action);
+
+    /**
+     * This function appends the position of a game, see the layout above.
+     * @param out the buffer to append to: an in-out parameter
+     * @param game a started game
+     */
+    void appendPosition(std::vector<uint8_t>& out, const Game& game);
+
+    /**
+     * Enum that stores the engine used to choose self-play actions.
+     */
+    enum class SelfPlayEngine : SizeType
+    { Mcts, AlphaBeta };
+
+    /**
+     * This struct holds the settings of a self-play run.
+     */
+    struct SelfPlayConfig
+    {
+        SelfPlayConfig();
+
+        SelfPlayEngine engine;
+        uint32_t games; /**< Games to play in total. */
+        SizeType threads; /**< Concurrent games, one shard each. */
+        uint32_t playouts; /**< MCTS simulations per action. */
+        size_t maxNodes; /**< MCTS arena capacity per thread. */
+        bool rollouts; /**< MCTS leaves are played out rather than statically evaluated. */
+        SizeType depth; /**< Alpha-beta depth per action. */
+        uint16_t maxPlies; /**< Running phase plies before a game is scored as a draw. */
+        uint16_t repetitions; /**< Earlier occurrences of a position that end a game drawn. */
+        SizeType placements; /**< Random placement drops per player before the game runs. */
+        uint16_t samplingPlies; /**< Early plies that sample by visits instead of the best. */
+        uint64_t seed;
+        std::string prefix; /**< Shards are prefix-<thread>.bin, game records .rec. */
+        std::string network; /**< Weight file scoring alpha-beta positions, empty for none. */
+    };
+
+    /**
+     * This function plays the configured games on a pool of threads. Every thread owns its
+     * engine, its shard and a game record file logging its games from the placement phase.
+     * @param config the run settings
+     * @return false if a shard couldn't be opened or written
+     */
+    bool runSelfPlay(const SelfPlayConfig& config);
+}
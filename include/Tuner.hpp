@@ -0,0 +1,149 @@
+/*
+ * Copyright 2016 Fermin, Yaneury <fermin.yaneury@gmail.com>
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <PositionStore.hpp>
+
+/**
+ * The tuner fits the rank values of the static evaluation to the results of recorded games,
+ * in the manner of Texel. The evaluation is the material of the player to move less the
+ * opponent's, so a position reduces to a sparse vector of piece count differences by active
+ * piece code. The probability that the player to move wins is taken as
+ * 1 / (1 + exp(-scale * evaluation)) and the logistic loss against the result of the game
+ * (1 win, 0.5 draw, 0 loss) is minimised by gradient descent. The scale is fitted first
+ * with the starting ranks so the tuned ranks keep their units.
+ */
+
+namespace Gungi
+{
+    constexpr size_t TUNE_WEIGHTS     = PIECE_CODE_CT; /**< One rank per active piece code. */
+    constexpr size_t TUNE_CHUNK       = 256; /**< Games a thread loads at a time. */
+
+    /**
+     * This struct holds a non-zero entry of a position's feature vector.
+     */
+    struct TuneFeature
+    {
+        uint8_t code; /**< Active piece code. */
+        int8_t count; /**< Pieces of the player to move less the opponent's. */
+    };
+
+    /**
+     * This struct holds labelled positions. The features of position i end at ends[i] and
+     * start where those of position i - 1 end.
+     */
+    struct TuneSet
+    {
+        std::vector<TuneFeature> features; /**< Features of every position, in order. */
+        std::vector<uint64_t> ends; /**< End of the features of each position. */
+        std::vector<float> targets; /**< Score of the player to move: 1, 0.5 or 0. */
+    };
+
+    /**
+     * This struct holds the settings of a tuning run.
+     */
+    struct TuneConfig
+    {
+        TuneConfig();
+
+        uint32_t iterations; /**< Gradient steps. */
+        double rate; /**< Step size of the Adam updates, in rank units. */
+        SizeType threads; /**< Amount of threads, 0 for one per core. */
+    };
+
+    /**
+     * This function appends a position to a set.
+     * @param counts pieces of the player to move less the opponent's, by active piece code
+     * @param target score of the player to move
+     * @param set the set to append to
+     */
+    void addSample(const int32_t counts[TUNE_WEIGHTS], const float& target, TuneSet& set);
+
+    /**
+     * This function appends every position of every game of record files to a set. Positions
+     * of games that don't replay are left out.
+     * @param paths paths of record files
+     * @param set the set to append to
+     * @param threads amount of threads, 0 for one per core
+     * @return false if a record file couldn't be opened
+     */
+    bool loadRecords(const std::vector<std::string>& paths, TuneSet& set,
+            SizeType threads = 0);
+
+    /**
+     * This function appends every position of a store with a player to move to a set.
+     * @param store an open store
+     * @param set the set to append to
+     * @param threads amount of threads, 0 for one per core
+     */
+    void loadStore(const PositionStore& store, TuneSet& set, SizeType threads = 0);
+
+    /**
+     * This function fills weights with the current rank values.
+     * @param weights an out parameter: the rank of each active piece code
+     */
+    void rankWeights(double weights[TUNE_WEIGHTS]);
+
+    /**
+     * This function returns the mean logistic loss of a set.
+     * @param set labelled positions
+     * @param weights the rank of each active piece code
+     * @param scale the scale of the evaluation
+     * @param threads amount of threads, 0 for one per core
+     * @return the mean loss
+     */
+    double tuneLoss(const TuneSet& set, const double weights[TUNE_WEIGHTS], const double& scale,
+            SizeType threads = 0);
+
+    /**
+     * This function finds the scale minimising the loss of a set by golden section search.
+     * @param set labelled positions
+     * @param weights the rank of each active piece code
+     * @param threads amount of threads, 0 for one per core
+     * @return the scale
+     */
+    double fitScale(const TuneSet& set, const double weights[TUNE_WEIGHTS],
+            SizeType threads = 0);
+
+    /**
+     * This function tunes weights with full batch Adam. Every step computes the gradient
+     * over fixed slices of the set in parallel and sums the slices in order, so a run only
+     * depends on the thread count through rounding. The commander's rank isn't tuned: both
+     * players always hold one.
+     * @param set labelled positions
+     * @param weights the starting ranks: an in-out parameter
+     * @param scale the scale of the evaluation
+     * @param config the run settings
+     * @return the final mean loss
+     */
+    double tuneWeights(const TuneSet& set, double weights[TUNE_WEIGHTS], const double& scale,
+            const TuneConfig& config);
+
+    /**
+     * This function writes the rank constants of Protocol.hpp as a header, the tuned ranks
+     * rounded and clamped to a SizeType. Protocol.hpp includes it in place of its own ranks
+     * when built with -DTUNED_RANKS=1.
+     * @param path path of the header, overwritten
+     * @param weights the rank of each active piece code
+     * @return false if the file couldn't be written
+     */
+    bool writeRankHeader(const std::string& path, const double weights[TUNE_WEIGHTS]);
+}
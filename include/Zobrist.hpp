@@ -0,0 +1,53 @@
+/*
+ * Copyright 2016 Fermin, Yaneury <fermin.yaneury@gmail.com>
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+#include <cstdint>
+
+#include <Protocol.hpp>
+
+namespace Gungi
+{
+    using Key = uint64_t;
+
+    /**
+     * This function returns the key of a piece standing on the board. Piece keys are
+     * combined with xor. The key tells apart pieces of the same active code with different
+     * hidden sides.
+     * @param piece a non-null piece
+     * @param pt3 the positive orientation point of the piece
+     * @return the key of piece at pt3
+     */
+    Key pieceKey(const Piece& piece, const SmallPoint3& pt3);
+
+    /**
+     * This function returns the key of one copy of a piece kind in a hand. Hand keys are
+     * combined with addition so that a hand hashes as a multiset: adding or removing a copy
+     * is O(1) and doesn't need the count.
+     * @param owner the color of the hand
+     * @param kind the hand kind of the piece, see getHandKind()
+     * @return the key of one copy of kind in owner's hand
+     */
+    Key handKey(const Color& owner, const SizeType& kind);
+
+    /**
+     * This function returns the key toggled when player two is to move.
+     * @return the side to move key
+     */
+    Key sideKey();
+}
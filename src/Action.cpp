@@ -0,0 +1,477 @@
+/*
+ * Copyright 2016 Fermin, Yaneury <fermin.yaneury@gmail.com>
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <Action.hpp>
+#include <Engine.hpp>
+
+namespace Gungi
+{
+    namespace
+    {
+        /**
+         * Applies a move, and its chained move if any, to a positive orientation point as
+         * seen from the given orientation.
+         */
+        SmallPoint2 destinationOf(const SmallPoint2& origin, const Move& move, Orientation o)
+        {
+            auto pt2 = o == ORIENTATION_POS ? origin : asPositive2(origin);
+            pt2 = genIndex2Of(pt2, move);
+            if (move.getNext() && !(isUnbounded(pt2)))
+                pt2 = genIndex2Of(pt2, *(move.getNext()));
+            return o == ORIENTATION_POS ? pt2 : asPositive2(pt2);
+        }
+
+        const Piece& topAt(const Board& board, const SmallPoint2& pt2, SizeType& tier)
+        {
+            tier = availableTierAt(board, pt2);
+            if (tier == 0)
+                return NULL_PIECE;
+
+            tier = tier == NO_TIERS_FREE ? BOARD_HEIGHT - 1 : tier - 1;
+            return *(board(pt2.x, pt2.y, tier));
+        }
+
+        /**
+         * A tier one piece that can't jump can't pass over an enemy tower.
+         */
+        bool blocks(const Board& board, const Player& player, const Piece& piece,
+                const SmallPoint3& origin, const SmallPoint2& pt2)
+        {
+            if (origin.y != 0 || piece.canJump())
+                return false;
+
+            SizeType tier;
+            const Piece& top = topAt(board, pt2, tier);
+            return !(top.isNull()) && top.getActiveColor() == player.getOppColor();
+        }
+
+        /**
+         * Pushes the move to pt2 if the tower there can be entered. A tower holding an
+         * allied piece of the mover's name can't be entered.
+         * @return true if pt2 is occupied, which ends a sliding move
+         */
+        bool pushLanding(const Board& board, const TowerMasks& towers, const Player& player,
+                const SizeType& i, const SmallPoint3& origin, const SmallPoint2& pt2,
+                bool capturesOnly, ActionList& actions)
+        {
+            const SizeType square = squareOf(pt2);
+            if (towers.empty().test(square))
+            {
+                if (!(capturesOnly))
+                    actions.push(Action(ActionType::Move, i, origin, SmallPoint3(pt2), false));
+                return false;
+            }
+
+            if (towers.contains(square, player.pieceAt(i)))
+                return true;
+
+            SizeType tier;
+            const Piece& top = topAt(board, pt2, tier);
+            SmallPoint3 destination(pt2.x, pt2.y, tier);
+            if (towers.toppedBy(player.getOppColor()).test(square))
+                actions.push(Action(ActionType::Move, i, origin, destination, true));
+            else if (!(capturesOnly) && tier + 1 < BOARD_HEIGHT && 
+                    !(top.onHead() && top.getHead() == Head::Commander))
+            {
+                ++destination.y;
+                actions.push(Action(ActionType::Move, i, origin, destination, false));
+            }
+            return true;
+        }
+
+        /**
+         * Calls visit with every square the piece at origin can move onto. The visitor
+         * returns true if the square is occupied, which ends a sliding move.
+         */
+        template <class Visitor>
+        void visitTargets(const Board& board, const Player& player, const Piece& piece,
+                const SmallPoint3& origin, Visitor visit)
+        {
+            const MoveSet& moveset = activeMoveSet(piece, asTier(origin.y));
+
+            for (const Move& move : moveset)
+            {
+                if (move.getMagnitude() == UNBOUNDED)
+                {
+                    for (SizeType k = 1; k < BOARD_WIDTH; ++k)
+                    {
+                        auto pt2 = destinationOf(SmallPoint2(origin),
+                                Move(k, move.getDirection()), player.getOrientation());
+                        if (isUnbounded(pt2) || visit(pt2))
+                            break;
+                    }
+                    continue;
+                }
+
+                auto pt2 = destinationOf(SmallPoint2(origin), move, player.getOrientation());
+                if (isUnbounded(pt2))
+                    continue;
+
+                bool blocked = false;
+                for (SizeType k = 1; !(blocked) && k < move.getMagnitude(); ++k)
+                {
+                    auto step = destinationOf(SmallPoint2(origin), 
+                            Move(k, move.getDirection()), player.getOrientation());
+                    blocked = blocks(board, player, piece, origin, step);
+                }
+
+                if (!(blocked))
+                    visit(pt2);
+            }
+        }
+
+        void genPieceMoves(const Board& board, const TowerMasks& towers, const Player& player,
+                const SizeType& i, bool capturesOnly, ActionList& actions)
+        {
+            const SmallPoint3& origin = player.pointAt(i);
+            if (isUnbounded(origin) || !(isTopAt(board, origin)))
+                return;
+
+            visitTargets(board, player, player.pieceAt(i), origin, 
+                    [&] (const SmallPoint2& pt2)
+                    { return pushLanding(board, towers, player, i, origin, pt2, 
+                            capturesOnly, actions); });
+        }
+
+        void genMoves(const Board& board, const TowerMasks& towers, const Player& player,
+                bool capturesOnly, ActionList& actions)
+        {
+            for (SizeType i = 0; i < player.getFullSet().Set.size(); ++i)
+                genPieceMoves(board, towers, player, i, capturesOnly, actions);
+        }
+
+        void computeDropMasks(const Board& board, const TowerMasks& towers, const Player& player,
+                DropMasks& masks)
+        {
+            for (SizeType sq = 0; sq < BOARD_SQUARES; ++sq)
+                masks.tiers[sq] = availableTierAt(board, 
+                        SmallPoint2(sq % BOARD_WIDTH, sq / BOARD_WIDTH));
+
+            masks.kindCt = player.handKinds(masks.indices);
+            for (SizeType k = 0; k < masks.kindCt; ++k)
+            {
+                const Piece& piece = player.pieceAt(masks.indices[k]);
+                if (piece.onHead() && (piece.getHead() == Head::Catapult || 
+                            piece.getHead() == Head::Fortress))
+                    masks.squares[k] = towers.empty();
+                else
+                    masks.squares[k] = (towers.empty() | 
+                            towers.stackable(piece.getActiveColor())) & ~towers.holding(piece);
+            }
+        }
+
+        /**
+         * Pushes the running phase drops, one per distinct kind in hand and square.
+         */
+        void genDrops(const Board& board, const TowerMasks& towers, const Player& player,
+                ActionList& actions)
+        {
+            DropMasks masks;
+            computeDropMasks(board, towers, player, masks);
+            for (SizeType k = 0; k < masks.kindCt; ++k)
+            {
+                Bitboard squares = masks.squares[k];
+                while (!(squares.empty()))
+                {
+                    const SizeType sq = static_cast<SizeType>(squares.popLowest());
+                    actions.push(Action(ActionType::Drop, masks.indices[k], UBD_PT3, 
+                                SmallPoint3(sq % BOARD_WIDTH, sq / BOARD_WIDTH, masks.tiers[sq]),
+                                false));
+                }
+            }
+        }
+
+        /**
+         * Pushes the immobile attacks of the piece at i on the enemies next to it.
+         */
+        void genPieceImmobile(const Board& board, const Player& player, const SizeType& i,
+                ActionList& actions)
+        {
+            const SmallPoint3& origin = player.pointAt(i);
+            const Piece& piece = player.pieceAt(i);
+            if (isUnbounded(origin) || (piece.onHead() && (piece.getHead() == Head::Catapult ||
+                            piece.getHead() == Head::Fortress)))
+                return;
+
+            if (origin.y > 0)
+            {
+                const SmallPoint3 below(origin.x, origin.z, origin.y - 1);
+                if (board[below]->getActiveColor() == player.getOppColor())
+                    actions.push(Action(ActionType::Immobile, i, origin, below, true));
+            }
+
+            if (origin.y + 1 < BOARD_HEIGHT)
+            {
+                const SmallPoint3 above(origin.x, origin.z, origin.y + 1);
+                const Piece& top = *(board[above]);
+                if (!(top.isNull()) && top.getActiveColor() == player.getOppColor())
+                    actions.push(Action(ActionType::Immobile, i, origin, above, true));
+            }
+        }
+
+        void genImmobile(const Board& board, const Player& player, ActionList& actions)
+        {
+            for (SizeType i = 0; i < player.getFullSet().Set.size(); ++i)
+                genPieceImmobile(board, player, i, actions);
+        }
+
+        bool sameKind(const Piece& lhs, const Piece& rhs)
+        {
+            return getHandKind(lhs) == getHandKind(rhs) &&
+                (lhs.isNull() || lhs.getActiveColor() == rhs.getActiveColor());
+        }
+    }
+
+    Action::Action()
+    : type        (ActionType::None)
+    , index       (UNBOUNDED)
+    , origin      (UBD_PT3)
+    , destination (UBD_PT3)
+    , onOpponent  (false)
+    {}
+
+    Action::Action(const ActionType& type, const SizeType& index, const SmallPoint3& origin,
+            const SmallPoint3& destination, bool onOpponent)
+    : type        (type)
+    , index       (index)
+    , origin      (origin)
+    , destination (destination)
+    , onOpponent  (onOpponent)
+    {}
+
+    bool operator == (const Action& lhs, const Action& rhs)
+    {
+        return lhs.type == rhs.type && lhs.index == rhs.index && lhs.origin == rhs.origin &&
+            lhs.destination == rhs.destination;
+    }
+
+    bool operator != (const Action& lhs, const Action& rhs)
+    {
+        return !(lhs == rhs);
+    }
+
+    ActionList::ActionList()
+    : _size (0)
+    {}
+
+    void ActionList::clear()
+    {
+        _size = 0;
+    }
+
+    void ActionList::push(const Action& action)
+    {
+        if (_size < MAX_ACTIONS)
+            _actions[_size++] = action;
+    }
+
+    size_t ActionList::size() const
+    {
+        return _size;
+    }
+
+    bool ActionList::empty() const
+    {
+        return _size == 0;
+    }
+
+    Action& ActionList::operator [] (const size_t& i)
+    {
+        return _actions[i];
+    }
+
+    const Action& ActionList::operator [] (const size_t& i) const
+    {
+        return _actions[i];
+    }
+
+    int32_t& ActionList::scoreAt(const size_t& i)
+    {
+        return _scores[i];
+    }
+
+    void ActionList::swap(const size_t& i, const size_t& j)
+    {
+        std::swap(_actions[i], _actions[j]);
+        std::swap(_scores[i], _scores[j]);
+    }
+
+    bool isTopAt(const Board& board, const SmallPoint3& pt3)
+    {
+        return pt3.y + 1 >= BOARD_HEIGHT || isNullAt(board, SmallPoint3(pt3.x, pt3.z, pt3.y + 1));
+    }
+
+    bool canReach(const Board& board, const Player& player, const SmallPoint3& origin,
+            const SmallPoint2& target)
+    {
+        bool reached = false;
+        visitTargets(board, player, *(board[origin]), origin, [&] (const SmallPoint2& pt2)
+                {
+                    reached = reached || pt2 == target;
+                    return reached || availableTierAt(board, pt2) != 0;
+                });
+        return reached;
+    }
+
+    void genActions(const Game& game, ActionList& actions)
+    {
+        actions.clear();
+        if (game.getPhase() == Phase::Standby || game.getWinner() != Color::None)
+            return;
+
+        const Board& board = *(game.gameBoard());
+        const TowerMasks& towers = game.towers();
+        const Player& player = *(game.currentPlayer());
+
+        if (game.getPhase() == Phase::Placement)
+        {
+            genPlacementActions(game, actions);
+            return;
+        }
+
+        genMoves(board, towers, player, false, actions);
+        genImmobile(board, player, actions);
+        genDrops(board, towers, player, actions);
+    }
+
+    void genPlacementActions(const Game& game, ActionList& actions, bool mirror)
+    {
+        actions.clear();
+        if (game.getPhase() != Phase::Placement)
+            return;
+
+        const Board& board = *(game.gameBoard());
+        const TowerMasks& towers = game.towers();
+        const Player& player = *(game.currentPlayer());
+        const PieceSet& pieces = player.getFullSet();
+
+        // Identical pieces lead to identical positions, one of each kind is enough.
+        SizeType kinds[2 * STD_PIECE_CT];
+        const SizeType kindCt = player.handKinds(kinds);
+        const uint16_t soldierFiles = player.soldierFiles();
+
+        const SizeType firstRow = player.getOrientation() == ORIENTATION_POS ? 0 :
+            BOARD_DEPTH - VALID_PLCMT_DEPTH;
+        const SizeType files = mirror && isMirrorSymmetric(board) ? BOARD_WIDTH / 2 + 1 :
+            BOARD_WIDTH;
+
+        for (SizeType z = firstRow; z < firstRow + VALID_PLCMT_DEPTH; ++z)
+        {
+            for (SizeType x = 0; x < files; ++x)
+            {
+                const SizeType tier = availableTierAt(board, SmallPoint2(x, z));
+                if (tier == NO_TIERS_FREE)
+                    continue;
+
+                for (SizeType k = 0; k < kindCt; ++k)
+                {
+                    const Piece& piece = pieces.pieceAt(kinds[k]);
+                    if (!(piece.onHead()))
+                        continue;
+
+                    if (piece.getHead() == Head::Soldier && (soldierFiles & (1 << x)))
+                        continue;
+
+                    if ((piece.getHead() == Head::Catapult || piece.getHead() == Head::Fortress)
+                            && tier != 0)
+                        continue;
+
+                    if (towers.contains(z * BOARD_WIDTH + x, piece))
+                        continue;
+
+                    actions.push(Action(ActionType::Drop, kinds[k], UBD_PT3, 
+                                SmallPoint3(x, z, tier), false));
+                }
+            }
+        }
+    }
+
+    bool isMirrorSymmetric(const Board& board)
+    {
+        for (SizeType y = 0; y < BOARD_HEIGHT; ++y)
+            for (SizeType z = 0; z < BOARD_DEPTH; ++z)
+                for (SizeType x = 0; x < BOARD_WIDTH / 2; ++x)
+                    if (!(sameKind(*(board(x, z, y)), *(board(BOARD_WIDTH - 1 - x, z, y)))))
+                        return false;
+        return true;
+    }
+
+    Key canonicalKey(const Game& game)
+    {
+        const Board& board = *(game.gameBoard());
+        Key mirrored = game.getKey();
+        for (SizeType y = 0; y < BOARD_HEIGHT; ++y)
+        {
+            for (SizeType z = 0; z < BOARD_DEPTH; ++z)
+            {
+                for (SizeType x = 0; x < BOARD_WIDTH; ++x)
+                {
+                    const Piece& piece = *(board(x, z, y));
+                    if (piece.isNull())
+                        continue;
+
+                    mirrored ^= pieceKey(piece, SmallPoint3(x, z, y)) ^
+                        pieceKey(piece, SmallPoint3(BOARD_WIDTH - 1 - x, z, y));
+                }
+            }
+        }
+        return std::min(game.getKey(), mirrored);
+    }
+
+    void genDropMasks(const Game& game, DropMasks& masks)
+    {
+        computeDropMasks(*(game.gameBoard()), game.towers(), *(game.currentPlayer()), masks);
+    }
+
+    void genMoveActions(const Game& game, ActionList& actions)
+    {
+        actions.clear();
+        if (game.getPhase() != Phase::Running || game.getWinner() != Color::None)
+            return;
+
+        genMoves(*(game.gameBoard()), game.towers(), *(game.currentPlayer()), false, actions);
+    }
+
+    void genMoveActions(const Game& game, const SizeType& i, ActionList& actions)
+    {
+        actions.clear();
+        if (game.getPhase() != Phase::Running || game.getWinner() != Color::None)
+            return;
+
+        genPieceMoves(*(game.gameBoard()), game.towers(), *(game.currentPlayer()), i, false,
+                actions);
+        genPieceImmobile(*(game.gameBoard()), *(game.currentPlayer()), i, actions);
+    }
+
+    void genImmobileAttacks(const Game& game, ActionList& actions)
+    {
+        if (game.getPhase() != Phase::Running || game.getWinner() != Color::None)
+            return;
+
+        genImmobile(*(game.gameBoard()), *(game.currentPlayer()), actions);
+    }
+
+    void genCaptures(const Game& game, ActionList& actions)
+    {
+        actions.clear();
+        if (game.getPhase() != Phase::Running || game.getWinner() != Color::None)
+            return;
+
+        genMoves(*(game.gameBoard()), game.towers(), *(game.currentPlayer()), true, actions);
+        genImmobile(*(game.gameBoard()), *(game.currentPlayer()), actions);
+    }
+}
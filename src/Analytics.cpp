@@ -0,0 +1,167 @@
+/*
+ * Copyright 2016 Fermin, Yaneury <fermin.yaneury@gmail.com>
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+
+#include <Analytics.hpp>
+#include <Parallel.hpp>
+
+namespace Gungi
+{
+    namespace
+    {
+        /**
+         * This function adds the material of a chunk to a curve.
+         * @param store an open store
+         * @param k a chunk number
+         * @param curve the curve to add to
+         */
+        void addMaterial(const PositionStore& store, const size_t& k,
+                std::vector<MaterialPoint>& curve)
+        {
+            const size_t count = store.chunkSize(k);
+            const uint16_t* plies = store.plies(k);
+            uint64_t material[2][STORE_CHUNK] = {};
+
+            // Hands: one pass per column, every position of the chunk at once.
+            for (SizeType code = 0; code < PIECE_CODE_CT; ++code)
+            {
+                const uint64_t value = codeValue(code);
+                const uint8_t* black = store.hands(k, handColumn(Color::Black, code));
+                const uint8_t* white = store.hands(k, handColumn(Color::White, code));
+                for (size_t i = 0; i < count; ++i)
+                {
+                    material[0][i] += black[i] * value;
+                    material[1][i] += white[i] * value;
+                }
+            }
+
+            for (SizeType tier = 0; tier < BOARD_HEIGHT; ++tier)
+            {
+                const TierColumns columns(store, k, tier);
+                for (size_t i = 0; i < count; ++i)
+                {
+                    Bitboard occupied = columns.occupied(i);
+                    const Bitboard white = columns.white(i);
+                    while (!(occupied.empty()))
+                    {
+                        const uint32_t square = occupied.popLowest();
+                        material[white.test(square)][i] += codeValue(columns.codeAt(i, square));
+                    }
+                }
+            }
+
+            for (size_t i = 0; i < count; ++i)
+            {
+                if (plies[i] >= curve.size())
+                    curve.resize(plies[i] + 1, MaterialPoint());
+
+                MaterialPoint& point = curve[plies[i]];
+                ++point.positions;
+                point.material[0] += material[0][i];
+                point.material[1] += material[1][i];
+            }
+        }
+    }
+
+    TierColumns::TierColumns(const PositionStore& store, const size_t& k,
+            const SizeType& tier)
+    {
+        for (size_t p = 0; p < STORE_PLANES; ++p)
+        {
+            lo[p] = store.maskLo(k, maskColumn(tier, p));
+            hi[p] = store.maskHi(k, maskColumn(tier, p));
+        }
+    }
+
+    SizeType codeValue(const SizeType& code)
+    {
+        static const std::vector<SizeType> values = [] ()
+        {
+            std::vector<SizeType> table(PIECE_CODE_CT + 1, 0);
+            for (SizeType c = 0; c < FRONT_PCS_CT; ++c)
+            {
+                const Piece head(static_cast<Head>(c + 1), Tail::None, Color::Black,
+                        Color::Black);
+                const Piece tail(Head::None, static_cast<Tail>(c + 1), Color::Black,
+                        Color::Black);
+                table[c] = getHeadValue(head);
+                table[FRONT_PCS_CT + c] = getTailValue(tail);
+            }
+            return table;
+        } ();
+
+        return values[std::min(code, PIECE_CODE_CT)];
+    }
+
+    void towerHeights(const PositionStore& store, uint64_t counts[BOARD_HEIGHT + 1],
+            SizeType threads)
+    {
+        threads = threadCount(threads);
+        std::vector<std::vector<uint64_t>> parts(threads,
+                std::vector<uint64_t>(BOARD_HEIGHT + 1, 0));
+        parallelForWorkers(store.chunkCount(), threads, [&] (const SizeType& t, const size_t& k)
+        {
+            // Towers are stacked from the bottom, so the squares occupied on a tier are the
+            // towers at least that high.
+            std::vector<uint64_t>& part = parts[t];
+            const size_t count = store.chunkSize(k);
+            for (SizeType tier = 0; tier < BOARD_HEIGHT; ++tier)
+            {
+                const uint64_t* lo = store.maskLo(k, maskColumn(tier, STORE_OCCUPIED));
+                const uint64_t* hi = store.maskHi(k, maskColumn(tier, STORE_OCCUPIED));
+                uint64_t atLeast = 0;
+                for (size_t i = 0; i < count; ++i)
+                    atLeast += __builtin_popcountll(lo[i]) + __builtin_popcountll(hi[i]);
+                part[tier + 1] += atLeast;
+            }
+            part[0] += count * BOARD_SQUARES;
+        });
+
+        std::vector<uint64_t> atLeast(BOARD_HEIGHT + 2, 0);
+        for (const std::vector<uint64_t>& part : parts)
+            for (SizeType h = 0; h <= BOARD_HEIGHT; ++h)
+                atLeast[h] += part[h];
+
+        for (SizeType h = 0; h <= BOARD_HEIGHT; ++h)
+            counts[h] = atLeast[h] - atLeast[h + 1];
+    }
+
+    void materialCurve(const PositionStore& store, std::vector<MaterialPoint>& curve,
+            SizeType threads)
+    {
+        threads = threadCount(threads);
+        std::vector<std::vector<MaterialPoint>> parts(threads);
+        parallelForWorkers(store.chunkCount(), threads, [&] (const SizeType& t, const size_t& k)
+        {
+            addMaterial(store, k, parts[t]);
+        });
+
+        curve.clear();
+        for (const std::vector<MaterialPoint>& part : parts)
+        {
+            if (part.size() > curve.size())
+                curve.resize(part.size(), MaterialPoint());
+
+            for (size_t ply = 0; ply < part.size(); ++ply)
+            {
+                curve[ply].positions += part[ply].positions;
+                curve[ply].material[0] += part[ply].material[0];
+                curve[ply].material[1] += part[ply].material[1];
+            }
+        }
+    }
+}
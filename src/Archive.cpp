@@ -0,0 +1,636 @@
+/*
+ * Copyright 2016 Fermin, Yaneury <fermin.yaneury@gmail.com>
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+#include <Archive.hpp>
+#include <FileIo.hpp>
+#include <Parallel.hpp>
+#include <Search.hpp>
+
+namespace Gungi
+{
+    namespace
+    {
+        constexpr size_t ARCHIVE_HEADER   = 8; /**< Bytes before the first block. */
+        constexpr size_t ARCHIVE_TRAILER  = 20; /**< Bytes after the block index. */
+        constexpr size_t INDEX_ENTRY      = 16; /**< Bytes per block in the block index. */
+        constexpr size_t GAME_HEADER      = 1 + RECORD_HEADER_SIZE; /**< Flags and header. */
+        constexpr uint8_t STANDARD_START  = 1; /**< Flag of a game from the standard start. */
+
+        constexpr uint32_t PROB_BITS      = 11; /**< Precision of a bit probability. */
+        constexpr uint16_t PROB_HALF      = 1 << (PROB_BITS - 1);
+        constexpr uint32_t PROB_SHIFT     = 5; /**< Adaptation rate of a bit probability. */
+        constexpr uint32_t RANGE_TOP      = 1u << 24; /**< Renormalization threshold. */
+        constexpr uint32_t BUCKET_BITS    = 4; /**< Bits of the magnitude of an index. */
+        constexpr uint32_t MAX_BUCKET     = 12; /**< Magnitude of MAX_ACTIONS - 1. */
+        constexpr size_t CONTEXT_CT       = 4; /**< Running or not, captures or not. */
+        constexpr size_t WINDOW_PER_THREAD = 4; /**< Blocks a thread codes per window. */
+
+        /**
+         * Returns the packed position of a started game, the start of most records.
+         */
+        const PackedPosition& standardStart()
+        {
+            static const PackedPosition start = [] ()
+            {
+                PackedPosition packed;
+                Game game;
+                game.start();
+                packPosition(game, packed);
+                return packed;
+            } ();
+            return start;
+        }
+
+        /**
+         * This class is a range coder over adaptive bit probabilities and uniform symbols.
+         */
+        class RangeEncoder
+        {
+            public:
+
+                explicit RangeEncoder(std::vector<uint8_t>& out)
+                : _out          (out)
+                , _low          (0)
+                , _range        (0xFFFFFFFF)
+                , _cache        (0)
+                , _cacheSize    (1)
+                {}
+
+                void encodeBit(uint16_t& prob, const uint32_t& bit)
+                {
+                    const uint32_t bound = (_range >> PROB_BITS) * prob;
+                    if (bit == 0)
+                    {
+                        _range = bound;
+                        prob += ((1 << PROB_BITS) - prob) >> PROB_SHIFT;
+                    }
+                    else
+                    {
+                        _low += bound;
+                        _range -= bound;
+                        prob -= prob >> PROB_SHIFT;
+                    }
+                    _normalize();
+                }
+
+                /**
+                 * Codes value in [0, count) with equal probabilities, count below 2^12.
+                 */
+                void encodeUniform(const uint32_t& value, const uint32_t& count)
+                {
+                    _range /= count;
+                    _low += static_cast<uint64_t>(value) * _range;
+                    _normalize();
+                }
+
+                void flush()
+                {
+                    for (size_t i = 0; i < 5; ++i)
+                        _shiftLow();
+                }
+
+            private:
+                void _normalize()
+                {
+                    while (_range < RANGE_TOP)
+                    {
+                        _range <<= 8;
+                        _shiftLow();
+                    }
+                }
+
+                void _shiftLow()
+                {
+                    if (static_cast<uint32_t>(_low) < 0xFF000000 || (_low >> 32) != 0)
+                    {
+                        const uint8_t carry = static_cast<uint8_t>(_low >> 32);
+                        uint8_t pending = _cache;
+                        do
+                        {
+                            _out.push_back(static_cast<uint8_t>(pending + carry));
+                            pending = 0xFF;
+                        }
+                        while (--_cacheSize != 0);
+                        _cache = static_cast<uint8_t>(_low >> 24);
+                    }
+                    ++_cacheSize;
+                    _low = (_low & 0x00FFFFFF) << 8;
+                }
+
+                std::vector<uint8_t>& _out;
+                uint64_t _low;
+                uint32_t _range;
+                uint8_t _cache; /**< Byte held back until no carry can reach it. */
+                uint64_t _cacheSize; /**< Held back bytes, the cache and 0xFF bytes. */
+        };
+
+        class RangeDecoder
+        {
+            public:
+
+                RangeDecoder(const uint8_t* data, const uint8_t* end)
+                : _data     (data)
+                , _end      (end)
+                , _code     (0)
+                , _range    (0xFFFFFFFF)
+                {
+                    for (size_t i = 0; i < 5; ++i)
+                        _code = _code << 8 | _next();
+                }
+
+                uint32_t decodeBit(uint16_t& prob)
+                {
+                    const uint32_t bound = (_range >> PROB_BITS) * prob;
+                    uint32_t bit = 0;
+                    if (_code < bound)
+                    {
+                        _range = bound;
+                        prob += ((1 << PROB_BITS) - prob) >> PROB_SHIFT;
+                    }
+                    else
+                    {
+                        _code -= bound;
+                        _range -= bound;
+                        prob -= prob >> PROB_SHIFT;
+                        bit = 1;
+                    }
+                    _normalize();
+                    return bit;
+                }
+
+                /**
+                 * Returns a value coded by encodeUniform, count or above if the data is bad.
+                 */
+                uint32_t decodeUniform(const uint32_t& count)
+                {
+                    _range /= count;
+                    const uint32_t value = _code / _range;
+                    if (value >= count)
+                        return count;
+
+                    _code -= value * _range;
+                    _normalize();
+                    return value;
+                }
+
+            private:
+                void _normalize()
+                {
+                    while (_range < RANGE_TOP)
+                    {
+                        _range <<= 8;
+                        _code = _code << 8 | _next();
+                    }
+                }
+
+                uint32_t _next()
+                {
+                    return _data < _end ? *_data++ : 0;
+                }
+
+                const uint8_t* _data;
+                const uint8_t* _end;
+                uint32_t _code;
+                uint32_t _range;
+        };
+
+        /**
+         * An index is coded as its magnitude, the bit length of index + 1 less one, through
+         * a bit tree per context, then uniformly within the magnitude and the action count.
+         */
+        struct PlyModel
+        {
+            PlyModel()
+            {
+                std::fill(&magnitudes[0][0], &magnitudes[0][0] + sizeof (magnitudes) / 2,
+                        PROB_HALF);
+            }
+
+            uint16_t magnitudes[CONTEXT_CT][1 << BUCKET_BITS];
+        };
+
+        size_t contextOf(const Game& game, const ActionList& actions)
+        {
+            return (game.getPhase() == Phase::Running) * 2 +
+                (!(actions.empty()) && actions[0].onOpponent);
+        }
+
+        void encodeIndex(RangeEncoder& coder, uint16_t* magnitudes, const uint32_t& index,
+                const uint32_t& count)
+        {
+            if (count == 1)
+                return;
+
+            uint32_t magnitude = 0;
+            while ((index + 1) >> (magnitude + 1) != 0)
+                ++magnitude;
+
+            for (uint32_t node = 1, b = BUCKET_BITS; b-- > 0; )
+            {
+                const uint32_t bit = (magnitude >> b) & 1;
+                coder.encodeBit(magnitudes[node], bit);
+                node = node << 1 | bit;
+            }
+
+            const uint32_t base = (1u << magnitude) - 1;
+            const uint32_t span = std::min(1u << magnitude, count - base);
+            if (span > 1)
+                coder.encodeUniform(index - base, span);
+        }
+
+        /**
+         * Returns the index coded by encodeIndex, count or above if the data is bad.
+         */
+        uint32_t decodeIndex(RangeDecoder& coder, uint16_t* magnitudes, const uint32_t& count)
+        {
+            if (count == 1)
+                return 0;
+
+            uint32_t node = 1;
+            for (uint32_t b = 0; b < BUCKET_BITS; ++b)
+                node = node << 1 | coder.decodeBit(magnitudes[node]);
+
+            const uint32_t magnitude = node - (1 << BUCKET_BITS);
+            if (magnitude > MAX_BUCKET || (1u << magnitude) - 1 >= count)
+                return count;
+
+            const uint32_t base = (1u << magnitude) - 1;
+            const uint32_t span = std::min(1u << magnitude, count - base);
+            return base + (span > 1 ? coder.decodeUniform(span) : 0);
+        }
+
+        /**
+         * Codes the games of a block: game count, game offsets, then the games.
+         */
+        bool buildBlock(const GameRecordReader& records, const size_t& first,
+                const size_t& count, std::vector<uint8_t>& block)
+        {
+            std::vector<uint8_t> games;
+            std::vector<uint32_t> offsets;
+            for (size_t g = 0; g < count; ++g)
+            {
+                offsets.push_back(static_cast<uint32_t>(games.size()));
+                if (!(compressGame(records[first + g], games)))
+                    return false;
+            }
+            offsets.push_back(static_cast<uint32_t>(games.size()));
+
+            block.resize(4 + 4 * offsets.size() + games.size());
+            writeU32(block.data(), static_cast<uint32_t>(count));
+            for (size_t g = 0; g < offsets.size(); ++g)
+                writeU32(block.data() + 4 + 4 * g, offsets[g]);
+            std::copy(games.begin(), games.end(), block.begin() + 4 + 4 * offsets.size());
+            return true;
+        }
+
+        /**
+         * A decoded game waiting to be written.
+         */
+        struct ExpandedGame
+        {
+            RecordHeader header;
+            PackedPosition start;
+            std::vector<uint32_t> actions;
+        };
+    }
+
+    void orderActions(const Game& game, ActionList& actions)
+    {
+        const Board& board = *(game.gameBoard());
+        size_t captures = 0;
+        for (size_t i = 0; i < actions.size(); ++i)
+        {
+            if (!(actions[i].onOpponent))
+                continue;
+
+            // Captures are few, sinking each into place keeps the rest in order.
+            actions.scoreAt(i) = captureGain(*(board[actions[i].destination]));
+            size_t j = i;
+            for (; j > captures; --j)
+                actions.swap(j - 1, j);
+            for (; j > 0 && actions.scoreAt(j - 1) < actions.scoreAt(j); --j)
+                actions.swap(j - 1, j);
+            ++captures;
+        }
+    }
+
+    bool compressGame(const RecordView& record, std::vector<uint8_t>& out)
+    {
+        const RecordHeader header = record.header();
+        const PackedPosition& start = record.start();
+        Game game;
+        if (!(loadPacked(start, game)))
+            return false;
+
+        const size_t mark = out.size();
+        const bool standard = std::memcmp(start.bytes, standardStart().bytes, PACKED_SIZE) == 0;
+        out.resize(mark + GAME_HEADER + (standard ? 0 : PACKED_SIZE));
+        uint8_t* fixed = out.data() + mark;
+        fixed[0] = standard ? STANDARD_START : 0;
+        writeU64(fixed + 1, header.id);
+        writeU32(fixed + 9, header.time);
+        writeU16(fixed + 13, header.plies);
+        fixed[15] = static_cast<uint8_t>(header.result);
+        fixed[16] = static_cast<uint8_t>(header.termination);
+        if (!(standard))
+            std::memcpy(fixed + GAME_HEADER, start.bytes, PACKED_SIZE);
+
+        PlyModel model;
+        RangeEncoder coder(out);
+        ActionList actions;
+        for (uint16_t ply = 0; ply < header.plies; ++ply)
+        {
+            genActions(game, actions);
+            orderActions(game, actions);
+
+            // A phase advance is coded as one past the last action.
+            const uint32_t code = record.action(ply);
+            const size_t count = actions.size() + (canAdvance(game) ? 1 : 0);
+            size_t index = 0;
+            while (index < actions.size() && encodeAction(game, actions[index]) != code)
+                ++index;
+
+            if (index == count || (index == actions.size() && code != PHASE_CODE))
+            {
+                out.resize(mark);
+                return false;
+            }
+
+            encodeIndex(coder, model.magnitudes[contextOf(game, actions)],
+                    static_cast<uint32_t>(index), static_cast<uint32_t>(count));
+            if (index == actions.size())
+                game.start();
+            else
+                game.make(actions[index]);
+        }
+        coder.flush();
+        return true;
+    }
+
+    bool expandGame(const uint8_t* data, const size_t& size, RecordHeader& header,
+            PackedPosition& start, std::vector<uint32_t>& actions)
+    {
+        if (size < GAME_HEADER)
+            return false;
+
+        const bool standard = (data[0] & STANDARD_START) != 0;
+        header.id = readU64(data + 1);
+        header.time = readU32(data + 9);
+        header.plies = readU16(data + 13);
+        header.result = static_cast<Color>(data[15]);
+        header.termination = static_cast<Termination>(data[16]);
+
+        size_t offset = GAME_HEADER;
+        if (standard)
+            start = standardStart();
+        else if (size < GAME_HEADER + PACKED_SIZE)
+            return false;
+        else
+        {
+            std::memcpy(start.bytes, data + GAME_HEADER, PACKED_SIZE);
+            offset += PACKED_SIZE;
+        }
+
+        Game game;
+        if (!(loadPacked(start, game)))
+            return false;
+
+        PlyModel model;
+        RangeDecoder coder(data + offset, data + size);
+        ActionList list;
+        actions.clear();
+        for (uint16_t ply = 0; ply < header.plies; ++ply)
+        {
+            genActions(game, list);
+            const uint32_t count = static_cast<uint32_t>(list.size()) +
+                (canAdvance(game) ? 1 : 0);
+            if (count == 0)
+                return false;
+
+            orderActions(game, list);
+            const uint32_t index = decodeIndex(coder, model.magnitudes[contextOf(game, list)],
+                    count);
+            if (index >= count)
+                return false;
+
+            if (index == list.size())
+            {
+                actions.push_back(PHASE_CODE);
+                game.start();
+                continue;
+            }
+
+            actions.push_back(encodeAction(game, list[index]));
+            game.make(list[index]);
+        }
+        return true;
+    }
+
+    bool writeArchive(const GameRecordReader& records, const std::string& path,
+            SizeType threads)
+    {
+        std::FILE* file = std::fopen(path.c_str(), "wb");
+        if (file == nullptr)
+            return false;
+
+        uint8_t header[ARCHIVE_HEADER];
+        writeU32(header, ARCHIVE_MAGIC);
+        writeU32(header + 4, ARCHIVE_VERSION);
+        bool ok = std::fwrite(header, ARCHIVE_HEADER, 1, file) == 1;
+
+        threads = threadCount(threads);
+        const size_t games = records.size();
+        const size_t blocks = (games + ARCHIVE_BLOCK_GAMES - 1) / ARCHIVE_BLOCK_GAMES;
+        const size_t window = threads * WINDOW_PER_THREAD;
+        std::vector<std::vector<uint8_t>> buffers(window);
+        std::vector<uint8_t> index(blocks * INDEX_ENTRY);
+        uint64_t offset = ARCHIVE_HEADER;
+
+        // Blocks are coded a window at a time and written in order.
+        for (size_t first = 0; ok && first < blocks; first += window)
+        {
+            const size_t count = std::min(window, blocks - first);
+            std::atomic<bool> coded(true);
+            parallelFor(count, threads, [&] (const size_t& k)
+            {
+                const size_t game = (first + k) * ARCHIVE_BLOCK_GAMES;
+                if (!(buildBlock(records, game, std::min(ARCHIVE_BLOCK_GAMES, games - game),
+                                buffers[k])))
+                    coded = false;
+            });
+
+            ok = coded;
+            for (size_t k = 0; ok && k < count; ++k)
+            {
+                writeU64(index.data() + (first + k) * INDEX_ENTRY, offset);
+                writeU64(index.data() + (first + k) * INDEX_ENTRY + 8,
+                        (first + k) * ARCHIVE_BLOCK_GAMES);
+                ok = std::fwrite(buffers[k].data(), buffers[k].size(), 1, file) == 1;
+                offset += buffers[k].size();
+            }
+        }
+
+        uint8_t trailer[ARCHIVE_TRAILER];
+        writeU64(trailer, offset);
+        writeU64(trailer + 8, games);
+        writeU32(trailer + 16, static_cast<uint32_t>(blocks));
+        ok = ok && (blocks == 0 || std::fwrite(index.data(), index.size(), 1, file) == 1) &&
+            std::fwrite(trailer, ARCHIVE_TRAILER, 1, file) == 1;
+        return std::fclose(file) == 0 && ok;
+    }
+
+    ArchiveReader::ArchiveReader()
+    : _data     (nullptr)
+    , _size     (0)
+    , _index    (nullptr)
+    , _blocks   (0)
+    , _games    (0)
+    {}
+
+    ArchiveReader::~ArchiveReader()
+    {
+        close();
+    }
+
+    bool ArchiveReader::open(const std::string& path)
+    {
+        close();
+
+        _data = mapFile(path, _size, ARCHIVE_HEADER + ARCHIVE_TRAILER);
+        if (_data == nullptr)
+            return false;
+
+        const uint8_t* trailer = _data + _size - ARCHIVE_TRAILER;
+        const uint64_t indexOffset = readU64(trailer);
+        _blocks = readU32(trailer + 16);
+        _games = readU64(trailer + 8);
+        if (readU32(_data) != ARCHIVE_MAGIC || readU32(_data + 4) != ARCHIVE_VERSION ||
+                indexOffset < ARCHIVE_HEADER ||
+                indexOffset + _blocks * INDEX_ENTRY + ARCHIVE_TRAILER != _size)
+        {
+            close();
+            return false;
+        }
+
+        _index = _data + indexOffset;
+        return true;
+    }
+
+    void ArchiveReader::close()
+    {
+        unmapFile(_data, _size);
+        _data = _index = nullptr;
+        _size = _blocks = _games = 0;
+    }
+
+    size_t ArchiveReader::size() const
+    {
+        return _games;
+    }
+
+    size_t ArchiveReader::blockCount() const
+    {
+        return _blocks;
+    }
+
+    size_t ArchiveReader::blockStart(const size_t& b) const
+    {
+        return b < _blocks ? static_cast<size_t>(readU64(_index + b * INDEX_ENTRY + 8)) :
+            _games;
+    }
+
+    bool ArchiveReader::game(const size_t& i, RecordHeader& header, PackedPosition& start,
+            std::vector<uint32_t>& actions) const
+    {
+        const uint8_t* data;
+        size_t size;
+        return _locate(i, data, size) && expandGame(data, size, header, start, actions);
+    }
+
+    bool ArchiveReader::_locate(const size_t& i, const uint8_t*& data, size_t& size) const
+    {
+        if (i >= _games)
+            return false;
+
+        // The last block starting at or before game i.
+        size_t low = 0;
+        size_t high = _blocks;
+        while (high - low > 1)
+        {
+            const size_t mid = (low + high) / 2;
+            (blockStart(mid) <= i ? low : high) = mid;
+        }
+
+        const uint64_t begin = readU64(_index + low * INDEX_ENTRY);
+        const uint64_t end = low + 1 < _blocks ? readU64(_index + (low + 1) * INDEX_ENTRY) :
+            static_cast<uint64_t>(_index - _data);
+        if (begin + 4 > end || end > static_cast<uint64_t>(_index - _data))
+            return false;
+
+        const uint8_t* block = _data + begin;
+        const size_t count = readU32(block);
+        const size_t game = i - blockStart(low);
+        const size_t payload = 4 + 4 * (count + 1);
+        if (game >= count || begin + payload > end)
+            return false;
+
+        const size_t first = readU32(block + 4 + 4 * game);
+        const size_t last = readU32(block + 8 + 4 * game);
+        if (first > last || begin + payload + last > end)
+            return false;
+
+        data = block + payload + first;
+        size = last - first;
+        return true;
+    }
+
+    bool extractArchive(const ArchiveReader& archive, GameRecordWriter& writer,
+            SizeType threads)
+    {
+        threads = threadCount(threads);
+        const size_t blocks = archive.blockCount();
+        const size_t window = threads * WINDOW_PER_THREAD;
+        std::vector<std::vector<ExpandedGame>> buffers(window);
+
+        // Blocks are decoded a window at a time and written in order.
+        bool ok = true;
+        for (size_t first = 0; ok && first < blocks; first += window)
+        {
+            const size_t count = std::min(window, blocks - first);
+            std::atomic<bool> decoded(true);
+            parallelFor(count, threads, [&] (const size_t& k)
+            {
+                const size_t begin = archive.blockStart(first + k);
+                std::vector<ExpandedGame>& games = buffers[k];
+                games.resize(archive.blockStart(first + k + 1) - begin);
+                for (size_t g = 0; g < games.size(); ++g)
+                    if (!(archive.game(begin + g, games[g].header, games[g].start,
+                                    games[g].actions)))
+                        decoded = false;
+            });
+
+            ok = decoded;
+            for (size_t k = 0; ok && k < count; ++k)
+                for (const ExpandedGame& game : buffers[k])
+                    ok = ok && writer.write(game.header, game.start, game.actions.data());
+        }
+        return ok;
+    }
+}
@@ -33,33 +33,106 @@ namespace Gungi
     , _onBoard        (0)
     , _onHand         (STD_PIECE_CT)
     , _numPieces      (STD_PIECE_CT)
-    {}
+    , _soldierFiles   (0)
+    , _soldierCts     {}
+    , _handCts        {}
+    {
+        for (SizeType i = 0; i < _pieces.Set.size(); ++i)
+            ++_handCts[getHandKind(_pieces.pieceAt(i))];
+    }
+
+    Player::Player(const Player& other, Board* gameBoard)
+    : _pieces         (other._pieces)
+    , _gameBoard      (gameBoard)
+    , _color          (other._color)
+    , _oppColor       (other._oppColor)
+    , _orientation    (other._orientation)
+    , _onBoard        (other._onBoard)
+    , _onHand         (other._onHand)
+    , _numPieces      (other._numPieces)
+    , _soldierFiles   (other._soldierFiles)
+    {
+        std::copy(other._soldierCts, other._soldierCts + BOARD_WIDTH, _soldierCts);
+        std::copy(other._handCts, other._handCts + HAND_KIND_CT, _handCts);
+        _pieces.Set.reserve(MAX_SET_CT);
+        _repoint(0);
+    }
 
     void Player::drop(const SizeType& i, const SmallPoint3& pt3)
     {
         _pieces.pointAt(i) = pt3;
         placeAt(*_gameBoard, &_pieces.pieceAt(i), pt3);
+        _trackSoldier(i, true);
+        --_handCts[getHandKind(_pieces.pieceAt(i))];
         --_onHand;
         ++_onBoard;
     }
 
     void Player::updatePoint(const SizeType& i, const SmallPoint3& pt3)
     {
+        _trackSoldier(i, false);
         _pieces.pointAt(i) = pt3;
+        _trackSoldier(i, true);
     }
 
     void Player::remove(const SizeType& i)
     {
+        _trackSoldier(i, false);
         _pieces.remove(i);
+        _repoint(i);
         --_onBoard;
     }
 
+    void Player::insert(const SizeType& i, const Piece& pc, const SmallPoint3& pt3)
+    {
+        _pieces.Set.emplace(_pieces.Set.begin() + i, pc, pt3);
+        _trackSoldier(i, true);
+        _repoint(i);
+        ++_onBoard;
+    }
+
     void Player::append(const Piece& pc)
     {
         _pieces.append(pc, UBD_PT3);
+        ++_handCts[getHandKind(pc)];
         ++_onHand;
     }
 
+    void Player::pop()
+    {
+        --_handCts[getHandKind(_pieces.pieceAt(_pieces.Set.size() - 1))];
+        _pieces.remove(_pieces.Set.size() - 1);
+        --_onHand;
+    }
+
+    void Player::lift(const SizeType& i)
+    {
+        placeAt(*_gameBoard, &NULL_PIECE, _pieces.pointAt(i));
+        _trackSoldier(i, false);
+        ++_handCts[getHandKind(_pieces.pieceAt(i))];
+        _nullifyIndex(i);
+        --_onBoard;
+        ++_onHand;
+    }
+
+    void Player::assign(const Piece* pieces, const uint16_t* locations, const SizeType& count)
+    {
+        _pieces.Set.clear();
+        _onBoard = 0;
+        _onHand = 0;
+        _numPieces = count;
+        _soldierFiles = 0;
+        std::fill(_soldierCts, _soldierCts + BOARD_WIDTH, 0);
+        std::fill(_handCts, _handCts + HAND_KIND_CT, 0);
+
+        for (SizeType i = 0; i < count; ++i)
+        {
+            append(pieces[i]);
+            if (locations[i] != LOCATION_IN_HAND)
+                drop(i, pointOf(locations[i]));
+        }
+    }
+
     const IndexedPiece& Player::operator [] (const SizeType& i) const
     {
         return _pieces.Set[i];
@@ -114,6 +187,32 @@ namespace Gungi
         return _numPieces;
     }
 
+    const uint16_t& Player::soldierFiles() const
+    {
+        return _soldierFiles;
+    }
+
+    const SizeType& Player::handCount(const SizeType& kind) const
+    {
+        return _handCts[kind];
+    }
+
+    SizeType Player::handKinds(SizeType* indices) const
+    {
+        SizeType seen[HAND_KIND_CT] = {};
+        SizeType kindCt = 0;
+        for (SizeType i = 0; i < _pieces.Set.size(); ++i)
+        {
+            if (!(isUnbounded(_pieces.pointAt(i))))
+                continue;
+
+            const SizeType kind = getHandKind(_pieces.pieceAt(i));
+            if (seen[kind]++ == 0)
+                indices[kindCt++] = i;
+        }
+        return kindCt;
+    }
+
     void Player::_nullifyIndex(const SizeType& i)
     {
         _pieces.pointAt(i) = UBD_PT3;
@@ -128,6 +227,26 @@ namespace Gungi
         return UNBOUNDED;
     }
 
+    void Player::_trackSoldier(const SizeType& i, bool add)
+    {
+        const Piece& piece = _pieces.pieceAt(i);
+        const SmallPoint3& pt3 = _pieces.pointAt(i);
+        if (isUnbounded(pt3) || !(piece.onHead()) || piece.getHead() != Head::Soldier)
+            return;
+
+        if (add && _soldierCts[pt3.x]++ == 0)
+            _soldierFiles |= 1 << pt3.x;
+        else if (!(add) && --_soldierCts[pt3.x] == 0)
+            _soldierFiles &= ~(1 << pt3.x);
+    }
+
+    void Player::_repoint(const SizeType& from)
+    {
+        for (SizeType i = from; i < _pieces.Set.size(); ++i)
+            if (!(isUnbounded(_pieces.pointAt(i))))
+                placeAt(*_gameBoard, &_pieces.pieceAt(i), _pieces.pointAt(i));
+    }
+
     Game::Game()
     : _onesTurn      (true)
     , _gameBoard     (BOARD_WIDTH, BOARD_DEPTH, BOARD_HEIGHT, &NULL_PIECE)
@@ -135,7 +254,33 @@ namespace Gungi
     , _two           (&_gameBoard, Color::White, Color::Black, ORIENTATION_NEG)
     , _phase         (Phase::Standby)
     , _currentPlayer (nullptr)
-    {}
+    , _winner        (Color::None)
+    , _boardKey      (0)
+    , _handKey       (0)
+    {
+        _history.reserve(256);
+        _plies.reserve(256);
+    }
+
+    Game::Game(const Game& other)
+    : _onesTurn      (other._onesTurn)
+    , _gameBoard     (other._gameBoard)
+    , _one           (other._one, &_gameBoard)
+    , _two           (other._two, &_gameBoard)
+    , _phase         (other._phase)
+    , _currentPlayer (nullptr)
+    , _winner        (other._winner)
+    , _boardKey      (other._boardKey)
+    , _handKey       (other._handKey)
+    , _towers        (other._towers)
+    , _history       (other._history)
+    , _plies         (other._plies)
+    {
+        if (other._currentPlayer != nullptr)
+            _currentPlayer = other._currentPlayer == &other._one ? &_one : &_two;
+        _history.reserve(256);
+        _plies.reserve(256);
+    }
 
     Game::~Game()
     {
@@ -146,8 +291,13 @@ namespace Gungi
     {
         if (_phase != Phase::Running)
         {
+            _onesTurn = true;
             _currentPlayer = &_one;
             ++_phase;
+            _computeKey();
+            _towers.refresh(_gameBoard);
+            _plies.clear();
+            _pushPly(false);
         }
     }
 
@@ -175,9 +325,11 @@ namespace Gungi
             cerr << "In Game::drop(), pt3: " << pt3 << endl;
         #endif
 
-        player->updatePoint(i, pt3);
-        placeAt(_gameBoard, &player->pieceAt(i), pt3);
+        player->drop(i, pt3);
         _flipPlayer();
+        _computeKey();
+        _towers.refresh(_gameBoard);
+        _pushPly(false);
         return state;
     }
 
@@ -224,10 +376,36 @@ namespace Gungi
         player->updatePoint(i, pt3); 
         placeAt(_gameBoard, &player->pieceAt(i), pt3);
         _flipPlayer();
+        _computeKey();
+        _towers.refresh(_gameBoard);
+        _pushPly(!(state.onOpponent));
 
         return state;
     }
             
+    IndexState Game::attack(const SizeType& i, const SmallPoint3& target)
+    {
+        #if (DEBUG)
+            cerr << "In Game::attack()" << endl;
+        #endif
+
+        auto state = assessAttack(_onesTurn, i, target);
+        if (!(state.validState))
+            return state;
+
+        Player* player = _onesTurn ? &_one : &_two;
+        Player* opponent = _onesTurn ? &_two : &_one;
+        Undo undo { Action(), _boardKey, _handKey, _winner, true, 0, NULL_PIECE };
+        _capture(player, opponent, target, undo);
+        _collapse(target);
+        _flipPlayer();
+        _computeKey();
+        _towers.refresh(_gameBoard);
+        _pushPly(false);
+
+        return state;
+    }
+
     IndexState Game::assessDrop(bool playerOne, const SizeType& i, SmallPoint3 pt3) const
     {
         #if (DEBUG)
@@ -240,7 +418,8 @@ namespace Gungi
         auto positiveOrientation = player->getOrientation();
 
         if (_phase == Phase::Standby || !(isUnbounded(point)) || 
-                !(validPlacementDrop(_gameBoard, piece, pt3, positiveOrientation)))
+                !(validPlacementDrop(_gameBoard, piece, pt3, player->soldierFiles(),
+                        positiveOrientation)))
             return IndexState(false, false, Tier::None);
 
         #if (DEBUG)
@@ -251,6 +430,10 @@ namespace Gungi
         if (!(positiveOrientation))
             pt3 = asPositive3(pt3);
 
+        // Towers cannot contain two allied pieces of the same name.
+        if (_towers.contains(squareOf(pt3), piece))
+            return IndexState(false, false, Tier::None);
+
         pt3.y = availableTierAt(_gameBoard, pt3);
         
 
@@ -264,6 +447,28 @@ namespace Gungi
         return IndexState(true, onOpponent, asTier(pt3.y));
     }
 
+    IndexState Game::assessAttack(bool playerOne, const SizeType& i,
+            const SmallPoint3& target) const
+    {
+        const Player* player = playerOne ? &_one : &_two;
+        const Piece& piece = player->pieceAt(i);
+        const SmallPoint3& point = player->pointAt(i);
+
+        if (!(_running()) || isUnbounded(point) || target.y >= BOARD_HEIGHT ||
+                target.x != point.x || target.z != point.z || 
+                (target.y != point.y + 1 && target.y + 1 != point.y))
+            return IndexState(false, false, Tier::None);
+
+        if (piece.onHead() && (piece.getHead() == Head::Catapult || 
+                    piece.getHead() == Head::Fortress))
+            return IndexState(false, false, Tier::None);
+
+        if (_gameBoard[target]->getActiveColor() != player->getOppColor())
+            return IndexState(false, false, Tier::None);
+
+        return IndexState(true, true, asTier(target.y));
+    }
+
     IndexState Game::assessMove(bool playerOne, const SizeType& i, const Move& move) const
     {
         #if (DEBUG)
@@ -320,6 +525,9 @@ namespace Gungi
 
         auto pt3 = player->getOrientation() == ORIENTATION_POS ? SmallPoint3(pt2) : 
             asPositive3(pt2);
+        if (_towers.contains(squareOf(pt3), piece))
+            return IndexState(false, false, Tier::None);
+
         pt3.y = availableTierAt(_gameBoard, pt3);
 
         IndexState state { true, true, Tier::None };
@@ -344,6 +552,220 @@ namespace Gungi
         return state;
     }
 
+    bool Game::setPosition(const Position& position)
+    {
+        bool occupied[BOARD_SQUARES * BOARD_HEIGHT] = {};
+        const Color colors[2] = { Color::Black, Color::White };
+        for (SizeType c = 0; c < 2; ++c)
+        {
+            if (position.counts[c] > MAX_SET_CT)
+                return false;
+
+            for (SizeType i = 0; i < position.counts[c]; ++i)
+            {
+                const Piece& piece = position.pieces[c][i];
+                const uint16_t& location = position.locations[c][i];
+                if (piece.isNull() || piece.getActiveColor() != colors[c])
+                    return false;
+
+                if (location == LOCATION_IN_HAND)
+                    continue;
+
+                if (location >= BOARD_SQUARES * BOARD_HEIGHT)
+                    return false;
+
+                bool& slot = occupied[location];
+                if (slot)
+                    return false;
+                slot = true;
+            }
+        }
+
+        for (SizeType square = 0; square < BOARD_SQUARES; ++square)
+            for (SizeType y = 1; y < BOARD_HEIGHT; ++y)
+                if (occupied[y * BOARD_SQUARES + square] && 
+                        !(occupied[(y - 1) * BOARD_SQUARES + square]))
+                    return false;
+
+        for (SizeType y = 0; y < BOARD_HEIGHT; ++y)
+            for (SizeType z = 0; z < BOARD_DEPTH; ++z)
+                for (SizeType x = 0; x < BOARD_WIDTH; ++x)
+                    placeAt(_gameBoard, &NULL_PIECE, SmallPoint3(x, z, y));
+
+        _one.assign(position.pieces[0], position.locations[0], position.counts[0]);
+        _two.assign(position.pieces[1], position.locations[1], position.counts[1]);
+        _phase = position.phase;
+        _onesTurn = position.toMove != Color::White;
+        _currentPlayer = _phase == Phase::Standby ? nullptr : (_onesTurn ? &_one : &_two);
+
+        _winner = Color::None;
+        for (const Player* player : { &_one, &_two })
+            for (SizeType i = 0; i < player->getFullSet().Set.size(); ++i)
+                if (player->pieceAt(i).getHead() == Head::Commander && 
+                        !(player->pieceAt(i).onHead()))
+                    _winner = player->getColor();
+
+        _history.clear();
+        _computeKey();
+        _towers.refresh(_gameBoard);
+        _plies.clear();
+        _pushPly(false);
+        return true;
+    }
+
+    void Game::make(const Action& action)
+    {
+        Player* player = _currentPlayer;
+        Player* opponent = _onesTurn ? &_two : &_one;
+        Undo undo { action, _boardKey, _handKey, _winner, false, 0, NULL_PIECE };
+
+        if (action.type == ActionType::Drop)
+        {
+            const Piece& piece = player->pieceAt(action.index);
+            _handKey -= handKey(player->getColor(), getHandKind(piece));
+            player->drop(action.index, action.destination);
+            _boardKey ^= pieceKey(piece, action.destination);
+        }
+        else if (action.type == ActionType::Immobile)
+        {
+            undo.captured = true;
+            _capture(player, opponent, action.destination, undo);
+            _collapse(action.destination);
+        }
+        else
+        {
+            if (action.onOpponent)
+            {
+                undo.captured = true;
+                _capture(player, opponent, action.destination, undo);
+            }
+
+            const Piece& piece = player->pieceAt(action.index);
+            _boardKey ^= pieceKey(piece, action.origin) ^ pieceKey(piece, action.destination);
+            placeAt(_gameBoard, &NULL_PIECE, action.origin);
+            player->updatePoint(action.index, action.destination);
+            placeAt(_gameBoard, &piece, action.destination);
+        }
+
+        _refreshTowers(action);
+        _history.push_back(undo);
+        _flipPlayer();
+        _boardKey ^= sideKey();
+        _pushPly(action.type == ActionType::Move && !(action.onOpponent));
+    }
+
+    void Game::unmake()
+    {
+        if (_history.empty())
+            return;
+
+        const Undo& undo = _history.back();
+        const Action& action = undo.action;
+        _flipPlayer();
+        Player* player = _currentPlayer;
+        Player* opponent = _onesTurn ? &_two : &_one;
+
+        if (action.type == ActionType::Drop)
+            player->lift(action.index);
+        else if (action.type == ActionType::Immobile)
+        {
+            _uncollapse(action.destination);
+            player->pop();
+            opponent->insert(undo.capturedIndex, undo.capturedPiece, action.destination);
+        }
+        else
+        {
+            placeAt(_gameBoard, &NULL_PIECE, action.destination);
+            player->updatePoint(action.index, action.origin);
+            placeAt(_gameBoard, &player->pieceAt(action.index), action.origin);
+
+            if (undo.captured)
+            {
+                player->pop();
+                opponent->insert(undo.capturedIndex, undo.capturedPiece, action.destination);
+            }
+        }
+
+        _refreshTowers(action);
+        _boardKey = undo.boardKey;
+        _handKey = undo.handKey;
+        _winner = undo.winner;
+        _history.pop_back();
+        if (!(_plies.empty()))
+            _plies.pop_back();
+    }
+
+    void Game::_pushPly(bool reversible)
+    {
+        const uint16_t previous = _plies.empty() ? 0 : _plies.back().reversible;
+        _plies.push_back(Ply { getKey(), static_cast<uint16_t>(reversible ? previous + 1 : 0) });
+    }
+
+    void Game::_refreshTowers(const Action& action)
+    {
+        const SizeType destination = squareOf(action.destination);
+        _towers.refresh(_gameBoard, destination);
+        if (!(isUnbounded(action.origin)) && squareOf(action.origin) != destination)
+            _towers.refresh(_gameBoard, squareOf(action.origin));
+    }
+
+    void Game::_capture(Player* player, Player* opponent, const SmallPoint3& pt3, Undo& undo)
+    {
+        undo.capturedIndex = opponent->getIndexAt(pt3);
+        undo.capturedPiece = opponent->pieceAt(undo.capturedIndex);
+        _boardKey ^= pieceKey(undo.capturedPiece, pt3);
+        opponent->remove(undo.capturedIndex);
+
+        if (undo.capturedPiece.onHead() && undo.capturedPiece.getHead() == Head::Commander)
+            _winner = player->getColor();
+
+        Piece captured = undo.capturedPiece;
+        captured.flip();
+        player->append(captured);
+        _handKey += handKey(player->getColor(), getHandKind(captured));
+    }
+
+    void Game::_collapse(SmallPoint3 pt3)
+    {
+        for (; pt3.y + 1 < BOARD_HEIGHT; ++pt3.y)
+        {
+            const SmallPoint3 above(pt3.x, pt3.z, pt3.y + 1);
+            const Piece* piece = _gameBoard[above];
+            if (piece->isNull())
+                break;
+
+            Player* owner = _ownerOf(*piece);
+            _boardKey ^= pieceKey(*piece, above) ^ pieceKey(*piece, pt3);
+            owner->updatePoint(owner->getIndexAt(above), pt3);
+            placeAt(_gameBoard, piece, pt3);
+        }
+        placeAt(_gameBoard, &NULL_PIECE, pt3);
+    }
+
+    void Game::_uncollapse(const SmallPoint3& pt3)
+    {
+        SizeType top = pt3.y;
+        while (top < BOARD_HEIGHT && !(isNullAt(_gameBoard, SmallPoint3(pt3.x, pt3.z, top))))
+            ++top;
+
+        // Every piece from pt3 up descended a tier, lift them back from the top down.
+        while (top-- > pt3.y)
+        {
+            const SmallPoint3 from(pt3.x, pt3.z, top);
+            const SmallPoint3 to(pt3.x, pt3.z, top + 1);
+            const Piece* piece = _gameBoard[from];
+            Player* owner = _ownerOf(*piece);
+            owner->updatePoint(owner->getIndexAt(from), to);
+            placeAt(_gameBoard, piece, to);
+        }
+        placeAt(_gameBoard, &NULL_PIECE, pt3);
+    }
+
+    Player* Game::_ownerOf(const Piece& piece)
+    {
+        return piece.getActiveColor() == _one.getColor() ? &_one : &_two;
+    }
+
     const Board* Game::gameBoard() const
     {
         return &_gameBoard;
@@ -364,6 +786,48 @@ namespace Gungi
         return _currentPlayer; 
     }
 
+    const Player* Game::idlePlayer() const
+    {
+        if (!(_currentPlayer))
+            return nullptr;
+        return _onesTurn ? &_two : &_one;
+    }
+
+    const Color& Game::getWinner() const
+    {
+        return _winner;
+    }
+
+    Key Game::getKey() const
+    {
+        return _boardKey ^ _handKey;
+    }
+
+    uint16_t Game::repetitions() const
+    {
+        if (_plies.empty())
+            return 0;
+
+        // The side to move is part of the key, only every other ply can match.
+        const Ply& current = _plies.back();
+        const size_t last = _plies.size() - 1;
+        uint16_t count = 0;
+        for (size_t back = 2; back <= current.reversible; back += 2)
+            if (_plies[last - back].key == current.key)
+                ++count;
+        return count;
+    }
+
+    uint16_t Game::reversiblePlies() const
+    {
+        return _plies.empty() ? 0 : _plies.back().reversible;
+    }
+
+    const TowerMasks& Game::towers() const
+    {
+        return _towers;
+    }
+
     const Phase& Game::getPhase() const
     {
         return _phase;
@@ -396,6 +860,26 @@ namespace Gungi
         //Returning Piece&& and using move-semantics can shrink these 3 lines to 1
         auto piece = opponent->pieceAt(pieceIndex);
         opponent->remove(pieceIndex);
+        if (piece.onHead() && piece.getHead() == Head::Commander)
+            _winner = _currentPlayer->getColor();
+        piece.flip();
         _currentPlayer->append(piece); 
     }
+
+    void Game::_computeKey()
+    {
+        _boardKey = _onesTurn ? 0 : sideKey();
+        _handKey = 0;
+        for (const Player* player : { &_one, &_two })
+        {
+            const PieceSet& pieces = player->getFullSet();
+            for (SizeType i = 0; i < pieces.Set.size(); ++i)
+            {
+                if (isUnbounded(pieces.pointAt(i)))
+                    _handKey += handKey(player->getColor(), getHandKind(pieces.pieceAt(i)));
+                else
+                    _boardKey ^= pieceKey(pieces.pieceAt(i), pieces.pointAt(i));
+            }
+        }
+    }
 }
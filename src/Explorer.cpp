@@ -0,0 +1,423 @@
+/*
+ * Copyright 2016 Fermin, Yaneury <fermin.yaneury@gmail.com>
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <mutex>
+
+#include <Explorer.hpp>
+#include <FileIo.hpp>
+#include <Parallel.hpp>
+
+namespace Gungi
+{
+    namespace
+    {
+        constexpr size_t HEADER_SIZE  = 32; /**< Bytes before the key column. */
+        constexpr size_t SHARD_CT     = size_t(1) << EXPLORER_SHARD_BITS;
+        constexpr size_t BUILD_CHUNK  = 256; /**< Games a thread takes at a time. */
+        constexpr size_t GUESSES      = 16; /**< Interpolated probes before halving. */
+        constexpr size_t TABLE_START  = 1024; /**< Slots of a new tally table. */
+
+        /**
+         * A position reached in a game, with the action played from it (0 for the last
+         * position of the game) and the result of the game.
+         */
+        struct Sample
+        {
+            Key key;
+            uint32_t code;
+            uint32_t result;
+        };
+
+        /**
+         * How often an action was played from a position, by result. A position gets a
+         * tally per distinct action, its count is the sum of their results.
+         */
+        struct Tally
+        {
+            Key key;
+            uint32_t code;
+            uint32_t results[3];
+        };
+
+        /**
+         * A row of the table as it is stored.
+         */
+        struct Row
+        {
+            uint32_t count;
+            uint32_t results[3];
+            uint32_t actions[2 * EXPLORER_ACTIONS]; /**< Code and count pairs. */
+        };
+
+        constexpr size_t ROW_SIZE = sizeof (Row);
+
+        /**
+         * This class is an open addressing hash table of the tallies of a shard, so a
+         * shard holds a tally per distinct position and action rather than every sample.
+         */
+        class TallyTable
+        {
+            public:
+
+                TallyTable()
+                : _slots    (TABLE_START)
+                , _size     (0)
+                {}
+
+                void add(const Sample& sample)
+                {
+                    Tally& tally = _find(sample.key, sample.code);
+                    if (_empty(tally))
+                    {
+                        tally.key = sample.key;
+                        tally.code = sample.code;
+                        ++_size;
+                    }
+                    ++tally.results[sample.result];
+
+                    // Grown past three quarters full so probe runs stay short.
+                    if (4 * _size > 3 * _slots.size())
+                        _grow();
+                }
+
+                /**
+                 * This method moves the tallies out sorted by key, then code, and empties
+                 * the table.
+                 */
+                void drain(std::vector<Tally>& tallies)
+                {
+                    tallies.clear();
+                    tallies.reserve(_size);
+                    for (const Tally& tally : _slots)
+                        if (!(_empty(tally)))
+                            tallies.push_back(tally);
+                    std::vector<Tally>().swap(_slots);
+                    _size = 0;
+
+                    std::sort(tallies.begin(), tallies.end(), [] (const Tally& lhs,
+                                const Tally& rhs)
+                    {
+                        return lhs.key < rhs.key || (lhs.key == rhs.key && lhs.code < rhs.code);
+                    });
+                }
+
+            private:
+                static bool _empty(const Tally& tally)
+                {
+                    return (tally.results[0] | tally.results[1] | tally.results[2]) == 0;
+                }
+
+                Tally& _find(const Key& key, const uint32_t& code)
+                {
+                    // The top key bits chose the shard, the low ones are still uniform.
+                    const size_t mask = _slots.size() - 1;
+                    size_t i = static_cast<size_t>(key ^ (code * 0x9E3779B97F4A7C15ull)) & mask;
+                    while (!(_empty(_slots[i])) && (_slots[i].key != key || _slots[i].code != code))
+                        i = (i + 1) & mask;
+                    return _slots[i];
+                }
+
+                void _grow()
+                {
+                    std::vector<Tally> slots(2 * _slots.size(), Tally());
+                    slots.swap(_slots);
+                    for (const Tally& tally : slots)
+                        if (!(_empty(tally)))
+                            _find(tally.key, tally.code) = tally;
+                }
+
+                std::vector<Tally> _slots;
+                size_t _size; /**< Occupied slots. */
+        };
+
+        /**
+         * Folds the sorted tallies of a shard into a row per key.
+         */
+        void aggregate(const std::vector<Tally>& tallies, std::vector<Key>& keys,
+                std::vector<Row>& rows)
+        {
+            std::vector<std::pair<uint32_t, uint32_t>> played;
+            for (size_t i = 0; i < tallies.size(); )
+            {
+                Row row = {};
+                played.clear();
+                const Key key = tallies[i].key;
+                for (; i < tallies.size() && tallies[i].key == key; ++i)
+                {
+                    uint32_t count = 0;
+                    for (size_t r = 0; r < 3; ++r)
+                    {
+                        row.results[r] += tallies[i].results[r];
+                        count += tallies[i].results[r];
+                    }
+                    row.count += count;
+                    if (tallies[i].code != 0)
+                        played.emplace_back(tallies[i].code, count);
+                }
+
+                // Most played first, ties to the lower code so builds are reproducible.
+                const size_t kept = std::min(played.size(), EXPLORER_ACTIONS);
+                std::partial_sort(played.begin(), played.begin() + kept, played.end(),
+                        [] (const std::pair<uint32_t, uint32_t>& lhs,
+                            const std::pair<uint32_t, uint32_t>& rhs)
+                        {
+                            return lhs.second > rhs.second ||
+                                (lhs.second == rhs.second && lhs.first < rhs.first);
+                        });
+                for (size_t k = 0; k < kept; ++k)
+                {
+                    row.actions[2 * k] = played[k].first;
+                    row.actions[2 * k + 1] = played[k].second;
+                }
+
+                keys.push_back(key);
+                rows.push_back(row);
+            }
+        }
+
+        /**
+         * The scratch state of a build thread, kept across the chunks it takes.
+         */
+        struct BuildScratch
+        {
+            BuildScratch()
+            : samples (SHARD_CT)
+            {}
+
+            Game game; /**< Game being replayed. */
+            std::vector<std::vector<Sample>> samples; /**< Samples to tally, by shard. */
+            std::vector<Sample> played; /**< Samples of the game being replayed. */
+            ActionList actions; /**< Scratch list for decoding actions. */
+        };
+    }
+
+    bool buildExplorer(const std::vector<std::string>& paths, const std::string& path,
+            ExplorerBuild& build, SizeType threads)
+    {
+        build = ExplorerBuild();
+
+        std::vector<std::unique_ptr<GameRecordReader>> readers;
+        std::vector<RecordChunk> chunks;
+        if (!(chunkRecords(paths, readers, chunks, BUILD_CHUNK)))
+            return false;
+
+        threads = std::max<SizeType>(1, std::min<size_t>(threadCount(threads),
+                    std::max<size_t>(chunks.size(), 1)));
+        std::vector<TallyTable> tables(SHARD_CT);
+        std::unique_ptr<std::mutex[]> locks(new std::mutex[SHARD_CT]);
+        std::vector<ExplorerBuild> parts(threads, ExplorerBuild());
+
+        // Each task replays a chunk of games, then tallies its samples a shard at a time.
+        std::unique_ptr<BuildScratch[]> scratch(new BuildScratch[threads]);
+        parallelForWorkers(chunks.size(), threads, [&] (const SizeType& t, const size_t& c)
+        {
+            Game& game = scratch[t].game;
+            std::vector<std::vector<Sample>>& samples = scratch[t].samples;
+            std::vector<Sample>& played = scratch[t].played;
+            const RecordChunk& chunk = chunks[c];
+            for (size_t g = chunk.first; g < chunk.first + chunk.count; ++g)
+            {
+                const RecordView record = (*(readers[chunk.file]))[g];
+                const RecordHeader header = record.header();
+                ++parts[t].games;
+                if (!(loadPacked(record.start(), game)))
+                {
+                    ++parts[t].skipped;
+                    continue;
+                }
+
+                const uint32_t result = static_cast<uint32_t>(header.result) % 3;
+                played.clear();
+                bool decoded = true;
+                for (uint16_t ply = 0; decoded && ply < header.plies; ++ply)
+                {
+                    // A phase advance isn't a move out of the position.
+                    const uint32_t code = record.action(ply);
+                    if (code != PHASE_CODE)
+                        played.push_back({ game.getKey(), code, result });
+                    decoded = playCode(game, code, scratch[t].actions);
+                }
+
+                if (!(decoded))
+                {
+                    ++parts[t].skipped;
+                    continue;
+                }
+
+                played.push_back({ game.getKey(), 0, result });
+                for (const Sample& sample : played)
+                    samples[sample.key >> (64 - EXPLORER_SHARD_BITS)].push_back(sample);
+                parts[t].positions += played.size();
+            }
+
+            for (size_t s = 0; s < SHARD_CT; ++s)
+            {
+                if (samples[s].empty())
+                    continue;
+
+                std::lock_guard<std::mutex> lock(locks[s]);
+                for (const Sample& sample : samples[s])
+                    tables[s].add(sample);
+                samples[s].clear();
+            }
+        });
+
+        for (const ExplorerBuild& part : parts)
+        {
+            build.games += part.games;
+            build.skipped += part.skipped;
+            build.positions += part.positions;
+        }
+
+        // Shards are disjoint key ranges in key order, each is folded on its own.
+        std::vector<std::vector<Key>> keys(SHARD_CT);
+        std::vector<std::vector<Row>> rows(SHARD_CT);
+        parallelFor(SHARD_CT, threads, [&] (const size_t& s)
+        {
+            std::vector<Tally> tallies;
+            tables[s].drain(tallies);
+            aggregate(tallies, keys[s], rows[s]);
+        });
+
+        for (size_t s = 0; s < SHARD_CT; ++s)
+            build.entries += keys[s].size();
+
+        std::FILE* file = std::fopen(path.c_str(), "wb");
+        if (file == nullptr)
+            return false;
+
+        uint8_t header[HEADER_SIZE] = {};
+        writeU32(header, EXPLORER_MAGIC);
+        writeU32(header + 4, EXPLORER_VERSION);
+        writeU64(header + 8, build.entries);
+        bool ok = std::fwrite(header, HEADER_SIZE, 1, file) == 1;
+        for (size_t s = 0; ok && s < SHARD_CT; ++s)
+            ok = keys[s].empty() ||
+                std::fwrite(keys[s].data(), sizeof (Key), keys[s].size(), file) == keys[s].size();
+        for (size_t s = 0; ok && s < SHARD_CT; ++s)
+            ok = rows[s].empty() ||
+                std::fwrite(rows[s].data(), ROW_SIZE, rows[s].size(), file) == rows[s].size();
+        return std::fclose(file) == 0 && ok;
+    }
+
+    Explorer::Explorer()
+    : _data     (nullptr)
+    , _size     (0)
+    , _keys     (nullptr)
+    , _rows     (nullptr)
+    , _count    (0)
+    {}
+
+    Explorer::~Explorer()
+    {
+        close();
+    }
+
+    bool Explorer::open(const std::string& path)
+    {
+        close();
+
+        // Lookups jump around, read ahead would only evict useful pages.
+        _data = mapFile(path, _size, HEADER_SIZE, MADV_RANDOM);
+        if (_data == nullptr)
+            return false;
+
+        _count = readU64(_data + 8);
+        if (readU32(_data) != EXPLORER_MAGIC || readU32(_data + 4) != EXPLORER_VERSION ||
+                _count > (_size - HEADER_SIZE) / (sizeof (Key) + ROW_SIZE) ||
+                HEADER_SIZE + _count * (sizeof (Key) + ROW_SIZE) != _size)
+        {
+            close();
+            return false;
+        }
+
+        _keys = _data + HEADER_SIZE;
+        _rows = _keys + _count * sizeof (Key);
+        return true;
+    }
+
+    void Explorer::close()
+    {
+        unmapFile(_data, _size);
+        _data = _keys = _rows = nullptr;
+        _size = 0;
+        _count = 0;
+    }
+
+    uint64_t Explorer::size() const
+    {
+        return _count;
+    }
+
+    bool Explorer::find(const Key& key, ExplorerEntry& entry) const
+    {
+        uint64_t low = 0;
+        uint64_t high = _count;
+        for (size_t probe = 0; low < high; ++probe)
+        {
+            const Key lowKey = _keyAt(low);
+            const Key highKey = _keyAt(high - 1);
+            if (key < lowKey || key > highKey)
+                return false;
+
+            uint64_t mid = low + (high - low) / 2;
+            if (probe < GUESSES && highKey != lowKey)
+            {
+                const double fraction = static_cast<double>(key - lowKey) /
+                    static_cast<double>(highKey - lowKey);
+                mid = low + static_cast<uint64_t>(fraction * static_cast<double>(high - 1 - low));
+            }
+            mid = std::min(mid, high - 1);
+
+            const Key midKey = _keyAt(mid);
+            if (midKey < key)
+                low = mid + 1;
+            else if (midKey > key)
+                high = mid;
+            else
+            {
+                Row row;
+                std::memcpy(&row, _rows + mid * ROW_SIZE, ROW_SIZE);
+                entry.count = row.count;
+                std::copy(row.results, row.results + 3, entry.results);
+                entry.actionCt = 0;
+                for (; entry.actionCt < EXPLORER_ACTIONS && row.actions[2 * entry.actionCt];
+                        ++entry.actionCt)
+                {
+                    entry.actions[entry.actionCt] = row.actions[2 * entry.actionCt];
+                    entry.actionCounts[entry.actionCt] = row.actions[2 * entry.actionCt + 1];
+                }
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool Explorer::find(const Game& game, ExplorerEntry& entry) const
+    {
+        return find(game.getKey(), entry);
+    }
+
+    Key Explorer::_keyAt(const uint64_t& i) const
+    {
+        Key key;
+        std::memcpy(&key, _keys + i * sizeof (Key), sizeof (Key));
+        return key;
+    }
+}
@@ -0,0 +1,507 @@
+/*
+ * Copyright 2016 Fermin, Yaneury <fermin.yaneury@gmail.com>
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <cstring>
+
+#include <FileIo.hpp>
+#include <GameRecord.hpp>
+
+namespace Gungi
+{
+    namespace
+    {
+        constexpr uint32_t LOCATION_MASK = 0x1FF; /**< Bits of a location in a code. */
+        constexpr uint32_t STATE_MASK    = 0x3F; /**< Bits of a packed state in a code. */
+        constexpr uint32_t CAPTURE_BIT   = 1u << 11; /**< Set if the action captures. */
+
+        /**
+         * This function returns the size of a record from its size field and header, or 0
+         * if the size doesn't match the ply count.
+         */
+        size_t lengthOf(const uint8_t* record)
+        {
+            const size_t length = 4 + static_cast<size_t>(readU32(record));
+            const size_t plies = readU16(record + 16);
+            return length == RECORD_FIXED_SIZE + 4 * plies ? length : 0;
+        }
+
+        /**
+         * This function returns the size of the record at offset in a mapped file.
+         * @return the size of the record, or 0 if it is malformed or overruns the file
+         */
+        size_t recordSize(const uint8_t* data, const size_t& size, const uint64_t& offset)
+        {
+            if (offset + RECORD_FIXED_SIZE > size)
+                return 0;
+
+            const size_t length = lengthOf(data + offset);
+            return offset + length > size ? 0 : length;
+        }
+
+        /**
+         * This function returns the size of the record at offset in a record file.
+         * @return the size of the record, or 0 if it is malformed or overruns end
+         */
+        size_t recordSize(std::FILE* records, const uint64_t& offset, const uint64_t& end)
+        {
+            uint8_t fixed[4 + RECORD_HEADER_SIZE];
+            if (offset + RECORD_FIXED_SIZE > end ||
+                    std::fseek(records, static_cast<long>(offset), SEEK_SET) != 0 ||
+                    std::fread(fixed, sizeof (fixed), 1, records) != 1)
+                return 0;
+
+            const size_t length = lengthOf(fixed);
+            return offset + length > end ? 0 : length;
+        }
+
+        /**
+         * This function checks that the last offset of an index file names the last record.
+         * @param records an open record file
+         * @param path path of the index file
+         * @param end size of the record file
+         * @return true if the index is whole
+         */
+        bool indexMatches(std::FILE* records, const std::string& path, const uint64_t& end)
+        {
+            std::FILE* index = std::fopen(path.c_str(), "rb");
+            if (index == nullptr)
+                return end == RECORD_FILE_HEADER;
+
+            uint8_t last[8];
+            bool matches = false;
+            if (std::fseek(index, 0, SEEK_END) == 0)
+            {
+                const long size = std::ftell(index);
+                if (size == 0)
+                    matches = end == RECORD_FILE_HEADER;
+                else if (size % 8 == 0 && std::fseek(index, -8, SEEK_END) == 0 &&
+                        std::fread(last, 8, 1, index) == 1)
+                {
+                    const uint64_t offset = readU64(last);
+                    const size_t length = recordSize(records, offset, end);
+                    matches = length != 0 && offset + length == end;
+                }
+            }
+
+            std::fclose(index);
+            return matches;
+        }
+
+        /**
+         * This function rewrites an index file from the records. A record torn by a crash
+         * is cut off the end of the record file.
+         * @param records an open record file
+         * @param path path of the index file
+         * @param end an in/out parameter: the size of the record file
+         * @return false if the files couldn't be written
+         */
+        bool rebuildIndex(std::FILE* records, const std::string& path, uint64_t& end)
+        {
+            std::FILE* index = std::fopen(path.c_str(), "wb");
+            if (index == nullptr)
+                return false;
+
+            uint64_t offset = RECORD_FILE_HEADER;
+            bool written = true;
+            for (size_t length; written && (length = recordSize(records, offset, end)) != 0;
+                    offset += length)
+            {
+                uint8_t entry[8];
+                writeU64(entry, offset);
+                written = std::fwrite(entry, 8, 1, index) == 1;
+            }
+
+            written = std::fclose(index) == 0 && written;
+            if (written && offset != end)
+            {
+                written = ::ftruncate(::fileno(records), static_cast<off_t>(offset)) == 0;
+                end = offset;
+            }
+            return written;
+        }
+    }
+
+    uint32_t encodeAction(const Game& game, const Action& action)
+    {
+        uint32_t code = static_cast<uint32_t>(action.type) << 30 |
+            static_cast<uint32_t>(locationOf(action.destination)) << 21 |
+            static_cast<uint32_t>(locationOf(action.origin)) << 12;
+        if (action.onOpponent)
+            code |= CAPTURE_BIT;
+        if (action.type == ActionType::Drop)
+            code |= packedState(game.currentPlayer()->getFullSet().pieceAt(action.index));
+        return code;
+    }
+
+    bool decodeAction(const Game& game, const uint32_t& code, Action& action)
+    {
+        const Player* player = game.currentPlayer();
+        const ActionType type = static_cast<ActionType>(code >> 30);
+        const uint16_t destination = (code >> 21) & LOCATION_MASK;
+        const uint16_t origin = (code >> 12) & LOCATION_MASK;
+        if (player == nullptr || type == ActionType::None || destination == LOCATION_IN_HAND ||
+                destination >= BOARD_SQUARES * BOARD_HEIGHT)
+            return false;
+
+        const PieceSet& pieces = player->getFullSet();
+        SizeType index = UNBOUNDED;
+        if (type == ActionType::Drop)
+        {
+            const uint16_t state = code & STATE_MASK;
+            for (SizeType i = 0; i < pieces.Set.size() && index == UNBOUNDED; ++i)
+                if (isUnbounded(pieces.pointAt(i)) && packedState(pieces.pieceAt(i)) == state)
+                    index = i;
+        }
+        else if (origin < BOARD_SQUARES * BOARD_HEIGHT)
+            index = player->getIndexAt(pointOf(origin));
+
+        if (index == UNBOUNDED)
+            return false;
+
+        action = Action(type, index, pointOf(origin), pointOf(destination),
+                (code & CAPTURE_BIT) != 0);
+        return true;
+    }
+
+    bool canAdvance(const Game& game)
+    {
+        return game.getPhase() != Phase::Running && game.getWinner() == Color::None;
+    }
+
+    bool playCode(Game& game, const uint32_t& code, ActionList& actions)
+    {
+        if (code == PHASE_CODE)
+        {
+            if (!(canAdvance(game)))
+                return false;
+
+            game.start();
+            return true;
+        }
+
+        // The generator is the rules: a recorded action must be one of its actions.
+        genActions(game, actions);
+        for (size_t i = 0; i < actions.size(); ++i)
+            if (encodeAction(game, actions[i]) == code)
+            {
+                game.make(actions[i]);
+                return true;
+            }
+        return false;
+    }
+
+    GameLog::GameLog()
+    : _phase    (Phase::Standby)
+    {
+        _actions.reserve(256);
+    }
+
+    bool GameLog::begin(const Game& game)
+    {
+        _actions.clear();
+        _phase = game.getPhase();
+        return packPosition(game, _start);
+    }
+
+    void GameLog::record(const Game& game, const Action& action)
+    {
+        for (; _phase < game.getPhase(); ++_phase)
+            _actions.push_back(PHASE_CODE);
+        _actions.push_back(encodeAction(game, action));
+    }
+
+    const PackedPosition& GameLog::start() const
+    {
+        return _start;
+    }
+
+    const std::vector<uint32_t>& GameLog::actions() const
+    {
+        return _actions;
+    }
+
+    GameRecordWriter::GameRecordWriter()
+    : _records  (nullptr)
+    , _index    (nullptr)
+    , _offset   (0)
+    {}
+
+    GameRecordWriter::~GameRecordWriter()
+    {
+        close();
+    }
+
+    bool GameRecordWriter::open(const std::string& path)
+    {
+        close();
+
+        _records = std::fopen(path.c_str(), "ab+");
+        if (_records == nullptr || std::fseek(_records, 0, SEEK_END) != 0)
+            return !(close());
+
+        const long end = std::ftell(_records);
+        uint8_t header[RECORD_FILE_HEADER];
+        if (end == 0)
+        {
+            writeU32(header, RECORD_MAGIC);
+            writeU32(header + 4, GAME_RECORD_VERSION);
+            if (std::fwrite(header, RECORD_FILE_HEADER, 1, _records) != 1)
+                return !(close());
+        }
+        else if (end < static_cast<long>(RECORD_FILE_HEADER) ||
+                std::fseek(_records, 0, SEEK_SET) != 0 ||
+                std::fread(header, RECORD_FILE_HEADER, 1, _records) != 1 ||
+                readU32(header) != RECORD_MAGIC || readU32(header + 4) != GAME_RECORD_VERSION)
+            return !(close());
+
+        // A crash can leave a torn record or an index short of the last record.
+        uint64_t offset = end == 0 ? RECORD_FILE_HEADER : static_cast<uint64_t>(end);
+        const std::string indexPath = path + ".idx";
+        if (!(indexMatches(_records, indexPath, offset)) &&
+                !(rebuildIndex(_records, indexPath, offset)))
+            return !(close());
+
+        _offset = offset;
+        _index = std::fopen(indexPath.c_str(), "ab");
+        if (_index == nullptr)
+            return !(close());
+
+        return true;
+    }
+
+    bool GameRecordWriter::write(const RecordHeader& header, const PackedPosition& start,
+            const uint32_t* actions)
+    {
+        if (_records == nullptr)
+            return false;
+
+        uint8_t fixed[RECORD_FIXED_SIZE];
+        writeU32(fixed, static_cast<uint32_t>(RECORD_FIXED_SIZE - 4 + 4 * header.plies));
+        writeU64(fixed + 4, header.id);
+        writeU32(fixed + 12, header.time);
+        writeU16(fixed + 16, header.plies);
+        fixed[18] = static_cast<uint8_t>(header.result);
+        fixed[19] = static_cast<uint8_t>(header.termination);
+        std::memcpy(fixed + 4 + RECORD_HEADER_SIZE, start.bytes, PACKED_SIZE);
+
+        uint8_t buffer[1024];
+        if (std::fwrite(fixed, RECORD_FIXED_SIZE, 1, _records) != 1)
+            return false;
+
+        for (size_t i = 0; i < header.plies; i += sizeof (buffer) / 4)
+        {
+            const size_t count = std::min<size_t>(header.plies - i, sizeof (buffer) / 4);
+            for (size_t k = 0; k < count; ++k)
+                writeU32(buffer + 4 * k, actions[i + k]);
+            if (std::fwrite(buffer, 4 * count, 1, _records) != 1)
+                return false;
+        }
+
+        // The index only ever names records that reached the file.
+        uint8_t offset[8];
+        writeU64(offset, _offset);
+        if (std::fflush(_records) != 0 || std::fwrite(offset, 8, 1, _index) != 1)
+            return false;
+
+        _offset += RECORD_FIXED_SIZE + 4 * header.plies;
+        return true;
+    }
+
+    bool GameRecordWriter::write(RecordHeader header, const GameLog& log)
+    {
+        header.plies = static_cast<uint16_t>(log.actions().size());
+        return write(header, log.start(), log.actions().data());
+    }
+
+    bool GameRecordWriter::close()
+    {
+        bool closed = true;
+        if (_records)
+            closed = std::fclose(_records) == 0;
+        if (_index)
+            closed = std::fclose(_index) == 0 && closed;
+
+        _records = _index = nullptr;
+        _offset = 0;
+        return closed;
+    }
+
+    RecordView::RecordView(const uint8_t* record)
+    : _record   (record)
+    {}
+
+    RecordHeader RecordView::header() const
+    {
+        RecordHeader header;
+        header.id = readU64(_record + 4);
+        header.time = readU32(_record + 12);
+        header.plies = readU16(_record + 16);
+        header.result = static_cast<Color>(_record[18]);
+        header.termination = static_cast<Termination>(_record[19]);
+        return header;
+    }
+
+    const PackedPosition& RecordView::start() const
+    {
+        return *reinterpret_cast<const PackedPosition*>(_record + 4 + RECORD_HEADER_SIZE);
+    }
+
+    uint32_t RecordView::action(const uint16_t& ply) const
+    {
+        return readU32(_record + RECORD_FIXED_SIZE + 4 * static_cast<size_t>(ply));
+    }
+
+    uint32_t RecordView::size() const
+    {
+        return 4 + readU32(_record);
+    }
+
+    GameRecordReader::Iterator::Iterator(const uint8_t* at, const uint8_t* end)
+    : _at   (at)
+    , _end  (end)
+    {}
+
+    RecordView GameRecordReader::Iterator::operator * () const
+    {
+        return RecordView(_at);
+    }
+
+    GameRecordReader::Iterator& GameRecordReader::Iterator::operator ++ ()
+    {
+        _at += 4 + readU32(_at);
+        if (_at > _end)
+            _at = _end;
+        return *this;
+    }
+
+    bool GameRecordReader::Iterator::operator != (const Iterator& rhs) const
+    {
+        return _at != rhs._at;
+    }
+
+    GameRecordReader::GameRecordReader()
+    : _data         (nullptr)
+    , _size         (0)
+    , _indexData    (nullptr)
+    , _indexSize    (0)
+    , _count        (0)
+    {}
+
+    GameRecordReader::~GameRecordReader()
+    {
+        close();
+    }
+
+    bool GameRecordReader::open(const std::string& path)
+    {
+        close();
+
+        // Records are read front to back.
+        _data = mapFile(path, _size, RECORD_FILE_HEADER, MADV_SEQUENTIAL);
+        if (_data == nullptr || readU32(_data) != RECORD_MAGIC ||
+                readU32(_data + 4) != GAME_RECORD_VERSION)
+        {
+            close();
+            return false;
+        }
+
+        // The index is trusted if it starts at the first record and ends at the last.
+        _indexData = mapFile(path + ".idx", _indexSize, 8, MADV_SEQUENTIAL);
+        const size_t indexed = _indexSize / 8;
+        if (_indexData != nullptr && _indexSize % 8 == 0 &&
+                readU64(_indexData) == RECORD_FILE_HEADER)
+        {
+            const uint64_t last = readU64(_indexData + 8 * (indexed - 1));
+            const size_t length = recordSize(_data, _size, last);
+            if (length != 0 && last + length == _size)
+            {
+                _count = indexed;
+                return true;
+            }
+        }
+
+        unmapFile(_indexData, _indexSize);
+        _indexData = nullptr;
+        _indexSize = 0;
+
+        for (uint64_t offset = RECORD_FILE_HEADER; offset < _size; )
+        {
+            const size_t length = recordSize(_data, _size, offset);
+            if (length == 0)
+            {
+                close();
+                return false;
+            }
+
+            _offsets.push_back(offset);
+            offset += length;
+        }
+
+        _count = _offsets.size();
+        return true;
+    }
+
+    void GameRecordReader::close()
+    {
+        unmapFile(_data, _size);
+        unmapFile(_indexData, _indexSize);
+        _data = _indexData = nullptr;
+        _size = _indexSize = 0;
+        _offsets.clear();
+        _count = 0;
+    }
+
+    size_t GameRecordReader::size() const
+    {
+        return _count;
+    }
+
+    RecordView GameRecordReader::operator [] (const size_t& i) const
+    {
+        const uint64_t offset = _indexData ? readU64(_indexData + 8 * i) : _offsets[i];
+        return RecordView(_data + offset);
+    }
+
+    GameRecordReader::Iterator GameRecordReader::begin() const
+    {
+        return Iterator(_data ? _data + RECORD_FILE_HEADER : nullptr, _data + _size);
+    }
+
+    GameRecordReader::Iterator GameRecordReader::end() const
+    {
+        return Iterator(_data + _size, _data + _size);
+    }
+
+    bool chunkRecords(const std::vector<std::string>& paths,
+            std::vector<std::unique_ptr<GameRecordReader>>& readers,
+            std::vector<RecordChunk>& chunks, const size_t& size)
+    {
+        readers.clear();
+        chunks.clear();
+        for (size_t f = 0; f < paths.size(); ++f)
+        {
+            readers.emplace_back(new GameRecordReader());
+            if (!(readers.back()->open(paths[f])))
+                return false;
+
+            const size_t records = readers.back()->size();
+            for (size_t first = 0; first < records; first += size)
+                chunks.push_back({ f, first, std::min(size, records - first) });
+        }
+        return true;
+    }
+}
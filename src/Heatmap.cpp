@@ -0,0 +1,201 @@
+/*
+ * Copyright 2016 Fermin, Yaneury <fermin.yaneury@gmail.com>
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <memory>
+
+#include <Heatmap.hpp>
+#include <Notation.hpp>
+#include <Parallel.hpp>
+
+namespace Gungi
+{
+    namespace
+    {
+        /**
+         * This function adds one to the counters of the set squares of a bitboard. The loop
+         * has no branch so it vectorises.
+         * @param bits a bitboard
+         * @param counts BOARD_SQUARES counters
+         */
+        void addSquares(const Bitboard& bits, uint64_t* counts)
+        {
+            for (size_t square = 0; square < 64; ++square)
+                counts[square] += (bits.lo >> square) & 1;
+            for (size_t square = 64; square < BOARD_SQUARES; ++square)
+                counts[square] += (bits.hi >> (square - 64)) & 1;
+        }
+
+        /**
+         * This function applies an archived action code. Archived plies were legal when
+         * expandGame decoded them.
+         * @return false if the code didn't decode
+         */
+        bool applyCode(Game& game, const uint32_t& code)
+        {
+            Action action;
+            if (code == PHASE_CODE)
+                game.start();
+            else if (decodeAction(game, code, action))
+                game.make(action);
+            else
+                return false;
+            return true;
+        }
+
+        /**
+         * This function adds every position of a game to a heatmap. The position before a
+         * phase advance is the one after it and is counted once.
+         * @return false if the start or an action didn't decode
+         */
+        bool addGame(const ArchiveReader& archive, const size_t& i, Game& game,
+                std::vector<uint32_t>& actions, Heatmap& map)
+        {
+            RecordHeader header;
+            PackedPosition start;
+            if (!(archive.game(i, header, start, actions)) || !(loadPacked(start, game)))
+                return false;
+
+            size_t advanced = 0;
+            for (size_t ply = 0; ply < actions.size(); ++ply)
+            {
+                if (!(applyCode(game, actions[ply])))
+                    return false;
+                if (actions[ply] == PHASE_CODE)
+                    advanced = ply + 1;
+            }
+
+            // Positions are only counted once the whole game decoded, on the way back to
+            // the last phase advance, which unmake can't cross.
+            for (size_t ply = actions.size(); ; --ply)
+            {
+                addPosition(game, header.result, map);
+                if (ply == advanced)
+                    break;
+                game.unmake();
+            }
+
+            if (advanced == 0)
+                return true;
+
+            // The plies before it are played again from the start.
+            loadPacked(start, game);
+            for (size_t ply = 0; ply + 1 < advanced; ++ply)
+            {
+                if (actions[ply] != PHASE_CODE)
+                    addPosition(game, header.result, map);
+                applyCode(game, actions[ply]);
+            }
+            return true;
+        }
+    }
+
+    Heatmap::Heatmap()
+    : games     (0)
+    , skipped   (0)
+    , positions (0)
+    , sides     {}
+    , cells     {}
+    , towers    (HEATMAP_TOWERS, 0)
+    {
+        for (std::vector<uint64_t>& cell : cells)
+            cell.assign(HEATMAP_CELLS, 0);
+    }
+
+    Outcome outcomeOf(const Color& result, const Color& owner)
+    {
+        if (result == Color::None)
+            return Outcome::Draw;
+        return result == owner ? Outcome::Win : Outcome::Loss;
+    }
+
+    void addPosition(const Game& game, const Color& result, Heatmap& map)
+    {
+        const size_t black = static_cast<size_t>(outcomeOf(result, Color::Black));
+        const size_t white = static_cast<size_t>(outcomeOf(result, Color::White));
+        ++map.positions;
+        ++map.sides[black];
+        ++map.sides[white];
+
+        const Board& board = *(game.gameBoard());
+        for (SizeType y = 0; y < BOARD_HEIGHT; ++y)
+        {
+            Bitboard occupied;
+            for (SizeType z = 0; z < BOARD_DEPTH; ++z)
+            {
+                for (SizeType x = 0; x < BOARD_WIDTH; ++x)
+                {
+                    const SmallPoint3 pt3(x, z, y);
+                    const Piece& piece = *(board[pt3]);
+                    if (piece.isNull())
+                        continue;
+
+                    const bool whites = piece.getActiveColor() == Color::White;
+                    const SmallPoint3 seen = whites ? asPositive3(pt3) : pt3;
+                    occupied.set(z * BOARD_WIDTH + x);
+                    ++map.cells[whites ? white : black][heatmapCell(getPieceCode(piece), y,
+                            seen.z * BOARD_WIDTH + seen.x)];
+                }
+            }
+
+            if (occupied.empty())
+                break;
+            addSquares(occupied, map.towers.data() + y * BOARD_SQUARES);
+        }
+    }
+
+    void mergeHeatmap(const Heatmap& part, Heatmap& map)
+    {
+        map.games += part.games;
+        map.skipped += part.skipped;
+        map.positions += part.positions;
+        for (size_t o = 0; o < 3; ++o)
+        {
+            map.sides[o] += part.sides[o];
+            const uint64_t* from = part.cells[o].data();
+            uint64_t* to = map.cells[o].data();
+            for (size_t c = 0; c < HEATMAP_CELLS; ++c)
+                to[c] += from[c];
+        }
+
+        for (size_t c = 0; c < HEATMAP_TOWERS; ++c)
+            map.towers[c] += part.towers[c];
+    }
+
+    void buildHeatmap(const ArchiveReader& archive, Heatmap& map, SizeType threads)
+    {
+        threads = std::max<SizeType>(1, std::min<size_t>(threadCount(threads),
+                    std::max<size_t>(archive.blockCount(), 1)));
+        std::vector<Heatmap> parts(threads);
+        std::vector<std::unique_ptr<Game>> games;
+        for (SizeType t = 0; t < threads; ++t)
+            games.emplace_back(new Game());
+        std::vector<std::vector<uint32_t>> actions(threads);
+        parallelForWorkers(archive.blockCount(), threads, [&] (const SizeType& t, const size_t& b)
+        {
+            Heatmap& part = parts[t];
+            for (size_t i = archive.blockStart(b); i < archive.blockStart(b + 1); ++i)
+            {
+                ++part.games;
+                if (!(addGame(archive, i, *(games[t]), actions[t], part)))
+                    ++part.skipped;
+            }
+        });
+
+        for (const Heatmap& part : parts)
+            mergeHeatmap(part, map);
+    }
+}
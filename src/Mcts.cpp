@@ -0,0 +1,323 @@
+/*
+ * Copyright 2016 Fermin, Yaneury <fermin.yaneury@gmail.com>
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+#include <cmath>
+#include <limits>
+#include <thread>
+
+#include <Mcts.hpp>
+#include <Search.hpp>
+
+namespace Gungi
+{
+    MctsConfig::MctsConfig()
+    : selection   (Selection::Puct)
+    , exploration (1.5f)
+    , threads     (1)
+    , playouts    (10000)
+    , virtualLoss (3)
+    , maxNodes    (1 << 22)
+    , seed        (0x2545F4914F6CDD1Dull)
+    {}
+
+    MctsNode::MctsNode()
+    : action     (NULL_ACTION)
+    , prior      (0.0f)
+    , firstChild (0)
+    , childCount (0)
+    , state      (LEAF)
+    , visits     (0)
+    , valueSum   (0)
+    {}
+
+    LeafContext::LeafContext(uint64_t seed)
+    : playout (seed)
+    {}
+
+    LeafEvaluator::~LeafEvaluator()
+    {}
+
+    void LeafEvaluator::priors(const Game&, const ActionList& actions, float* priors) const
+    {
+        const float uniform = 1.0f / static_cast<float>(actions.size());
+        for (size_t i = 0; i < actions.size(); ++i)
+            priors[i] = uniform;
+    }
+
+    RolloutEvaluator::RolloutEvaluator(uint16_t plyCap)
+    : _plyCap (plyCap)
+    {}
+
+    float RolloutEvaluator::evaluate(Game& game, LeafContext& context) const
+    {
+        const Color toMove = game.currentPlayer()->getColor();
+        const PlayoutResult result = context.playout.run(game, _plyCap);
+
+        if (result.winner == Color::None)
+            return 0.0f;
+        return result.winner == toMove ? 1.0f : -1.0f;
+    }
+
+    StaticEvaluator::StaticEvaluator(float scale)
+    : _scale (scale)
+    {}
+
+    float StaticEvaluator::evaluate(Game& game, LeafContext&) const
+    {
+        const float score = static_cast<float>(Gungi::evaluate(game));
+        return 2.0f / (1.0f + std::exp(-score / _scale)) - 1.0f;
+    }
+
+    Mcts::Mcts(const MctsConfig& config, const LeafEvaluator& evaluator)
+    : _config    (config)
+    , _evaluator (evaluator)
+    , _nodes     (new MctsNode[config.maxNodes])
+    , _used      (0)
+    , _started   (0)
+    , _searches  (0)
+    {
+        if (_config.threads == 0)
+            _config.threads = 1;
+    }
+
+    Action Mcts::search(const Game& game)
+    {
+        _rootStats.clear();
+        if (game.getWinner() != Color::None || _config.maxNodes == 0)
+            return NULL_ACTION;
+
+        MctsNode& root = _nodes[0];
+        root.action = NULL_ACTION;
+        root.prior = 1.0f;
+        root.firstChild.store(0);
+        root.childCount.store(0);
+        root.state.store(MctsNode::LEAF);
+        root.visits.store(0);
+        root.valueSum.store(0);
+        _used.store(1);
+        _started.store(0);
+        ++_searches;
+
+        std::vector<std::thread> threads;
+        for (SizeType t = 1; t < _config.threads; ++t)
+            threads.emplace_back(&Mcts::_worker, this, std::cref(game),
+                    _config.seed + _searches * 0x9E3779B97F4A7C15ull + t);
+
+        _worker(game, _config.seed + _searches * 0x9E3779B97F4A7C15ull);
+
+        for (auto& thread : threads)
+            thread.join();
+
+        if (root.state.load() != MctsNode::EXPANDED)
+            return NULL_ACTION;
+
+        Action best = NULL_ACTION;
+        uint32_t bestVisits = 0;
+        const uint32_t first = root.firstChild.load();
+        const uint16_t count = root.childCount.load();
+
+        for (uint32_t i = first; i < first + count; ++i)
+        {
+            const MctsNode& child = _nodes[i];
+            const int32_t visits = child.visits.load();
+            RootStat stat;
+            stat.action = child.action;
+            stat.visits = static_cast<uint32_t>(visits);
+            stat.value = visits > 0 ? static_cast<float>(child.valueSum.load()) /
+                static_cast<float>(MCTS_VALUE_SCALE * visits) : 0.0f;
+            _rootStats.push_back(stat);
+
+            if (best == NULL_ACTION || stat.visits > bestVisits)
+            {
+                best = stat.action;
+                bestVisits = stat.visits;
+            }
+        }
+
+        return best;
+    }
+
+    const std::vector<RootStat>& Mcts::rootStats() const
+    {
+        return _rootStats;
+    }
+
+    size_t Mcts::nodesUsed() const
+    {
+        return std::min(_used.load(), _config.maxNodes);
+    }
+
+    void Mcts::_worker(const Game& root, uint64_t seed)
+    {
+        Game game(root);
+        std::unique_ptr<LeafContext> context(new LeafContext(seed));
+
+        while (_started.fetch_add(1, std::memory_order_relaxed) < _config.playouts)
+            _simulate(game, *context);
+    }
+
+    void Mcts::_simulate(Game& game, LeafContext& context)
+    {
+        MctsNode* path[MCTS_MAX_DEPTH + 1];
+        SizeType depth = 0;
+        MctsNode* node = &_nodes[0];
+        path[0] = node;
+        _addVirtualLoss(*node);
+
+        // The value is always from the point of view of the player to move at node.
+        float value = 0.0f;
+        while (true)
+        {
+            if (game.getWinner() != Color::None)
+            {
+                value = -1.0f;
+                break;
+            }
+
+            uint8_t state = node->state.load(std::memory_order_acquire);
+            if (state == MctsNode::LEAF && depth < MCTS_MAX_DEPTH &&
+                    node->state.compare_exchange_strong(state, MctsNode::EXPANDING,
+                        std::memory_order_acq_rel))
+            {
+                if (_expand(*node, game, context) && node->childCount.load() == 0)
+                {
+                    value = -1.0f;
+                    break;
+                }
+
+                value = _evaluator.evaluate(game, context);
+                break;
+            }
+
+            if (state != MctsNode::EXPANDED || depth == MCTS_MAX_DEPTH)
+            {
+                value = _evaluator.evaluate(game, context);
+                break;
+            }
+
+            if (node->childCount.load(std::memory_order_relaxed) == 0)
+            {
+                value = -1.0f;
+                break;
+            }
+
+            node = &_nodes[_select(*node)];
+            _addVirtualLoss(*node);
+            game.make(node->action);
+            path[++depth] = node;
+        }
+
+        // Each node is scored for the player that made its action, the opponent of the
+        // player to move there.
+        for (SizeType d = depth + 1; d-- > 0;)
+        {
+            value = -value;
+            _backup(*path[d], value);
+        }
+
+        while (depth-- > 0)
+            game.unmake();
+    }
+
+    uint32_t Mcts::_select(const MctsNode& node) const
+    {
+        const uint32_t first = node.firstChild.load(std::memory_order_relaxed);
+        const uint16_t count = node.childCount.load(std::memory_order_relaxed);
+        const float parentVisits = static_cast<float>(
+                std::max(node.visits.load(std::memory_order_relaxed), 1));
+        const float sqrtParent = std::sqrt(parentVisits);
+        const float logParent = std::log(parentVisits);
+
+        uint32_t best = first;
+        float bestScore = -std::numeric_limits<float>::max();
+
+        for (uint32_t i = first; i < first + count; ++i)
+        {
+            const MctsNode& child = _nodes[i];
+            const int32_t visits = child.visits.load(std::memory_order_relaxed);
+            const float q = visits > 0 ?
+                static_cast<float>(child.valueSum.load(std::memory_order_relaxed)) /
+                static_cast<float>(MCTS_VALUE_SCALE * visits) : 0.0f;
+
+            float score;
+            if (_config.selection == Selection::Puct)
+                score = q + _config.exploration * child.prior * sqrtParent /
+                    static_cast<float>(1 + visits);
+            else if (visits > 0)
+                score = q + _config.exploration * std::sqrt(logParent /
+                        static_cast<float>(visits));
+            else
+                return i;
+
+            if (score > bestScore)
+            {
+                bestScore = score;
+                best = i;
+            }
+        }
+
+        return best;
+    }
+
+    bool Mcts::_expand(MctsNode& node, Game& game, LeafContext& context)
+    {
+        genActions(game, context.actions);
+        const size_t count = context.actions.size();
+        const size_t first = _used.fetch_add(count, std::memory_order_relaxed);
+
+        if (first + count > _config.maxNodes)
+        {
+            node.state.store(MctsNode::LEAF, std::memory_order_release);
+            return false;
+        }
+
+        if (count > 0)
+            _evaluator.priors(game, context.actions, context.priors);
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            MctsNode& child = _nodes[first + i];
+            child.action = context.actions[i];
+            child.prior = context.priors[i];
+            child.firstChild.store(0, std::memory_order_relaxed);
+            child.childCount.store(0, std::memory_order_relaxed);
+            child.state.store(MctsNode::LEAF, std::memory_order_relaxed);
+            child.visits.store(0, std::memory_order_relaxed);
+            child.valueSum.store(0, std::memory_order_relaxed);
+        }
+
+        node.firstChild.store(static_cast<uint32_t>(first), std::memory_order_relaxed);
+        node.childCount.store(static_cast<uint16_t>(count), std::memory_order_relaxed);
+        node.state.store(MctsNode::EXPANDED, std::memory_order_release);
+        return true;
+    }
+
+    void Mcts::_addVirtualLoss(MctsNode& node)
+    {
+        node.visits.fetch_add(_config.virtualLoss, std::memory_order_relaxed);
+        node.valueSum.fetch_sub(_config.virtualLoss * MCTS_VALUE_SCALE,
+                std::memory_order_relaxed);
+    }
+
+    void Mcts::_backup(MctsNode& node, const float& value)
+    {
+        node.visits.fetch_add(1 - _config.virtualLoss, std::memory_order_relaxed);
+        node.valueSum.fetch_add(static_cast<int64_t>(std::lround(value * MCTS_VALUE_SCALE)) +
+                _config.virtualLoss * MCTS_VALUE_SCALE, std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,471 @@
+/*
+ * Copyright 2016 Fermin, Yaneury <fermin.yaneury@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstring>
+
+#if defined(__AVX2__)
+    #include <immintrin.h>
+#endif
+
+#include <FileIo.hpp>
+#include <Network.hpp>
+
+namespace Gungi
+{
+    namespace
+    {
+        constexpr size_t HEADER_SIZE  = 2 * sizeof (uint32_t);
+        constexpr size_t FT_W_SIZE    = NET_FEATURE_CT * NET_HIDDEN * sizeof (int16_t);
+        constexpr size_t FT_B_SIZE    = NET_HIDDEN * sizeof (int16_t);
+        constexpr size_t L1_W_SIZE    = NET_L1 * 2 * NET_HIDDEN * sizeof (int8_t);
+        constexpr size_t L1_B_SIZE    = NET_L1 * sizeof (int32_t);
+        constexpr size_t L2_W_SIZE    = NET_L2 * NET_L1 * sizeof (int8_t);
+        constexpr size_t L2_B_SIZE    = NET_L2 * sizeof (int32_t);
+        constexpr size_t OUT_W_SIZE   = NET_L2 * sizeof (int8_t);
+        constexpr size_t OUT_B_SIZE   = sizeof (int32_t);
+        constexpr size_t NET_FILE_SIZE = HEADER_SIZE + FT_W_SIZE + FT_B_SIZE + L1_W_SIZE +
+            L1_B_SIZE + L2_W_SIZE + L2_B_SIZE + OUT_W_SIZE + OUT_B_SIZE;
+
+        SizeType perspectiveIndex(const Color& color)
+        {
+            return color == Color::White ? 1 : 0;
+        }
+
+        int32_t dot(const uint8_t* input, const int8_t* weights, const size_t& n)
+        {
+            #if defined(__AVX2__)
+                const __m256i ones = _mm256_set1_epi16(1);
+                __m256i sum = _mm256_setzero_si256();
+                for (size_t i = 0; i < n; i += 32)
+                {
+                    __m256i in = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(input + i));
+                    __m256i w = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(weights + i));
+                    __m256i prod = _mm256_madd_epi16(_mm256_maddubs_epi16(in, w), ones);
+                    sum = _mm256_add_epi32(sum, prod);
+                }
+                __m128i lo = _mm256_castsi256_si128(sum);
+                __m128i hi = _mm256_extracti128_si256(sum, 1);
+                __m128i s = _mm_add_epi32(lo, hi);
+                s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0x4E));
+                s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0xB1));
+                return _mm_cvtsi128_si32(s);
+            #else
+                int32_t sum = 0;
+                for (size_t i = 0; i < n; ++i)
+                    sum += static_cast<int32_t>(input[i]) * weights[i];
+                return sum;
+            #endif
+        }
+
+        uint8_t clip(const int32_t& value)
+        {
+            return static_cast<uint8_t>(std::max(0, std::min(NET_CLIP, value)));
+        }
+
+        void dense(const uint8_t* input, const size_t& inSize, const int8_t* weights,
+                const int32_t* bias, uint8_t* output, const size_t& outSize)
+        {
+            for (size_t o = 0; o < outSize; ++o)
+            {
+                int32_t sum = bias[o] + dot(input, weights + o * inSize, inSize);
+                output[o] = clip(sum >> NET_WEIGHT_SHIFT);
+            }
+        }
+
+        void transform(const int16_t* acc, uint8_t* output)
+        {
+            #if defined(__AVX2__)
+                const __m256i zero = _mm256_setzero_si256();
+                const __m256i limit = _mm256_set1_epi16(NET_CLIP);
+                for (size_t i = 0; i < NET_HIDDEN; i += 32)
+                {
+                    __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(acc + i));
+                    __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(acc + i + 16));
+                    a = _mm256_min_epi16(_mm256_max_epi16(a, zero), limit);
+                    b = _mm256_min_epi16(_mm256_max_epi16(b, zero), limit);
+                    __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xD8);
+                    _mm256_storeu_si256(reinterpret_cast<__m256i*>(output + i), packed);
+                }
+            #else
+                for (size_t i = 0; i < NET_HIDDEN; ++i)
+                    output[i] = clip(acc[i]);
+            #endif
+        }
+
+        void addRow(int16_t* acc, const int16_t* row)
+        {
+            #if defined(__AVX2__)
+                for (size_t i = 0; i < NET_HIDDEN; i += 16)
+                {
+                    __m256i* dst = reinterpret_cast<__m256i*>(acc + i);
+                    __m256i src = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + i));
+                    _mm256_storeu_si256(dst, _mm256_add_epi16(_mm256_loadu_si256(dst), src));
+                }
+            #else
+                for (size_t i = 0; i < NET_HIDDEN; ++i)
+                    acc[i] += row[i];
+            #endif
+        }
+
+        void subRow(int16_t* acc, const int16_t* row)
+        {
+            #if defined(__AVX2__)
+                for (size_t i = 0; i < NET_HIDDEN; i += 16)
+                {
+                    __m256i* dst = reinterpret_cast<__m256i*>(acc + i);
+                    __m256i src = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + i));
+                    _mm256_storeu_si256(dst, _mm256_sub_epi16(_mm256_loadu_si256(dst), src));
+                }
+            #else
+                for (size_t i = 0; i < NET_HIDDEN; ++i)
+                    acc[i] -= row[i];
+            #endif
+        }
+
+        /**
+         * Counts the pieces in hand of a player by active piece code. A captured commander
+         * has no code and no feature.
+         */
+        void countHand(const Player& player, SizeType counts[PIECE_CODE_CT])
+        {
+            const PieceSet& pieces = player.getFullSet();
+            for (SizeType i = 0; i < pieces.Set.size(); ++i)
+            {
+                if (!(isUnbounded(pieces.pointAt(i))))
+                    continue;
+
+                const SizeType code = getPieceCode(pieces.pieceAt(i));
+                if (code < PIECE_CODE_CT)
+                    ++counts[code];
+            }
+        }
+
+        /**
+         * Adds or removes the features of every piece of the tower at pt3.
+         */
+        void updateTower(const Network& net, const Board& board, const SmallPoint3& pt3,
+                bool add, Accumulator& acc)
+        {
+            for (SizeType y = 0; y < BOARD_HEIGHT; ++y)
+            {
+                const SmallPoint3 at(pt3.x, pt3.z, y);
+                const Piece& piece = *(board[at]);
+                if (piece.isNull())
+                    continue;
+
+                if (add)
+                    acc.addPiece(net, piece, at);
+                else
+                    acc.removePiece(net, piece, at);
+            }
+        }
+    }
+
+    uint16_t boardFeature(const Color& perspective, const Piece& piece, const SmallPoint3& pt3)
+    {
+        auto pt = perspective == Color::White ? asPositive3(pt3) : pt3;
+        SizeType side = piece.getActiveColor() == perspective ? 0 : 1;
+        size_t square = pt.z * BOARD_WIDTH + pt.x;
+        return static_cast<uint16_t>(((side * PIECE_CODE_CT + getPieceCode(piece)) *
+                    BOARD_HEIGHT + pt.y) * NET_SQUARE_CT + square);
+    }
+
+    uint16_t handFeature(const Color& perspective, const Color& owner, const SizeType& code,
+            const SizeType& nth)
+    {
+        if (nth == 0 || nth > NET_HAND_SLOTS)
+            return NET_FEATURE_CT;
+
+        SizeType side = owner == perspective ? 0 : 1;
+        return static_cast<uint16_t>(NET_BOARD_FEATS +
+                (side * PIECE_CODE_CT + code) * NET_HAND_SLOTS + nth - 1);
+    }
+
+    Network::Network()
+    : _mapping    (nullptr)
+    , _size       (0)
+    , _ftWeights  (nullptr)
+    , _ftBias     (nullptr)
+    , _l1Weights  (nullptr)
+    , _l1Bias     (nullptr)
+    , _l2Weights  (nullptr)
+    , _l2Bias     (nullptr)
+    , _outWeights (nullptr)
+    , _outBias    (nullptr)
+    {}
+
+    Network::~Network()
+    {
+        unload();
+    }
+
+    bool Network::load(const std::string& path)
+    {
+        unload();
+
+        size_t size;
+        const uint8_t* base = mapFile(path, size, NET_FILE_SIZE);
+        if (base == nullptr || size != NET_FILE_SIZE || readU32(base) != NET_MAGIC ||
+                readU32(base + 4) != NET_VERSION)
+        {
+            unmapFile(base, size);
+            return false;
+        }
+
+        _mapping = base;
+        _size = NET_FILE_SIZE;
+
+        const uint8_t* cursor = base + HEADER_SIZE;
+        _ftWeights = reinterpret_cast<const int16_t*>(cursor);
+        cursor += FT_W_SIZE;
+        _ftBias = reinterpret_cast<const int16_t*>(cursor);
+        cursor += FT_B_SIZE;
+        _l1Weights = reinterpret_cast<const int8_t*>(cursor);
+        cursor += L1_W_SIZE;
+        _l1Bias = reinterpret_cast<const int32_t*>(cursor);
+        cursor += L1_B_SIZE;
+        _l2Weights = reinterpret_cast<const int8_t*>(cursor);
+        cursor += L2_W_SIZE;
+        _l2Bias = reinterpret_cast<const int32_t*>(cursor);
+        cursor += L2_B_SIZE;
+        _outWeights = reinterpret_cast<const int8_t*>(cursor);
+        cursor += OUT_W_SIZE;
+        _outBias = reinterpret_cast<const int32_t*>(cursor);
+
+        #if (DEBUG)
+            cerr << "In Network::load(), mapped " << _size << " bytes from " << path << endl;
+        #endif
+
+        return true;
+    }
+
+    void Network::unload()
+    {
+        unmapFile(_mapping, _size);
+        _mapping = nullptr;
+        _size = 0;
+        _ftWeights = _ftBias = nullptr;
+        _l1Weights = _l2Weights = _outWeights = nullptr;
+        _l1Bias = _l2Bias = _outBias = nullptr;
+    }
+
+    bool Network::loaded() const
+    {
+        return _mapping != nullptr;
+    }
+
+    const int16_t* Network::featureWeights(const uint16_t& feature) const
+    {
+        return _ftWeights + static_cast<size_t>(feature) * NET_HIDDEN;
+    }
+
+    const int16_t* Network::featureBias() const
+    {
+        return _ftBias;
+    }
+
+    int32_t Network::evaluate(const Accumulator& acc, const Color& toMove) const
+    {
+        alignas(32) uint8_t input[2 * NET_HIDDEN];
+        alignas(32) uint8_t hidden1[NET_L1];
+        alignas(32) uint8_t hidden2[NET_L2];
+
+        Color them = toMove == Color::White ? Color::Black : Color::White;
+        transform(acc.perspective(toMove), input);
+        transform(acc.perspective(them), input + NET_HIDDEN);
+
+        dense(input, 2 * NET_HIDDEN, _l1Weights, _l1Bias, hidden1, NET_L1);
+        dense(hidden1, NET_L1, _l2Weights, _l2Bias, hidden2, NET_L2);
+
+        return (*_outBias + dot(hidden2, _outWeights, NET_L2)) >> NET_WEIGHT_SHIFT;
+    }
+
+    void Accumulator::refresh(const Network& net, const Game& game)
+    {
+        for (SizeType p = 0; p < NET_PERSPECTIVES; ++p)
+            std::memcpy(_values[p], net.featureBias(), NET_HIDDEN * sizeof (int16_t));
+
+        const Board& board = *(game.gameBoard());
+        for (SizeType y = 0; y < BOARD_HEIGHT; ++y)
+            for (SizeType z = 0; z < BOARD_DEPTH; ++z)
+                for (SizeType x = 0; x < BOARD_WIDTH; ++x)
+                {
+                    const Piece* piece = board(x, z, y);
+                    if (!(piece->isNull()))
+                        addPiece(net, *piece, SmallPoint3(x, z, y));
+                }
+
+        for (const Player* player : { game.playerOne(), game.playerTwo() })
+        {
+            SizeType counts[PIECE_CODE_CT] = {};
+            const PieceSet& pieces = player->getFullSet();
+            for (SizeType i = 0; i < pieces.Set.size(); ++i)
+            {
+                if (!(isUnbounded(pieces.pointAt(i))))
+                    continue;
+
+                SizeType code = getPieceCode(pieces.pieceAt(i));
+                if (code < PIECE_CODE_CT)
+                    addHand(net, player->getColor(), code, ++counts[code]);
+            }
+        }
+    }
+
+    void Accumulator::addPiece(const Network& net, const Piece& piece, const SmallPoint3& pt3)
+    {
+        _add(net, boardFeature(Color::Black, piece, pt3), boardFeature(Color::White, piece, pt3));
+    }
+
+    void Accumulator::removePiece(const Network& net, const Piece& piece, const SmallPoint3& pt3)
+    {
+        _sub(net, boardFeature(Color::Black, piece, pt3), boardFeature(Color::White, piece, pt3));
+    }
+
+    void Accumulator::addHand(const Network& net, const Color& owner, const SizeType& code,
+            const SizeType& count)
+    {
+        _add(net, handFeature(Color::Black, owner, code, count),
+                handFeature(Color::White, owner, code, count));
+    }
+
+    void Accumulator::removeHand(const Network& net, const Color& owner, const SizeType& code,
+            const SizeType& count)
+    {
+        _sub(net, handFeature(Color::Black, owner, code, count),
+                handFeature(Color::White, owner, code, count));
+    }
+
+    const int16_t* Accumulator::perspective(const Color& color) const
+    {
+        return _values[perspectiveIndex(color)];
+    }
+
+    bool Accumulator::matches(const Network& net, const Game& game) const
+    {
+        Accumulator fresh;
+        fresh.refresh(net, game);
+        return std::memcmp(_values, fresh._values, sizeof (_values)) == 0;
+    }
+
+    void Accumulator::_add(const Network& net, const uint16_t& black, const uint16_t& white)
+    {
+        if (black < NET_FEATURE_CT)
+            addRow(_values[0], net.featureWeights(black));
+        if (white < NET_FEATURE_CT)
+            addRow(_values[1], net.featureWeights(white));
+    }
+
+    void Accumulator::_sub(const Network& net, const uint16_t& black, const uint16_t& white)
+    {
+        if (black < NET_FEATURE_CT)
+            subRow(_values[0], net.featureWeights(black));
+        if (white < NET_FEATURE_CT)
+            subRow(_values[1], net.featureWeights(white));
+    }
+
+    AccumulatorStack::AccumulatorStack()
+    : _depth (0)
+    {}
+
+    void AccumulatorStack::reset(const Network& net, const Game& game)
+    {
+        _depth = 0;
+        _stack[0].refresh(net, game);
+    }
+
+    bool AccumulatorStack::push()
+    {
+        if (_depth + 1 >= MAX_DEPTH)
+            return false;
+
+        _stack[_depth + 1] = _stack[_depth];
+        ++_depth;
+        return true;
+    }
+
+    void AccumulatorStack::pop()
+    {
+        if (_depth > 0)
+            --_depth;
+    }
+
+    const Accumulator& AccumulatorStack::top() const
+    {
+        return _stack[_depth];
+    }
+
+    Accumulator& AccumulatorStack::top()
+    {
+        return _stack[_depth];
+    }
+
+    bool AccumulatorStack::make(const Network& net, Game& game, const Action& action)
+    {
+        if (!(push()))
+            return false;
+
+        // Only the towers at both ends of the action and the hands can change.
+        Accumulator& acc = top();
+        const Board& board = *(game.gameBoard());
+        const Player* players[2] = { game.playerOne(), game.playerTwo() };
+        const bool moves = !(isUnbounded(action.origin)) &&
+            (action.origin.x != action.destination.x || action.origin.z != action.destination.z);
+        SizeType before[2][PIECE_CODE_CT] = {};
+        SizeType after[2][PIECE_CODE_CT] = {};
+        for (SizeType p = 0; p < 2; ++p)
+            countHand(*(players[p]), before[p]);
+
+        updateTower(net, board, action.destination, false, acc);
+        if (moves)
+            updateTower(net, board, action.origin, false, acc);
+
+        game.make(action);
+
+        updateTower(net, board, action.destination, true, acc);
+        if (moves)
+            updateTower(net, board, action.origin, true, acc);
+
+        for (SizeType p = 0; p < 2; ++p)
+        {
+            countHand(*(players[p]), after[p]);
+            const Color& owner = players[p]->getColor();
+            for (SizeType code = 0; code < PIECE_CODE_CT; ++code)
+            {
+                while (before[p][code] < after[p][code])
+                    acc.addHand(net, owner, code, ++before[p][code]);
+                while (before[p][code] > after[p][code])
+                    acc.removeHand(net, owner, code, before[p][code]--);
+            }
+        }
+
+        #if (DEBUG)
+            if (!(acc.matches(net, game)))
+                cerr << "In AccumulatorStack::make(), accumulator differs from a refresh" << endl;
+        #endif
+        return true;
+    }
+
+    void AccumulatorStack::unmake(Game& game)
+    {
+        game.unmake();
+        pop();
+    }
+
+    size_t AccumulatorStack::depth() const
+    {
+        return _depth;
+    }
+}
@@ -0,0 +1,411 @@
+/*
+ * Copyright 2016 Fermin, Yaneury <fermin.yaneury@gmail.com>
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+
+#include <FileIo.hpp>
+#include <Notation.hpp>
+
+namespace Gungi
+{
+    namespace
+    {
+        constexpr SizeType KIND_CT = 12; /**< Distinct (head, tail) pieces of a set. */
+        constexpr SizeType LETTER_CT = 2 * KIND_CT; /**< Head up letters, then tail up. */
+        constexpr char CASE_SHIFT = 'a' - 'A';
+
+        const char LETTERS[LETTER_CT + 1] = "CKMNYFDPASGVHIEJLTRXWBOQ";
+
+        const Head KIND_HEADS[KIND_CT] = { Head::Commander, Head::Captain, Head::Samurai,
+            Head::Ninja, Head::Catapult, Head::Fortress, Head::HiddenDragon, Head::Prodigy,
+            Head::Archer, Head::Soldier, Head::Soldier, Head::Soldier };
+
+        const Tail KIND_TAILS[KIND_CT] = { Tail::None, Tail::Pistol, Tail::Pike, Tail::Jounin,
+            Tail::Lance, Tail::Lance, Tail::DragonKing, Tail::Phoenix, Tail::Arrow,
+            Tail::Bronze, Tail::Gold, Tail::Silver };
+
+        /**
+         * Letter index of every character, UNBOUNDED if it isn't a piece letter. Case is
+         * ignored.
+         */
+        struct LetterTable
+        {
+            SizeType index[128];
+        };
+
+        const LetterTable& letterTable()
+        {
+            static const LetterTable table = [] ()
+            {
+                LetterTable t;
+                std::fill(t.index, t.index + 128, UNBOUNDED);
+                for (SizeType i = 0; i < LETTER_CT; ++i)
+                {
+                    t.index[static_cast<SizeType>(LETTERS[i])] = i;
+                    t.index[static_cast<SizeType>(LETTERS[i] + CASE_SHIFT)] = i;
+                }
+                return t;
+            } ();
+
+            return table;
+        }
+
+        constexpr SizeType SIDE_CT = 11; /**< Values of Head and of Tail, None included. */
+
+        /**
+         * Kind of every (head, tail) pair of a set.
+         */
+        struct KindTable
+        {
+            SizeType kind[SIDE_CT][SIDE_CT];
+        };
+
+        const KindTable& kindTable()
+        {
+            static const KindTable table = [] ()
+            {
+                KindTable t {};
+                for (SizeType k = 0; k < KIND_CT; ++k)
+                    t.kind[static_cast<SizeType>(KIND_HEADS[k])]
+                        [static_cast<SizeType>(KIND_TAILS[k])] = k;
+                return t;
+            } ();
+
+            return table;
+        }
+
+        SizeType kindOf(const Piece& piece)
+        {
+            return kindTable().kind[static_cast<SizeType>(piece.getHead())]
+                [static_cast<SizeType>(piece.getTail())];
+        }
+
+        const Color COLORS[2] = { Color::Black, Color::White };
+
+        char letterOf(const Piece& piece)
+        {
+            const char letter = LETTERS[(piece.onHead() ? 0 : KIND_CT) + kindOf(piece)];
+            return piece.getActiveColor() == Color::Black ? letter : letter + CASE_SHIFT;
+        }
+
+        bool pieceOf(const char& c, Piece& piece)
+        {
+            const SizeType index = c < 0 ? UNBOUNDED : 
+                letterTable().index[static_cast<SizeType>(c)];
+            if (index == UNBOUNDED)
+                return false;
+
+            const bool onHead = index < KIND_CT;
+            const Color shown = c < 'a' ? Color::Black : Color::White;
+            const Color hidden = shown == Color::Black ? Color::White : Color::Black;
+            const SizeType kind = index % KIND_CT;
+
+            piece = onHead ? Piece(KIND_HEADS[kind], KIND_TAILS[kind], shown, hidden) :
+                Piece(KIND_HEADS[kind], KIND_TAILS[kind], hidden, shown);
+            if (!(onHead))
+                piece.flip();
+            return true;
+        }
+
+        /**
+         * Bounded writer, it stops writing once out is full.
+         */
+        struct Writer
+        {
+            char* out;
+            size_t capacity;
+            size_t length;
+
+            void put(const char& c)
+            {
+                if (length < capacity)
+                    out[length] = c;
+                ++length;
+            }
+        };
+
+        bool addPiece(Position& position, const Piece& piece, const SmallPoint3& pt3)
+        {
+            const SizeType c = piece.getActiveColor() == Color::Black ? 0 : 1;
+            if (position.counts[c] >= MAX_SET_CT)
+                return false;
+
+            position.pieces[c][position.counts[c]] = piece;
+            position.locations[c][position.counts[c]++] = locationOf(pt3);
+            return true;
+        }
+
+        bool parseRank(const char* text, const size_t& length, size_t& at, const SizeType& z,
+                Position& position)
+        {
+            SizeType x = 0;
+            while (x < BOARD_WIDTH)
+            {
+                if (at >= length)
+                    return false;
+
+                const char c = text[at++];
+                Piece piece;
+                if (c >= '1' && c <= '9')
+                    x += c - '0';
+                else if (c == '(')
+                {
+                    SizeType y = 0;
+                    for (; at < length && text[at] != ')'; ++y)
+                        if (y >= BOARD_HEIGHT || !(pieceOf(text[at++], piece)) || 
+                                !(addPiece(position, piece, SmallPoint3(x, z, y))))
+                            return false;
+
+                    if (at++ >= length || y == 0)
+                        return false;
+                    ++x;
+                }
+                else if (pieceOf(c, piece) && addPiece(position, piece, SmallPoint3(x, z, 0)))
+                    ++x;
+                else
+                    return false;
+            }
+            return x == BOARD_WIDTH;
+        }
+
+        bool expect(const char* text, const size_t& length, size_t& at, const char& c)
+        {
+            return at < length && text[at++] == c;
+        }
+    }
+
+    size_t writeNotation(const Game& game, char* out, const size_t& capacity)
+    {
+        Writer writer { out, capacity, 0 };
+        const Board& board = *(game.gameBoard());
+
+        for (SizeType z = BOARD_DEPTH; z-- > 0;)
+        {
+            SizeType empty = 0;
+            for (SizeType x = 0; x < BOARD_WIDTH; ++x)
+            {
+                SizeType height = 0;
+                while (height < BOARD_HEIGHT && !(board(x, z, height)->isNull()))
+                    ++height;
+
+                if (height == 0)
+                {
+                    ++empty;
+                    continue;
+                }
+
+                if (empty > 0)
+                    writer.put(static_cast<char>('0' + empty));
+                empty = 0;
+
+                if (height > 1)
+                    writer.put('(');
+                for (SizeType y = 0; y < height; ++y)
+                    writer.put(letterOf(*(board(x, z, y))));
+                if (height > 1)
+                    writer.put(')');
+            }
+
+            if (empty > 0)
+                writer.put(static_cast<char>('0' + empty));
+            if (z > 0)
+                writer.put('/');
+        }
+
+        // Hands are counted per letter so they come out in table order.
+        SizeType hands[2][LETTER_CT] = {};
+        bool anyInHand = false;
+        for (const Player* player : { game.playerOne(), game.playerTwo() })
+        {
+            for (SizeType i = 0; i < player->getFullSet().Set.size(); ++i)
+            {
+                if (!(isUnbounded(player->pointAt(i))))
+                    continue;
+
+                const Piece& piece = player->pieceAt(i);
+                ++hands[piece.getActiveColor() == Color::Black ? 0 : 1]
+                    [(piece.onHead() ? 0 : KIND_CT) + kindOf(piece)];
+                anyInHand = true;
+            }
+        }
+
+        writer.put(' ');
+        if (!(anyInHand))
+            writer.put('-');
+        for (SizeType c = 0; c < 2; ++c)
+            for (SizeType i = 0; i < LETTER_CT; ++i)
+                for (SizeType n = 0; n < hands[c][i]; ++n)
+                    writer.put(c == 0 ? LETTERS[i] : LETTERS[i] + CASE_SHIFT);
+
+        const Player* toMove = game.currentPlayer();
+        writer.put(' ');
+        writer.put(toMove == nullptr || toMove->getColor() == Color::Black ? 'b' : 'w');
+        writer.put(' ');
+        writer.put(game.getPhase() == Phase::Standby ? 's' : 
+                (game.getPhase() == Phase::Placement ? 'p' : 'r'));
+
+        return writer.length <= capacity ? writer.length : 0;
+    }
+
+    bool parseNotation(const char* text, const size_t& length, Position& position)
+    {
+        position.counts[0] = 0;
+        position.counts[1] = 0;
+        size_t at = 0;
+
+        for (SizeType z = BOARD_DEPTH; z-- > 0;)
+        {
+            if (!(parseRank(text, length, at, z, position)))
+                return false;
+            if (z > 0 && !(expect(text, length, at, '/')))
+                return false;
+        }
+
+        if (!(expect(text, length, at, ' ')))
+            return false;
+
+        if (at < length && text[at] == '-')
+            ++at;
+        else
+        {
+            const size_t first = at;
+            Piece piece;
+            for (; at < length && text[at] != ' '; ++at)
+                if (!(pieceOf(text[at], piece)) || !(addPiece(position, piece, UBD_PT3)))
+                    return false;
+
+            if (at == first)
+                return false;
+        }
+
+        if (!(expect(text, length, at, ' ')) || at >= length)
+            return false;
+
+        const char side = text[at++];
+        if (side != 'b' && side != 'w')
+            return false;
+        position.toMove = side == 'b' ? Color::Black : Color::White;
+
+        if (!(expect(text, length, at, ' ')) || at >= length)
+            return false;
+
+        const char phase = text[at++];
+        if (phase == 's')
+            position.phase = Phase::Standby;
+        else if (phase == 'p')
+            position.phase = Phase::Placement;
+        else if (phase == 'r')
+            position.phase = Phase::Running;
+        else
+            return false;
+
+        // Allow a line ending or a terminator, nothing else.
+        for (; at < length; ++at)
+            if (text[at] != '\n' && text[at] != '\r' && text[at] != '\0')
+                return false;
+        return true;
+    }
+
+    bool readNotation(const char* text, const size_t& length, Game& game)
+    {
+        Position position;
+        return parseNotation(text, length, position) && game.setPosition(position);
+    }
+
+    uint16_t packedState(const Piece& piece)
+    {
+        return static_cast<uint16_t>(!(piece.onHead()) * KIND_CT + kindOf(piece) +
+                (piece.getHeadColor() == Color::White) * LETTER_CT);
+    }
+
+    Piece pieceOfState(const uint16_t& state)
+    {
+        const SizeType white = state / LETTER_CT;
+        const SizeType kind = state % KIND_CT;
+        Piece piece(KIND_HEADS[kind], KIND_TAILS[kind], COLORS[white], COLORS[1 - white]);
+        if (state % LETTER_CT >= KIND_CT)
+            piece.flip();
+        return piece;
+    }
+
+    bool packPosition(const Game& game, PackedPosition& packed)
+    {
+        uint16_t entries[PACKED_PIECES];
+        size_t count = 0;
+        for (const Player* player : { game.playerOne(), game.playerTwo() })
+        {
+            const PieceSet& pieces = player->getFullSet();
+            if (count + pieces.Set.size() > PACKED_PIECES)
+                return false;
+
+            for (SizeType i = 0; i < pieces.Set.size(); ++i)
+                entries[count++] = static_cast<uint16_t>(locationOf(pieces.pointAt(i)) << 6 |
+                        packedState(pieces.pieceAt(i)));
+        }
+
+        // Sorted entries don't depend on the order of the sets.
+        std::sort(entries, entries + count);
+        std::fill(entries + count, entries + PACKED_PIECES, PACKED_EMPTY);
+
+        const Player* toMove = game.currentPlayer();
+        const uint16_t white = toMove != nullptr && toMove->getColor() == Color::White;
+        writeU16(packed.bytes, static_cast<uint16_t>(
+                    static_cast<uint16_t>(game.getPhase()) | white << 2));
+        for (size_t k = 0; k < PACKED_PIECES; ++k)
+            writeU16(packed.bytes + 2 + 2 * k, entries[k]);
+        return true;
+    }
+
+    bool unpackPosition(const PackedPosition& packed, Position& position)
+    {
+        const uint16_t header = readU16(packed.bytes);
+        if ((header & 3) > static_cast<uint16_t>(Phase::Running))
+            return false;
+
+        position.phase = static_cast<Phase>(header & 3);
+        position.toMove = COLORS[(header >> 2) & 1];
+        position.counts[0] = 0;
+        position.counts[1] = 0;
+
+        for (size_t k = 0; k < PACKED_PIECES; ++k)
+        {
+            const uint16_t entry = readU16(packed.bytes + 2 + 2 * k);
+            if (entry == PACKED_EMPTY)
+                break;
+
+            const uint16_t state = entry & 0x3F;
+            const uint16_t location = entry >> 6;
+            if (state >= 2 * LETTER_CT || (location != LOCATION_IN_HAND && 
+                        location >= BOARD_SQUARES * BOARD_HEIGHT))
+                return false;
+
+            // The active color is the head's when on head, the tail's otherwise.
+            const SizeType c = (state / LETTER_CT) ^ (state % LETTER_CT >= KIND_CT);
+            if (position.counts[c] >= MAX_SET_CT)
+                return false;
+
+            position.pieces[c][position.counts[c]] = pieceOfState(state);
+            position.locations[c][position.counts[c]++] = location;
+        }
+        return true;
+    }
+
+    bool loadPacked(const PackedPosition& packed, Game& game)
+    {
+        Position position;
+        return unpackPosition(packed, position) && game.setPosition(position);
+    }
+}
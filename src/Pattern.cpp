@@ -0,0 +1,276 @@
+/*
+ * Copyright 2016 Fermin, Yaneury <fermin.yaneury@gmail.com>
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <sstream>
+
+#if defined(__AVX2__)
+    #include <immintrin.h>
+#endif
+
+#include <Parallel.hpp>
+#include <Pattern.hpp>
+
+namespace Gungi
+{
+    namespace
+    {
+        /**
+         * Names of the active piece codes, head sides then tail sides.
+         */
+        const char* const CODE_NAMES[PIECE_CODE_CT] =
+        {
+            "commander", "captain", "samurai", "ninja", "catapult", "fortress",
+            "hidden-dragon", "prodigy", "archer", "soldier",
+            "pistol", "pike", "jounin", "lance", "dragon-king", "phoenix", "arrow", "gold",
+            "silver", "bronze"
+        };
+
+        enum class Literal : uint8_t
+        { Unset, Set, Clear, Never };
+
+        /**
+         * Requires a column to be set or clear, a column required both ways never matches.
+         */
+        void require(Literal* literals, const size_t& column, const bool& set)
+        {
+            const Literal wanted = set ? Literal::Set : Literal::Clear;
+            Literal& literal = literals[column];
+            literal = literal == Literal::Unset || literal == wanted ? wanted : Literal::Never;
+        }
+
+        bool parseTerm(const std::string& word, PatternTerm& term)
+        {
+            const size_t at = word.find('@');
+            if (at == std::string::npos || at + 2 != word.size() || word[at + 1] < '1' ||
+                    word[at + 1] > '0' + BOARD_HEIGHT)
+                return false;
+
+            term.tier = static_cast<SizeType>(word[at + 1] - '1');
+            term.occupied = true;
+            term.color = Color::None;
+            term.code = PIECE_CODE_CT;
+
+            std::string kind = word.substr(0, at);
+            if (kind == "empty")
+            {
+                term.occupied = false;
+                return true;
+            }
+
+            const size_t colon = kind.find(':');
+            if (colon != std::string::npos)
+            {
+                const std::string color = kind.substr(0, colon);
+                if (color == "black")
+                    term.color = Color::Black;
+                else if (color == "white")
+                    term.color = Color::White;
+                else
+                    return false;
+                kind = kind.substr(colon + 1);
+            }
+
+            if (kind == "any")
+                return true;
+
+            for (SizeType code = 0; code < PIECE_CODE_CT; ++code)
+                if (kind == CODE_NAMES[code])
+                {
+                    term.code = code;
+                    return true;
+                }
+            return false;
+        }
+
+        /**
+         * Clears the hits of the positions of a chunk that don't meet a clause.
+         */
+        void matchClause(const PositionStore& store, const size_t& k, const size_t& count,
+                const CompiledClause& clause, uint8_t* hits)
+        {
+            const uint64_t* lo[STORE_MASKS];
+            const uint64_t* hi[STORE_MASKS];
+            for (size_t j = 0; j < clause.literalCt; ++j)
+            {
+                lo[j] = store.maskLo(k, clause.columns[j]);
+                hi[j] = store.maskHi(k, clause.columns[j]);
+            }
+
+            size_t i = 0;
+            #if defined(__AVX2__)
+                const __m256i zero = _mm256_setzero_si256();
+                for (; i + 4 <= count; i += 4)
+                {
+                    __m256i l = _mm256_set1_epi64x(static_cast<long long>(clause.squares.lo));
+                    __m256i h = _mm256_set1_epi64x(static_cast<long long>(clause.squares.hi));
+                    for (size_t j = 0; j < clause.literalCt; ++j)
+                    {
+                        const __m256i flip =
+                            _mm256_set1_epi64x(static_cast<long long>(clause.flips[j]));
+                        l = _mm256_and_si256(l, _mm256_xor_si256(flip, _mm256_loadu_si256(
+                                        reinterpret_cast<const __m256i*>(lo[j] + i))));
+                        h = _mm256_and_si256(h, _mm256_xor_si256(flip, _mm256_loadu_si256(
+                                        reinterpret_cast<const __m256i*>(hi[j] + i))));
+                    }
+
+                    const __m256i empty = _mm256_cmpeq_epi64(_mm256_or_si256(l, h), zero);
+                    const int misses = _mm256_movemask_pd(_mm256_castsi256_pd(empty));
+                    for (size_t lane = 0; lane < 4; ++lane)
+                        hits[i + lane] &= !((misses >> lane) & 1);
+                }
+            #endif
+
+            for (; i < count; ++i)
+            {
+                uint64_t l = clause.squares.lo;
+                uint64_t h = clause.squares.hi;
+                for (size_t j = 0; j < clause.literalCt; ++j)
+                {
+                    l &= lo[j][i] ^ clause.flips[j];
+                    h &= hi[j][i] ^ clause.flips[j];
+                }
+                hits[i] &= (l | h) != 0;
+            }
+        }
+    }
+
+    PatternClause::PatternClause()
+    : squares   (Bitboard::full())
+    {}
+
+    const char* pieceCodeName(const SizeType& code)
+    {
+        return code < PIECE_CODE_CT ? CODE_NAMES[code] : "any";
+    }
+
+    bool parsePattern(const std::string& text, Pattern& pattern)
+    {
+        pattern.clauses.clear();
+        std::istringstream clauses(text);
+        std::string clauseText;
+        while (std::getline(clauses, clauseText, ';'))
+        {
+            PatternClause clause;
+            std::istringstream words(clauseText);
+            std::string word;
+            while (words >> word)
+            {
+                PatternTerm term;
+                if (!(parseTerm(word, term)))
+                    return false;
+                clause.terms.push_back(term);
+            }
+
+            if (clause.terms.empty())
+                return false;
+            pattern.clauses.push_back(clause);
+        }
+        return !(pattern.clauses.empty());
+    }
+
+    bool compilePattern(const Pattern& pattern, std::vector<CompiledClause>& clauses)
+    {
+        clauses.clear();
+        for (const PatternClause& source : pattern.clauses)
+        {
+            Literal literals[STORE_MASKS] = {};
+            for (const PatternTerm& term : source.terms)
+            {
+                if (term.tier >= BOARD_HEIGHT || term.code > PIECE_CODE_CT)
+                    return false;
+
+                require(literals, maskColumn(term.tier, STORE_OCCUPIED), term.occupied);
+                if (!(term.occupied))
+                    continue;
+
+                if (term.color != Color::None)
+                    require(literals, maskColumn(term.tier, STORE_WHITE),
+                            term.color == Color::White);
+                if (term.code != PIECE_CODE_CT)
+                    for (size_t b = 0; b < STORE_CODE_BITS; ++b)
+                        require(literals, maskColumn(term.tier, STORE_CODE + b),
+                                (term.code >> b) & 1);
+            }
+
+            CompiledClause clause;
+            clause.squares = source.squares;
+            clause.literalCt = 0;
+            for (size_t column = 0; column < STORE_MASKS; ++column)
+            {
+                if (literals[column] == Literal::Unset)
+                    continue;
+
+                if (literals[column] == Literal::Never)
+                    clause.squares = Bitboard();
+
+                clause.columns[clause.literalCt] = column;
+                clause.flips[clause.literalCt++] =
+                    literals[column] == Literal::Set ? 0 : ~uint64_t(0);
+            }
+            clauses.push_back(clause);
+        }
+        return true;
+    }
+
+    bool matchPattern(const std::vector<CompiledClause>& clauses, const StoreRow& row)
+    {
+        for (const CompiledClause& clause : clauses)
+        {
+            Bitboard squares = clause.squares;
+            for (size_t j = 0; j < clause.literalCt; ++j)
+            {
+                const Bitboard& mask = row.masks[clause.columns[j]];
+                squares &= Bitboard(mask.lo ^ clause.flips[j], mask.hi ^ clause.flips[j]);
+            }
+
+            if (squares.empty())
+                return false;
+        }
+        return true;
+    }
+
+    uint64_t scanPattern(const PositionStore& store, const std::vector<CompiledClause>& clauses,
+            const PatternSink& sink, SizeType threads)
+    {
+        std::mutex sinkLock;
+        std::atomic<uint64_t> matches(0);
+        parallelFor(store.chunkCount(), threadCount(threads), [&] (const size_t& k)
+        {
+            const size_t count = store.chunkSize(k);
+            uint8_t hits[STORE_CHUNK];
+            std::fill(hits, hits + count, 1);
+            for (const CompiledClause& clause : clauses)
+                matchClause(store, k, count, clause, hits);
+
+            uint64_t positions[STORE_CHUNK];
+            size_t found = 0;
+            for (size_t i = 0; i < count; ++i)
+                if (hits[i])
+                    positions[found++] = k * STORE_CHUNK + i;
+
+            if (found == 0)
+                return;
+
+            matches += found;
+            std::lock_guard<std::mutex> lock(sinkLock);
+            sink(positions, found);
+        });
+        return matches;
+    }
+}
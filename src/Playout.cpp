@@ -0,0 +1,199 @@
+/*
+ * Copyright 2016 Fermin, Yaneury <fermin.yaneury@gmail.com>
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+#include <Playout.hpp>
+
+namespace Gungi
+{
+    Rng::Rng(uint64_t seed)
+    : state (seed != 0 ? seed : 0x9E3779B97F4A7C15ull)
+    {}
+
+    uint64_t Rng::next()
+    {
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        return state * 0x2545F4914F6CDD1Dull;
+    }
+
+    uint32_t Rng::below(const uint32_t& bound)
+    {
+        return static_cast<uint32_t>(((next() >> 32) * bound) >> 32);
+    }
+
+    PlayoutConfig::PlayoutConfig()
+    : dropRate    (0.25f)
+    , captureRate (0.5f)
+    , dropTries   (16)
+    , pieceTries  (8)
+    {}
+
+    Playout::Playout(uint64_t seed, const PlayoutConfig& config)
+    : _config (config)
+    , _rng    (seed)
+    {}
+
+    PlayoutResult Playout::run(Game& game, const uint16_t& plyCap, bool restore)
+    {
+        PlayoutResult result;
+        result.winner = Color::None;
+        result.plies = 0;
+
+        Action action;
+        while (result.plies < plyCap && game.getWinner() == Color::None)
+        {
+            if (!(pick(game, action)))
+            {
+                result.winner = game.idlePlayer()->getColor();
+                break;
+            }
+
+            game.make(action);
+            ++result.plies;
+        }
+
+        if (game.getWinner() != Color::None)
+            result.winner = game.getWinner();
+
+        if (restore)
+            for (uint16_t i = 0; i < result.plies; ++i)
+                game.unmake();
+
+        return result;
+    }
+
+    bool Playout::pick(const Game& game, Action& action)
+    {
+        if (game.getPhase() == Phase::Running)
+        {
+            if (_chance(_config.dropRate) && _sampleDrop(game, action))
+                return true;
+
+            if (_sampleMove(game, action) || _sampleDrop(game, action))
+                return true;
+        }
+
+        // Sampling can miss the last few valid actions, settle it exhaustively.
+        genActions(game, _actions);
+        if (_actions.empty())
+            return false;
+
+        action = _actions[_rng.below(_actions.size())];
+        return true;
+    }
+
+    Rng& Playout::rng()
+    {
+        return _rng;
+    }
+
+    ActionList& Playout::scratch()
+    {
+        return _actions;
+    }
+
+    bool Playout::_chance(const float& rate)
+    {
+        return static_cast<float>(_rng.next() >> 40) < rate * static_cast<float>(1 << 24);
+    }
+
+    bool Playout::_sampleDrop(const Game& game, Action& action)
+    {
+        const PieceSet& pieces = game.currentPlayer()->getFullSet();
+        SizeType handSize = 0;
+        for (SizeType i = 0; i < pieces.Set.size(); ++i)
+            if (isUnbounded(pieces.pointAt(i)))
+                _indices[handSize++] = i;
+
+        if (handSize == 0)
+            return false;
+
+        const Board& board = *(game.gameBoard());
+        for (SizeType t = 0; t < _config.dropTries; ++t)
+        {
+            const SizeType i = _indices[_rng.below(handSize)];
+            const SizeType square = static_cast<SizeType>(_rng.below(BOARD_SQUARES));
+            SmallPoint3 pt3(square % BOARD_WIDTH, square / BOARD_WIDTH, 0);
+
+            if (game.towers().contains(square, pieces.pieceAt(i)) || 
+                    !(validRunningDrop(board, pieces.pieceAt(i), pt3)))
+                continue;
+
+            pt3.y = availableTierAt(board, pt3);
+            action = Action(ActionType::Drop, i, UBD_PT3, pt3, false);
+            return true;
+        }
+
+        return false;
+    }
+
+    bool Playout::_sampleMove(const Game& game, Action& action)
+    {
+        const PieceSet& pieces = game.currentPlayer()->getFullSet();
+        SizeType pieceCt = 0;
+        for (SizeType i = 0; i < pieces.Set.size(); ++i)
+            if (!(isUnbounded(pieces.pointAt(i))))
+                _indices[pieceCt++] = i;
+
+        // A buried piece can't move but can still attack the enemy next to it in its tower.
+        for (SizeType t = 0; pieceCt > 0 && t < _config.pieceTries; ++t)
+        {
+            const SizeType k = static_cast<SizeType>(_rng.below(pieceCt));
+            genMoveActions(game, _indices[k], _actions);
+            if (!(_actions.empty()))
+            {
+                _pickFrom(action);
+                return true;
+            }
+
+            // The piece can't act, don't draw it again.
+            _indices[k] = _indices[--pieceCt];
+        }
+
+        if (pieceCt == 0)
+            return false;
+
+        genMoveActions(game, _actions);
+        genImmobileAttacks(game, _actions);
+        if (_actions.empty())
+            return false;
+
+        _pickFrom(action);
+        return true;
+    }
+
+    void Playout::_pickFrom(Action& action)
+    {
+        if (_chance(_config.captureRate))
+        {
+            size_t captures = 0;
+            for (size_t i = 0; i < _actions.size(); ++i)
+                if (_actions[i].onOpponent)
+                    _actions.swap(captures++, i);
+
+            if (captures > 0)
+            {
+                action = _actions[_rng.below(captures)];
+                return;
+            }
+        }
+
+        action = _actions[_rng.below(_actions.size())];
+    }
+}
@@ -0,0 +1,336 @@
+/*
+ * Copyright 2016 Fermin, Yaneury <fermin.yaneury@gmail.com>
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+
+#include <FileIo.hpp>
+#include <Parallel.hpp>
+#include <PositionStore.hpp>
+
+namespace Gungi
+{
+    namespace
+    {
+        constexpr size_t HEADER_SIZE      = 32; /**< Bytes before the first chunk. */
+        constexpr size_t MASK_BYTES       = STORE_MASKS * 2 * STORE_CHUNK * sizeof (uint64_t);
+        constexpr size_t HANDS_OFFSET     = MASK_BYTES; /**< Hand columns in a chunk. */
+        constexpr size_t TO_MOVE_OFFSET   = HANDS_OFFSET + STORE_HANDS * STORE_CHUNK;
+        constexpr size_t RESULTS_OFFSET   = TO_MOVE_OFFSET + STORE_CHUNK;
+        constexpr size_t PLIES_OFFSET     = RESULTS_OFFSET + STORE_CHUNK;
+        constexpr size_t CHUNK_BYTES      = PLIES_OFFSET + STORE_CHUNK * sizeof (uint16_t);
+        constexpr size_t STORE_GAMES      = 64; /**< Games a thread replays at a time. */
+        constexpr size_t WINDOW_PER_THREAD = 4; /**< Game chunks a thread takes per window. */
+
+        /**
+         * Replays a game into rows, nothing is added if a ply isn't legal. The position
+         * before a phase advance is the one after it and gets a single row.
+         */
+        void storeGame(const RecordView& record, Game& game, ActionList& actions,
+                std::vector<StoreRow>& rows)
+        {
+            if (!(loadPacked(record.start(), game)))
+                return;
+
+            const size_t mark = rows.size();
+            const RecordHeader header = record.header();
+            for (uint16_t ply = 0; ; ++ply)
+            {
+                const uint32_t code = ply < header.plies ? record.action(ply) : 0;
+                if (ply == header.plies || code != PHASE_CODE)
+                {
+                    rows.emplace_back();
+                    fillRow(game, rows.back());
+                    rows.back().result = header.result;
+                    rows.back().ply = ply;
+                }
+
+                if (ply == header.plies)
+                    break;
+
+                if (!(playCode(game, code, actions)))
+                {
+                    rows.resize(mark);
+                    return;
+                }
+            }
+        }
+    }
+
+    void fillRow(const Game& game, StoreRow& row)
+    {
+        std::fill(row.masks, row.masks + STORE_MASKS, Bitboard());
+        std::fill(row.hands, row.hands + STORE_HANDS, 0);
+        const Player* toMove = game.currentPlayer();
+        row.toMove = toMove ? toMove->getColor() : Color::None;
+        row.result = Color::None;
+        row.ply = 0;
+
+        for (const Player* player : { game.playerOne(), game.playerTwo() })
+        {
+            const PieceSet& pieces = player->getFullSet();
+            for (SizeType i = 0; i < pieces.Set.size(); ++i)
+            {
+                // A captured commander has no code, so it has no column.
+                const SizeType code = getPieceCode(pieces.pieceAt(i));
+                if (isUnbounded(pieces.pointAt(i)) && code < PIECE_CODE_CT)
+                    ++row.hands[handColumn(player->getColor(), code)];
+            }
+        }
+
+        const Board& board = *(game.gameBoard());
+        for (SizeType y = 0; y < BOARD_HEIGHT; ++y)
+            for (SizeType z = 0; z < BOARD_DEPTH; ++z)
+                for (SizeType x = 0; x < BOARD_WIDTH; ++x)
+                {
+                    const Piece* piece = board[SmallPoint3(x, z, y)];
+                    if (piece->isNull())
+                        continue;
+
+                    const SizeType square = squareOf(SmallPoint3(x, z, y));
+                    const SizeType code = getPieceCode(*piece);
+                    row.masks[maskColumn(y, STORE_OCCUPIED)].set(square);
+                    if (piece->getActiveColor() == Color::White)
+                        row.masks[maskColumn(y, STORE_WHITE)].set(square);
+                    for (size_t b = 0; b < STORE_CODE_BITS; ++b)
+                        if ((code >> b) & 1)
+                            row.masks[maskColumn(y, STORE_CODE + b)].set(square);
+                }
+    }
+
+    PositionStoreWriter::PositionStoreWriter()
+    : _file     (nullptr)
+    , _fill     (0)
+    , _count    (0)
+    {}
+
+    PositionStoreWriter::~PositionStoreWriter()
+    {
+        close();
+    }
+
+    bool PositionStoreWriter::open(const std::string& path)
+    {
+        close();
+
+        _file = std::fopen(path.c_str(), "wb");
+        if (_file == nullptr)
+            return false;
+
+        // The count is written again once known.
+        uint8_t header[HEADER_SIZE] = {};
+        writeU32(header, STORE_MAGIC);
+        writeU32(header + 4, STORE_VERSION);
+        writeU32(header + 16, STORE_CHUNK);
+        _chunk.assign(CHUNK_BYTES, 0);
+        if (std::fwrite(header, HEADER_SIZE, 1, _file) != 1)
+        {
+            std::fclose(_file);
+            _file = nullptr;
+            return false;
+        }
+        return true;
+    }
+
+    bool PositionStoreWriter::append(const StoreRow& row)
+    {
+        if (_file == nullptr)
+            return false;
+
+        uint64_t* masks = reinterpret_cast<uint64_t*>(_chunk.data());
+        for (size_t m = 0; m < STORE_MASKS; ++m)
+        {
+            masks[(2 * m) * STORE_CHUNK + _fill] = row.masks[m].lo;
+            masks[(2 * m + 1) * STORE_CHUNK + _fill] = row.masks[m].hi;
+        }
+
+        for (size_t h = 0; h < STORE_HANDS; ++h)
+            _chunk[HANDS_OFFSET + h * STORE_CHUNK + _fill] = row.hands[h];
+        _chunk[TO_MOVE_OFFSET + _fill] = static_cast<uint8_t>(row.toMove);
+        _chunk[RESULTS_OFFSET + _fill] = static_cast<uint8_t>(row.result);
+        std::memcpy(_chunk.data() + PLIES_OFFSET + _fill * sizeof (uint16_t), &row.ply,
+                sizeof (uint16_t));
+
+        ++_count;
+        return ++_fill < STORE_CHUNK || _flush();
+    }
+
+    bool PositionStoreWriter::close()
+    {
+        if (_file == nullptr)
+            return true;
+
+        uint8_t count[8];
+        writeU64(count, _count);
+        bool ok = _fill == 0 || _flush();
+        ok = ok && std::fseek(_file, 8, SEEK_SET) == 0 && std::fwrite(count, 8, 1, _file) == 1;
+        ok = std::fclose(_file) == 0 && ok;
+
+        _file = nullptr;
+        _chunk.clear();
+        _fill = 0;
+        _count = 0;
+        return ok;
+    }
+
+    bool PositionStoreWriter::_flush()
+    {
+        const bool written = std::fwrite(_chunk.data(), CHUNK_BYTES, 1, _file) == 1;
+
+        // The last chunk is padded with empty positions.
+        std::fill(_chunk.begin(), _chunk.end(), 0);
+        _fill = 0;
+        return written;
+    }
+
+    bool buildPositionStore(const std::vector<std::string>& paths, const std::string& path,
+            SizeType threads)
+    {
+        std::vector<std::unique_ptr<GameRecordReader>> readers;
+        std::vector<RecordChunk> chunks;
+        PositionStoreWriter writer;
+        if (!(chunkRecords(paths, readers, chunks, STORE_GAMES)) || !(writer.open(path)))
+            return false;
+
+        threads = threadCount(threads);
+        const size_t window = threads * WINDOW_PER_THREAD;
+        std::vector<std::vector<StoreRow>> rows(window);
+        std::vector<std::unique_ptr<Game>> games;
+        for (size_t k = 0; k < window; ++k)
+            games.emplace_back(new Game());
+
+        // Game chunks are replayed a window at a time and written in order.
+        bool ok = true;
+        for (size_t first = 0; ok && first < chunks.size(); first += window)
+        {
+            const size_t count = std::min(window, chunks.size() - first);
+            parallelFor(count, threads, [&] (const size_t& k)
+            {
+                const RecordChunk& chunk = chunks[first + k];
+                const GameRecordReader& reader = *(readers[chunk.file]);
+                ActionList actions;
+                rows[k].clear();
+                for (size_t g = chunk.first; g < chunk.first + chunk.count; ++g)
+                    storeGame(reader[g], *(games[k]), actions, rows[k]);
+            });
+
+            for (size_t k = 0; ok && k < count; ++k)
+                for (size_t r = 0; ok && r < rows[k].size(); ++r)
+                    ok = writer.append(rows[k][r]);
+        }
+        return writer.close() && ok;
+    }
+
+    PositionStore::PositionStore()
+    : _data     (nullptr)
+    , _size     (0)
+    , _count    (0)
+    {}
+
+    PositionStore::~PositionStore()
+    {
+        close();
+    }
+
+    bool PositionStore::open(const std::string& path)
+    {
+        close();
+
+        _data = mapFile(path, _size, HEADER_SIZE);
+        if (_data == nullptr)
+            return false;
+
+        _count = readU64(_data + 8);
+        if (readU32(_data) != STORE_MAGIC || readU32(_data + 4) != STORE_VERSION ||
+                readU32(_data + 16) != STORE_CHUNK ||
+                _count > (_size - HEADER_SIZE) / CHUNK_BYTES * STORE_CHUNK ||
+                HEADER_SIZE + chunkCount() * CHUNK_BYTES != _size)
+        {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void PositionStore::close()
+    {
+        unmapFile(_data, _size);
+        _data = nullptr;
+        _size = 0;
+        _count = 0;
+    }
+
+    uint64_t PositionStore::size() const
+    {
+        return _count;
+    }
+
+    size_t PositionStore::chunkCount() const
+    {
+        return static_cast<size_t>((_count + STORE_CHUNK - 1) / STORE_CHUNK);
+    }
+
+    size_t PositionStore::chunkSize(const size_t& k) const
+    {
+        return static_cast<size_t>(std::min<uint64_t>(STORE_CHUNK, _count - k * STORE_CHUNK));
+    }
+
+    const uint64_t* PositionStore::maskLo(const size_t& k, const size_t& mask) const
+    {
+        return reinterpret_cast<const uint64_t*>(_data + HEADER_SIZE + k * CHUNK_BYTES) +
+            2 * mask * STORE_CHUNK;
+    }
+
+    const uint64_t* PositionStore::maskHi(const size_t& k, const size_t& mask) const
+    {
+        return maskLo(k, mask) + STORE_CHUNK;
+    }
+
+    const uint8_t* PositionStore::hands(const size_t& k, const size_t& hand) const
+    {
+        return _data + HEADER_SIZE + k * CHUNK_BYTES + HANDS_OFFSET + hand * STORE_CHUNK;
+    }
+
+    const uint8_t* PositionStore::toMove(const size_t& k) const
+    {
+        return _data + HEADER_SIZE + k * CHUNK_BYTES + TO_MOVE_OFFSET;
+    }
+
+    const uint8_t* PositionStore::results(const size_t& k) const
+    {
+        return _data + HEADER_SIZE + k * CHUNK_BYTES + RESULTS_OFFSET;
+    }
+
+    const uint16_t* PositionStore::plies(const size_t& k) const
+    {
+        return reinterpret_cast<const uint16_t*>(_data + HEADER_SIZE + k * CHUNK_BYTES +
+                PLIES_OFFSET);
+    }
+
+    void PositionStore::row(const uint64_t& i, StoreRow& row) const
+    {
+        const size_t k = static_cast<size_t>(i / STORE_CHUNK);
+        const size_t j = static_cast<size_t>(i % STORE_CHUNK);
+        for (size_t m = 0; m < STORE_MASKS; ++m)
+            row.masks[m] = Bitboard(maskLo(k, m)[j], maskHi(k, m)[j]);
+        for (size_t h = 0; h < STORE_HANDS; ++h)
+            row.hands[h] = hands(k, h)[j];
+        row.toMove = static_cast<Color>(toMove(k)[j]);
+        row.result = static_cast<Color>(results(k)[j]);
+        row.ply = plies(k)[j];
+    }
+}
@@ -159,9 +159,109 @@ namespace Gungi
                 _head == Head::Fortress);
     }
 
+    namespace
+    {
+        SizeType towerKind(const Piece& piece)
+        {
+            return (piece.getActiveColor() == Color::Black ? 0 : PIECE_CODE_CT) + 
+                getPieceCode(piece);
+        }
+
+        SizeType colorIndex(const Color& color)
+        {
+            return color == Color::Black ? 0 : 1;
+        }
+    }
+
+    TowerMasks::TowerMasks()
+    : _kinds {}
+    , _empty (Bitboard::full())
+    {}
+
+    void TowerMasks::refresh(const Board& board)
+    {
+        *this = TowerMasks();
+        for (SizeType square = 0; square < BOARD_SQUARES; ++square)
+            _build(board, square);
+    }
+
+    void TowerMasks::refresh(const Board& board, const SizeType& square)
+    {
+        uint64_t kinds = _kinds[square];
+        while (kinds)
+        {
+            _holding[__builtin_ctzll(kinds)].clear(square);
+            kinds &= kinds - 1;
+        }
+        for (SizeType c = 0; c < 2; ++c)
+        {
+            _tops[c].clear(square);
+            _stackable[c].clear(square);
+        }
+        _kinds[square] = 0;
+        _empty.set(square);
+        _build(board, square);
+    }
+
+    void TowerMasks::_build(const Board& board, const SizeType& square)
+    {
+        const SizeType x = square % BOARD_WIDTH;
+        const SizeType z = square / BOARD_WIDTH;
+        const Piece* top = nullptr;
+        SizeType height = 0;
+        for (; height < BOARD_HEIGHT; ++height)
+        {
+            const Piece* piece = board(x, z, height);
+            if (piece->isNull())
+                break;
+
+            const SizeType kind = towerKind(*piece);
+            _kinds[square] |= uint64_t(1) << kind;
+            _holding[kind].set(square);
+            top = piece;
+        }
+
+        if (height == 0)
+            return;
+
+        _empty.clear(square);
+        const SizeType c = colorIndex(top->getActiveColor());
+        _tops[c].set(square);
+        if (height < BOARD_HEIGHT && top->dropStackable())
+            _stackable[c].set(square);
+    }
+
+    bool TowerMasks::contains(const SizeType& square, const Piece& piece) const
+    {
+        return _kinds[square] & (uint64_t(1) << towerKind(piece));
+    }
+
+    const Bitboard& TowerMasks::holding(const Piece& piece) const
+    {
+        return _holding[towerKind(piece)];
+    }
+
+    const Bitboard& TowerMasks::toppedBy(const Color& color) const
+    {
+        return _tops[colorIndex(color)];
+    }
+
+    const Bitboard& TowerMasks::stackable(const Color& color) const
+    {
+        return _stackable[colorIndex(color)];
+    }
+
+    const Bitboard& TowerMasks::empty() const
+    {
+        return _empty;
+    }
+
     // This constructor is not good for the eyes o.O
     PieceSet::PieceSet(Color headColors, Color tailColors)
     {
+       // The board points into Set, so it must never reallocate. A player can hold every
+       // piece once the ply capturing the opposing commander appends it.
+       Set.reserve(2 * STD_PIECE_CT);
        Set.push_back(std::make_tuple( 
                    Piece(Head::Commander, Tail::None, headColors, tailColors), UBD_PT3));
        Set.push_back(std::make_tuple(
@@ -456,6 +556,53 @@ namespace Gungi
         }
     }
 
+    SizeType getPieceCode(const Piece& piece)
+    {
+        // A captured commander lies tail up on a tail it doesn't have.
+        if (piece.isNull() || (!(piece.onHead()) && piece.getTail() == Tail::None))
+            return PIECE_CODE_CT;
+
+        if (piece.onHead())
+            return static_cast<SizeType>(piece.getHead()) - 1;
+        return FRONT_PCS_CT + static_cast<SizeType>(piece.getTail()) - 1;
+    }
+
+    SizeType getHandKind(const Piece& piece)
+    {
+        return ((piece.onHead() ? 0 : 11) + static_cast<SizeType>(piece.getHead())) * 11 +
+            static_cast<SizeType>(piece.getTail());
+    }
+
+    SizeType getRankValue(const Piece& piece)
+    {
+        return piece.onHead() ? getHeadValue(piece) : getTailValue(piece);
+    }
+
+    SizeType squareOf(const SmallPoint2& pt2)
+    {
+        return pt2.y * BOARD_WIDTH + pt2.x;
+    }
+
+    SizeType squareOf(const SmallPoint3& pt3)
+    {
+        return pt3.z * BOARD_WIDTH + pt3.x;
+    }
+
+    uint16_t locationOf(const SmallPoint3& pt3)
+    {
+        return isUnbounded(pt3) ? LOCATION_IN_HAND : 
+            static_cast<uint16_t>(pt3.y * BOARD_SQUARES + squareOf(pt3));
+    }
+
+    SmallPoint3 pointOf(const uint16_t& location)
+    {
+        if (location == LOCATION_IN_HAND)
+            return UBD_PT3;
+
+        const SizeType square = location % BOARD_SQUARES;
+        return SmallPoint3(square % BOARD_WIDTH, square / BOARD_WIDTH, location / BOARD_SQUARES);
+    }
+
     void genCommanderMoveSet(MoveSet& moveset)
     {
         moveset.emplace_back(1, Direction::NW);
@@ -867,85 +1014,142 @@ namespace Gungi
         return moveset;
     }
 
-    Indices2 genFortressRangeSet(const Board& board, const SmallPoint2& origin, Orientation o)
+    const MoveSet& activeMoveSet(const Piece& piece, const Tier& tier)
     {
-        Indices2  ranges;
-        bool overflowing = false;
-        SizeType i = 0;
-        while (!(overflowing))
+        static const std::vector<MoveSet> movesets = [] ()
         {
-            auto tmp = origin;
-            tmp.y = OverflowAdd(tmp.y, i, BOARD_WIDTH, UNBOUNDED);
-            if (isUnbounded(tmp))
-                overflowing = true;
-            else
+            std::vector<MoveSet> sets;
+            sets.reserve(PIECE_CODE_CT * BOARD_HEIGHT);
+            for (SizeType code = 0; code < PIECE_CODE_CT; ++code)
             {
-                ++i;
-                ranges.push_back(tmp);
+                for (SizeType y = 0; y < BOARD_HEIGHT; ++y)
+                {
+                    if (code < FRONT_PCS_CT)
+                    {
+                        Piece head(static_cast<Head>(code + 1), Tail::None, Color::Black,
+                                Color::White);
+                        sets.push_back(genHeadMoveSet(head, asTier(y)));
+                    }
+                    else
+                    {
+                        Piece tail(Head::None, static_cast<Tail>(code - FRONT_PCS_CT + 1),
+                                Color::Black, Color::White);
+                        tail.flip();
+                        sets.push_back(genTailMoveSet(tail, asTier(y)));
+                    }
+                }
             }
-        }
-        if (o == ORIENTATION_NEG)
-            std::for_each(ranges.begin(), ranges.end(), 
-                    [] (const SmallPoint2& pt2) { return asPositive2(pt2); });
-        return ranges;
+            return sets;
+        } ();
+
+        return movesets[getPieceCode(piece) * BOARD_HEIGHT + static_cast<SizeType>(tier) - 1];
     }
-    
-    Indices2 genCatapultRangeSet(const Board& board, const SmallPoint3& origin, Orientation o)
+
+    namespace
     {
-        Indices2 ranges;
-        if (origin.z < 3)
+        /**
+         * Ranges of every square for both orientations, indexed [o][square]. A negative
+         * range is the positive range of the rotated square, rotated back.
+         */
+        struct RangeTable
         {
-            for (SizeType i = 0; i < 8; ++i)
-                ranges.emplace_back(SmallPoint2(origin));
-                //Type can't be deduced
-                ranges[0].x = OverflowAdd<SizeType>(origin.x, 1, BOARD_WIDTH, UNBOUNDED); 
-                ranges[1].x = OverflowAdd<SizeType>(origin.x, 2, BOARD_WIDTH, UNBOUNDED); 
-                ranges[2].x = OverflowSub<SizeType>(origin.x, 1, UNBOUNDED); 
-                ranges[3].x = OverflowSub<SizeType>(origin.x, 2, UNBOUNDED); 
+            Bitboard fortress[2][BOARD_SQUARES];
+            Bitboard catapult[2][BOARD_SQUARES];
+        };
 
-                if (origin.z == 0) // The overflow stuff isn't really needed here, 
-                    // I'll remove them later
-                {
-                    ranges[4].x = OverflowSub<SizeType>(origin.x, 1, UNBOUNDED);
-                    ranges[4].y = OverflowAdd<SizeType>(origin.z, 1, BOARD_DEPTH, UNBOUNDED); 
-                    ranges[5].y = OverflowAdd<SizeType>(origin.z, 1, BOARD_DEPTH, UNBOUNDED); 
-                    ranges[6].y = OverflowAdd<SizeType>(origin.z, 2, BOARD_DEPTH, UNBOUNDED); 
-                    ranges[7].x = OverflowAdd<SizeType>(origin.x, 1, BOARD_WIDTH, UNBOUNDED);
-                    ranges[7].y = OverflowAdd<SizeType>(origin.z, 1, BOARD_DEPTH, UNBOUNDED); 
-                }
-                else if (origin.z == 1)
-                {
-                    ranges.emplace_back(SmallPoint2(origin));
-                    ranges.emplace_back(SmallPoint2(origin));
-                    ranges[4].x = OverflowSub<SizeType>(origin.x, 1, UNBOUNDED);
-                    ranges[4].y = OverflowAdd<SizeType>(origin.z, 1, BOARD_DEPTH, UNBOUNDED); 
-                    ranges[5].y = OverflowAdd<SizeType>(origin.z, 1, BOARD_DEPTH, UNBOUNDED); 
-                    ranges[6].x = OverflowAdd<SizeType>(origin.x, 1, BOARD_WIDTH, UNBOUNDED);
-                    ranges[6].y = OverflowAdd<SizeType>(origin.z, 1, BOARD_DEPTH, UNBOUNDED);
-                    ranges[7].x = OverflowAdd<SizeType>(origin.x, 1, BOARD_WIDTH, UNBOUNDED);
-                    ranges[7].y = OverflowSub<SizeType>(origin.z, 1, UNBOUNDED);
-                    ranges[8].y = OverflowSub<SizeType>(origin.z, 1, UNBOUNDED);
-                    ranges[9].x = OverflowSub<SizeType>(origin.x, 1, UNBOUNDED);
-                    ranges[9].y = OverflowSub<SizeType>(origin.z, 1, UNBOUNDED);
-                }
-                else if (origin.z == 2)
+        void addRelative(Bitboard& range, const SmallPoint2& origin, int dx, int dz)
+        {
+            int x = origin.x + dx;
+            int z = origin.y + dz;
+            if (x >= 0 && x < BOARD_WIDTH && z >= 0 && z < BOARD_DEPTH)
+                range.set(z * BOARD_WIDTH + x);
+        }
+
+        Bitboard genFortressRange(const SmallPoint2& origin)
+        {
+            Bitboard range;
+            for (int dz = 0; origin.y + dz < BOARD_DEPTH; ++dz)
+                addRelative(range, origin, 0, dz);
+            return range;
+        }
+
+        Bitboard genCatapultRange(const SmallPoint2& origin)
+        {
+            Bitboard range;
+            if (origin.y >= VALID_PLCMT_DEPTH)
+                return range;
+
+            for (int dx = -2; dx <= 2; ++dx)
+                addRelative(range, origin, dx, 0);
+
+            // The rows ahead of and behind the Catapult, limited to the territory.
+            for (int dz = -2; dz <= 2; ++dz)
+            {
+                int z = origin.y + dz;
+                if (dz == 0 || z < 0 || z >= VALID_PLCMT_DEPTH)
+                    continue;
+
+                int span = dz == -2 || dz == 2 ? 0 : 1;
+                for (int dx = -span; dx <= span; ++dx)
+                    addRelative(range, origin, dx, dz);
+            }
+            return range;
+        }
+
+        Bitboard rotate(Bitboard range)
+        {
+            Bitboard rotated;
+            while (!(range.empty()))
+                rotated.set(BOARD_SQUARES - 1 - range.popLowest());
+            return rotated;
+        }
+
+        const RangeTable& rangeTable()
+        {
+            static const RangeTable table = [] ()
+            {
+                RangeTable t;
+                for (SizeType square = 0; square < BOARD_SQUARES; ++square)
                 {
-                    ranges[4].x = OverflowAdd<SizeType>(origin.x, 1, BOARD_WIDTH, UNBOUNDED);
-                    ranges[4].y = OverflowSub<SizeType>(origin.z, 1, UNBOUNDED);
-                    ranges[5].y = OverflowSub<SizeType>(origin.z, 1, UNBOUNDED);
-                    ranges[6].y = OverflowSub<SizeType>(origin.z, 2, UNBOUNDED);
-                    ranges[7].x = OverflowSub<SizeType>(origin.x, 1, UNBOUNDED);
-                    ranges[7].y = OverflowSub<SizeType>(origin.z, 1, UNBOUNDED);
+                    SmallPoint2 origin(square % BOARD_WIDTH, square / BOARD_WIDTH);
+                    SizeType rotated = BOARD_SQUARES - 1 - square;
+                    t.fortress[ORIENTATION_POS][square] = genFortressRange(origin);
+                    t.catapult[ORIENTATION_POS][square] = genCatapultRange(origin);
+                    t.fortress[ORIENTATION_NEG][rotated] = rotate(genFortressRange(origin));
+                    t.catapult[ORIENTATION_NEG][rotated] = rotate(genCatapultRange(origin));
                 }
+                return t;
+            } ();
 
-            if (o == ORIENTATION_NEG)
-                std::for_each(ranges.begin(), ranges.end(), 
-                        [] (const SmallPoint2& pt2) { return asPositive2(pt2); });
+            return table;
+        }
+    }
 
-            std::remove_if(ranges.begin(), ranges.end(), 
-                    [] (const SmallPoint2& pt2) { return isUnbounded(pt2); });
+    const Bitboard& fortressRange(const SizeType& square, Orientation o)
+    {
+        return rangeTable().fortress[o][square];
+    }
+
+    const Bitboard& catapultRange(const SizeType& square, Orientation o)
+    {
+        return rangeTable().catapult[o][square];
+    }
+
+    Bitboard expansionRange(const Board& board, const Color& color, Orientation o)
+    {
+        Bitboard range;
+        for (SizeType square = 0; square < BOARD_SQUARES; ++square)
+        {
+            const Piece& piece = *(board(square % BOARD_WIDTH, square / BOARD_WIDTH, 0));
+            if (piece.isNull() || !(piece.onHead()) || piece.getActiveColor() != color)
+                continue;
+
+            if (piece.getHead() == Head::Fortress)
+                range |= fortressRange(square, o);
+            else if (piece.getHead() == Head::Catapult)
+                range |= catapultRange(square, o);
         }
-        return std::move(ranges);
+        return range;
     }
 
     SmallPoint2 asPositive2(const SmallPoint2& pt2)
@@ -1117,14 +1321,14 @@ namespace Gungi
                 break;
             case Direction::SE:
                 pt2.x = OverflowAdd(pt2.x, move.getMagnitude(), BOARD_WIDTH, UNBOUNDED);
-                pt2.y = OverflowAdd(pt2.y, move.getMagnitude(), BOARD_DEPTH, UNBOUNDED);
+                pt2.y = OverflowSub(pt2.y, move.getMagnitude(), UNBOUNDED);
                 break;
             case Direction::S:
                 pt2.y = OverflowSub(pt2.y, move.getMagnitude(), UNBOUNDED);
                 break;
             case Direction::SW:
                 pt2.x = OverflowSub(pt2.x, move.getMagnitude(), UNBOUNDED);
-                pt2.y = OverflowAdd(pt2.y, move.getMagnitude(), BOARD_DEPTH, UNBOUNDED);
+                pt2.y = OverflowSub(pt2.y, move.getMagnitude(), UNBOUNDED);
                 break;
             case Direction::W:
                 pt2.x = OverflowSub(pt2.x, move.getMagnitude(), UNBOUNDED);
@@ -1184,7 +1388,7 @@ namespace Gungi
     }
 
     bool validPlacementDrop(const Board& board, const Piece& piece, SmallPoint3 pt3,
-            Orientation o)
+            const uint16_t& soldierFiles, Orientation o)
     {
         #if (DEBUG)
             cerr << "In validPlacementDrop()" << endl;
@@ -1218,42 +1422,16 @@ namespace Gungi
                 cerr << "In validPlacementDrop(), piece is a soldier." << endl;
             #endif
 
-            if (o == ORIENTATION_POS)
-            {
-                for (SizeType i = 0u; i < VALID_PLCMT_DEPTH; ++i)
-                {
-                    for (SizeType j = 0u; j < BOARD_HEIGHT; ++j)
-                    {
-                        pt3.z = i;
-                        pt3.y = j;
-                        if (isNullAt(board, pt3))
-                            break;
-
-                        if (board[pt3]->getHead() == Head::Soldier)
-                            return false;
-                    }
-                }
-            }
-            else
-            {
-                for (SizeType i = BOARD_DEPTH - VALID_PLCMT_DEPTH; 
-                        i < BOARD_DEPTH; ++i)
-                {
-                    for (SizeType j = 0u; j < BOARD_HEIGHT; ++j)
-                    {
-                        SmallPoint3 tmp = { pt3.x, i, j };
-                        if (board[tmp]->getHead() == Head::Soldier)
-                            return false;
-                    }
-                }
-            }
+            // pt3 is in positive orientation by now, as are the files of the mask.
+            if (soldierFiles & (1 << pt3.x))
+                return false;
 
             #if (DEBUG)
                 cerr << "In validPlacementDrop(), piece (soldier) can be dropped." << endl;
             #endif
         }
 
-        if (piece.onHead() && (piece.getHead() == Head::Catapult || piece.getHead() == Head::Catapult)
+        if (piece.onHead() && (piece.getHead() == Head::Catapult || piece.getHead() == Head::Fortress)
                 && availableTierAt(board, pt3) != 0)
             return false;
 
@@ -1272,15 +1450,20 @@ namespace Gungi
 
         // Catapult and Fortress must be at first tier.
         if (piece.onHead() && (piece.getHead() == Head::Catapult || 
-                    piece.getHead() == Head::Catapult) && availableTierAt(board, pt3) != 0) 
+                    piece.getHead() == Head::Fortress) && availableTierAt(board, pt3) != 0) 
             return false;
 
         pt3.y = availableTierAt(board, pt3);
         if (pt3.y == NO_TIERS_FREE)
             return false;
 
+        if (pt3.y == 0)
+            return true;
+
+        // Only allied drop-stackable pieces can be dropped on.
+        --pt3.y;
         const Piece& topPiece = *(board[pt3]); 
-        return topPiece.dropStackable();
+        return topPiece.dropStackable() && topPiece.getActiveColor() == piece.getActiveColor();
     }
 
 
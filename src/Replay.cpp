@@ -0,0 +1,168 @@
+/*
+ * Copyright 2016 Fermin, Yaneury <fermin.yaneury@gmail.com>
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include <Parallel.hpp>
+#include <Replay.hpp>
+
+namespace Gungi
+{
+    namespace
+    {
+        /**
+         * Adds the totals of a thread to the report.
+         */
+        void merge(ReplayReport& report, const ReplayReport& part)
+        {
+            report.games += part.games;
+            report.plies += part.plies;
+            report.valid += part.valid;
+            for (size_t c = 0; c < 3; ++c)
+                report.results[c] += part.results[c];
+            report.issues.insert(report.issues.end(), part.issues.begin(), part.issues.end());
+        }
+    }
+
+    const char* replayStatusName(const ReplayStatus& status)
+    {
+        static const char* const NAMES[] =
+        { "valid", "bad start", "bad action", "illegal action", "result mismatch" };
+        return NAMES[static_cast<size_t>(status)];
+    }
+
+    ReplayReport::ReplayReport()
+    : files     (0)
+    , games     (0)
+    , plies     (0)
+    , valid     (0)
+    , results   {}
+    , seconds   (0)
+    {}
+
+    ReplayStatus replayGame(const RecordView& record, Game& game, uint16_t& ply)
+    {
+        ply = 0;
+        if (!(loadPacked(record.start(), game)))
+            return ReplayStatus::BadStart;
+
+        const RecordHeader header = record.header();
+        ActionList actions;
+        for (; ply < header.plies; ++ply)
+        {
+            Action action;
+            const uint32_t code = record.action(ply);
+            if (code != PHASE_CODE && !(decodeAction(game, code, action)))
+                return ReplayStatus::BadAction;
+
+            if (!(playCode(game, code, actions)))
+                return ReplayStatus::IllegalAction;
+        }
+
+        const Color& winner = game.getWinner();
+        if ((winner != Color::None && winner != header.result) ||
+                (header.termination == Termination::Commander && winner == Color::None))
+            return ReplayStatus::ResultMismatch;
+
+        return ReplayStatus::Valid;
+    }
+
+    bool listRecordFiles(const std::string& directory, std::vector<std::string>& paths)
+    {
+        DIR* dir = ::opendir(directory.c_str());
+        if (dir == nullptr)
+            return false;
+
+        std::vector<std::string> found;
+        for (const dirent* entry = ::readdir(dir); entry; entry = ::readdir(dir))
+        {
+            const std::string name = entry->d_name;
+            const std::string path = directory + "/" + name;
+            struct stat info;
+            if (name[0] == '.' || (name.size() > 4 && name.compare(name.size() - 4, 4, ".idx")
+                        == 0) || ::stat(path.c_str(), &info) != 0 || !(S_ISREG(info.st_mode)))
+                continue;
+
+            found.push_back(path);
+        }
+        ::closedir(dir);
+
+        std::sort(found.begin(), found.end());
+        paths.insert(paths.end(), found.begin(), found.end());
+        return true;
+    }
+
+    bool replayFiles(const std::vector<std::string>& paths, ReplayReport& report,
+            SizeType threads)
+    {
+        const auto begin = std::chrono::steady_clock::now();
+        report = ReplayReport();
+
+        std::vector<std::unique_ptr<GameRecordReader>> readers;
+        std::vector<RecordChunk> chunks;
+        if (!(chunkRecords(paths, readers, chunks, REPLAY_CHUNK)))
+            return false;
+
+        threads = std::max<SizeType>(1, std::min<size_t>(threadCount(threads),
+                    std::max<size_t>(chunks.size(), 1)));
+        std::vector<ReplayReport> parts(threads);
+        std::vector<std::unique_ptr<Game>> games;
+        for (SizeType t = 0; t < threads; ++t)
+            games.emplace_back(new Game());
+
+        parallelForWorkers(chunks.size(), threads, [&] (const SizeType& t, const size_t& c)
+        {
+            ReplayReport& part = parts[t];
+            Game& game = *(games[t]);
+            const RecordChunk& chunk = chunks[c];
+            const GameRecordReader& reader = *(readers[chunk.file]);
+            for (size_t g = chunk.first; g < chunk.first + chunk.count; ++g)
+            {
+                const RecordView record = reader[g];
+                uint16_t ply;
+                const ReplayStatus status = replayGame(record, game, ply);
+                ++part.games;
+                part.plies += ply;
+                if (status == ReplayStatus::Valid)
+                {
+                    ++part.valid;
+                    ++part.results[static_cast<size_t>(game.getWinner())];
+                }
+                else
+                    part.issues.push_back({ chunk.file, g, record.header().id, ply, status });
+            }
+        });
+
+        for (const ReplayReport& part : parts)
+            merge(report, part);
+
+        std::sort(report.issues.begin(), report.issues.end(),
+                [] (const ReplayIssue& lhs, const ReplayIssue& rhs)
+                {
+                    return lhs.file < rhs.file || (lhs.file == rhs.file && lhs.game < rhs.game);
+                });
+
+        report.files = paths.size();
+        report.seconds = std::chrono::duration<double>(
+                std::chrono::steady_clock::now() - begin).count();
+        return true;
+    }
+}
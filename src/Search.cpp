@@ -0,0 +1,656 @@
+/*
+ * Copyright 2016 Fermin, Yaneury <fermin.yaneury@gmail.com>
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <Search.hpp>
+
+namespace Gungi
+{
+    static_assert(MAX_PLY < AccumulatorStack::MAX_DEPTH, "the search outgrows its accumulators");
+
+    namespace
+    {
+        SizeType colorIndex(const Color& color)
+        {
+            return color == Color::White ? 1 : 0;
+        }
+
+        /**
+         * A piece that may join an exchange on a square.
+         */
+        struct Attacker
+        {
+            Attacker()
+            : piece  (nullptr)
+            , origin (UBD_PT3)
+            {}
+
+            const Piece* piece;
+            SmallPoint3 origin;
+        };
+
+        /**
+         * The attackers of one color, handed out least valuable first.
+         */
+        struct AttackerList
+        {
+            AttackerList()
+            : size (0)
+            {}
+
+            void push(const Piece* piece, const SmallPoint3& origin)
+            {
+                if (size < MAX_ATTACKERS)
+                {
+                    items[size].piece = piece;
+                    items[size++].origin = origin;
+                }
+            }
+
+            bool popLeast(Attacker& attacker)
+            {
+                if (size == 0)
+                    return false;
+
+                SizeType least = 0;
+                for (SizeType i = 1; i < size; ++i)
+                    if (getRankValue(*(items[i].piece)) < getRankValue(*(items[least].piece)))
+                        least = i;
+
+                attacker = items[least];
+                items[least] = items[--size];
+                return true;
+            }
+
+            static constexpr SizeType MAX_ATTACKERS = 2 * STD_PIECE_CT;
+            Attacker items[MAX_ATTACKERS];
+            SizeType size;
+        };
+
+        int32_t exchangeValue(const Piece& piece)
+        {
+            if (piece.onHead() && piece.getHead() == Head::Commander)
+                return WIN_SCORE;
+            return captureGain(piece);
+        }
+
+        /**
+         * Adds the piece uncovered by the one leaving origin, if it reaches target.
+         */
+        void uncover(const Game& game, const SmallPoint3& origin, const SmallPoint2& target,
+                AttackerList* lists)
+        {
+            if (origin.y == 0)
+                return;
+
+            const Board& board = *(game.gameBoard());
+            SmallPoint3 below(origin.x, origin.z, origin.y - 1);
+            const Piece* piece = board[below];
+            const Player& owner = piece->getActiveColor() == game.currentPlayer()->getColor() ?
+                *(game.currentPlayer()) : *(game.idlePlayer());
+
+            if (canReach(board, owner, below, target))
+                lists[&owner == game.currentPlayer() ? 0 : 1].push(piece, below);
+        }
+
+        int32_t materialOf(const Player& player)
+        {
+            int32_t material = 0;
+            const PieceSet& pieces = player.getFullSet();
+            for (SizeType i = 0; i < pieces.Set.size(); ++i)
+                material += getRankValue(pieces.pieceAt(i));
+            return material;
+        }
+    }
+
+    TranspositionTable::TranspositionTable(size_t entries)
+    : _entries ()
+    , _mask    (0)
+    {
+        size_t size = 1;
+        while (size * 2 <= entries)
+            size *= 2;
+
+        _entries.resize(size);
+        _mask = size - 1;
+        clear();
+    }
+
+    void TranspositionTable::clear()
+    {
+        for (TTEntry& entry : _entries)
+            entry = TTEntry { 0, NULL_ACTION, 0, 0, Bound::None };
+    }
+
+    const TTEntry* TranspositionTable::probe(const Key& key) const
+    {
+        const TTEntry& entry = _entries[key & _mask];
+        return entry.bound != Bound::None && entry.key == key ? &entry : nullptr;
+    }
+
+    void TranspositionTable::store(const Key& key, const Action& move, const int32_t& score,
+            const SizeType& depth, const Bound& bound)
+    {
+        _entries[key & _mask] = TTEntry { key, move, score, depth, bound };
+    }
+
+    KillerTable::KillerTable()
+    {
+        clear();
+    }
+
+    void KillerTable::clear()
+    {
+        for (auto& slots : _killers)
+            slots[0] = slots[1] = NULL_ACTION;
+    }
+
+    void KillerTable::store(const SizeType& ply, const Action& action)
+    {
+        if (_killers[ply][0] == action)
+            return;
+
+        _killers[ply][1] = _killers[ply][0];
+        _killers[ply][0] = action;
+    }
+
+    const Action& KillerTable::killerAt(const SizeType& ply, const SizeType& slot) const
+    {
+        return _killers[ply][slot];
+    }
+
+    HistoryTable::HistoryTable()
+    {
+        clear();
+    }
+
+    void HistoryTable::clear()
+    {
+        for (auto& color : _scores)
+            for (auto& code : color)
+                for (int32_t& score : code)
+                    score = 0;
+    }
+
+    void HistoryTable::reward(const Color& color, const SizeType& code, const SizeType& square,
+            const SizeType& depth)
+    {
+        int32_t& score = _scores[colorIndex(color)][code][square];
+        score += depth * depth;
+
+        // Halve everything once a score grows large so old cutoffs fade out.
+        if (score > (1 << 16))
+            for (auto& c : _scores)
+                for (auto& k : c)
+                    for (int32_t& s : k)
+                        s /= 2;
+    }
+
+    int32_t HistoryTable::scoreOf(const Color& color, const SizeType& code,
+            const SizeType& square) const
+    {
+        return _scores[colorIndex(color)][code][square];
+    }
+
+    OrderingStats::OrderingStats()
+    {
+        clear();
+    }
+
+    void OrderingStats::clear()
+    {
+        nodes = cutoffs = firstMoveCutoffs = 0;
+    }
+
+    void OrderingStats::recordCutoff(const size_t& moveNumber)
+    {
+        ++cutoffs;
+        if (moveNumber == 1)
+            ++firstMoveCutoffs;
+    }
+
+    double OrderingStats::firstMoveRate() const
+    {
+        return cutoffs == 0 ? 0.0 : static_cast<double>(firstMoveCutoffs) / cutoffs;
+    }
+
+    MovePicker::MovePicker(const Game& game, ActionList& actions, const Action& ttMove,
+            const KillerTable& killers, const HistoryTable& history, const SizeType& ply)
+    : _game        (game)
+    , _actions     (actions)
+    , _ttMove      (ttMove)
+    , _killers     (killers)
+    , _history     (history)
+    , _ply         (ply)
+    , _stage       (Stage::TTMove)
+    , _cursor      (0)
+    , _capturesEnd (0)
+    , _quietsEnd   (0)
+    , _killerSlot  (0)
+    {}
+
+    bool MovePicker::next(Action& action)
+    {
+        switch (_stage)
+        {
+            case Stage::TTMove:
+                _stage = Stage::InitCaptures;
+                if (_ttMove.type != ActionType::None)
+                {
+                    for (size_t i = 0; i < _actions.size(); ++i)
+                    {
+                        if (_actions[i] == _ttMove)
+                        {
+                            action = _actions[i];
+                            return true;
+                        }
+                    }
+                    _ttMove = NULL_ACTION;
+                }
+                // Fall through
+            case Stage::InitCaptures:
+                _partition();
+                _scoreCaptures();
+                _stage = Stage::Captures;
+                // Fall through
+            case Stage::Captures:
+                while (_selectBest(_capturesEnd, action))
+                    if (action != _ttMove)
+                        return true;
+                _stage = Stage::Killers;
+                // Fall through
+            case Stage::Killers:
+                while (_killerSlot < 2)
+                {
+                    const Action& killer = _killers.killerAt(_ply, _killerSlot++);
+                    if (killer.type != ActionType::None && killer != _ttMove &&
+                            _findKiller(killer))
+                    {
+                        action = killer;
+                        return true;
+                    }
+                }
+                _stage = Stage::InitQuiets;
+                // Fall through
+            case Stage::InitQuiets:
+                _scoreQuiets();
+                _stage = Stage::Quiets;
+                // Fall through
+            case Stage::Quiets:
+                while (_selectBest(_quietsEnd, action))
+                    if (action != _ttMove)
+                        return true;
+                _stage = Stage::Drops;
+                // Fall through
+            case Stage::Drops:
+                while (_cursor < _actions.size())
+                {
+                    action = _actions[_cursor++];
+                    if (action != _ttMove)
+                        return true;
+                }
+                _stage = Stage::Done;
+                // Fall through
+            case Stage::Done:
+                return false;
+        }
+        return false;
+    }
+
+    void MovePicker::_partition()
+    {
+        size_t end = 0;
+        for (size_t i = 0; i < _actions.size(); ++i)
+            if (_actions[i].onOpponent)
+                _actions.swap(i, end++);
+        _capturesEnd = end;
+
+        for (size_t i = end; i < _actions.size(); ++i)
+            if (_actions[i].type == ActionType::Move)
+                _actions.swap(i, end++);
+        _quietsEnd = end;
+    }
+
+    void MovePicker::_scoreCaptures()
+    {
+        const Board& board = *(_game.gameBoard());
+        const Player& player = *(_game.currentPlayer());
+        for (size_t i = 0; i < _capturesEnd; ++i)
+        {
+            const Piece& victim = *(board[_actions[i].destination]);
+            const Piece& attacker = player.pieceAt(_actions[i].index);
+            if (victim.onHead() && victim.getHead() == Head::Commander)
+                _actions.scoreAt(i) = INF_SCORE;
+            else
+                _actions.scoreAt(i) = static_cast<int32_t>(getRankValue(victim)) -
+                    static_cast<int32_t>(getRankValue(attacker));
+
+            // Only a capture by a piece worth more than its victim can lose material.
+            if (_actions.scoreAt(i) < 0 && see(_game, _actions[i]) < 0)
+                _actions.scoreAt(i) -= INF_SCORE;
+        }
+    }
+
+    void MovePicker::_scoreQuiets()
+    {
+        const Player& player = *(_game.currentPlayer());
+        for (size_t i = _cursor; i < _quietsEnd; ++i)
+            _actions.scoreAt(i) = _history.scoreOf(player.getColor(), 
+                    getPieceCode(player.pieceAt(_actions[i].index)), 
+                    squareOf(_actions[i].destination));
+    }
+
+    bool MovePicker::_selectBest(const size_t& end, Action& action)
+    {
+        if (_cursor >= end)
+            return false;
+
+        size_t best = _cursor;
+        for (size_t i = _cursor + 1; i < end; ++i)
+            if (_actions.scoreAt(i) > _actions.scoreAt(best))
+                best = i;
+
+        _actions.swap(best, _cursor);
+        action = _actions[_cursor++];
+        return true;
+    }
+
+    bool MovePicker::_findKiller(const Action& killer)
+    {
+        for (size_t i = _cursor; i < _quietsEnd; ++i)
+        {
+            if (_actions[i] == killer)
+            {
+                _actions.swap(i, _cursor++);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    int32_t evaluate(const Game& game)
+    {
+        return materialOf(*(game.currentPlayer())) - materialOf(*(game.idlePlayer()));
+    }
+
+    int32_t captureGain(const Piece& victim)
+    {
+        int32_t flipped = victim.onHead() ? getTailValue(victim) : getHeadValue(victim);
+        return getRankValue(victim) + flipped;
+    }
+
+    int32_t see(const Game& game, const Action& action)
+    {
+        if (!(action.onOpponent))
+            return 0;
+
+        // An immobile attacker doesn't leave its tower, there is nothing to exchange.
+        if (action.type == ActionType::Immobile)
+            return exchangeValue(*(game.gameBoard()->operator[](action.destination)));
+
+        const Board& board = *(game.gameBoard());
+        const SmallPoint2 target(action.destination);
+        AttackerList lists[2];
+        const Player* players[2] = { game.currentPlayer(), game.idlePlayer() };
+
+        for (SizeType side = 0; side < 2; ++side)
+        {
+            const PieceSet& pieces = players[side]->getFullSet();
+            for (SizeType i = 0; i < pieces.Set.size(); ++i)
+            {
+                const SmallPoint3& origin = pieces.pointAt(i);
+                if (isUnbounded(origin) || SmallPoint2(origin) == target || 
+                        origin == action.origin || !(isTopAt(board, origin)))
+                    continue;
+
+                if (canReach(board, *(players[side]), origin, target))
+                    lists[side].push(&pieces.pieceAt(i), origin);
+            }
+        }
+
+        // The top of the tower is replaced on every capture, so the piece standing on
+        // target is always the last one that captured.
+        int32_t gains[2 * AttackerList::MAX_ATTACKERS + 1];
+        SizeType depth = 0;
+        gains[0] = exchangeValue(*(board[action.destination]));
+        const Piece* occupant = board[action.origin];
+        uncover(game, action.origin, target, lists);
+
+        SizeType side = 1;
+        Attacker attacker;
+        while (lists[side].popLeast(attacker))
+        {
+            ++depth;
+            gains[depth] = exchangeValue(*occupant) - gains[depth - 1];
+            occupant = attacker.piece;
+            uncover(game, attacker.origin, target, lists);
+            side ^= 1;
+        }
+
+        while (depth > 0)
+        {
+            gains[depth - 1] = -std::max(-gains[depth - 1], gains[depth]);
+            --depth;
+        }
+        return gains[0];
+    }
+
+    Searcher::Searcher(size_t ttEntries)
+    : _tt           (ttEntries)
+    , _killers      ()
+    , _history      ()
+    , _stats        ()
+    , _lists        (MAX_PLY)
+    , _rootBest     ()
+    , _score        (0)
+    , _network      (nullptr)
+    , _accumulators ()
+    {}
+
+    Action Searcher::search(Game& game, const SizeType& depth)
+    {
+        _rootBest = NULL_ACTION;
+        _killers.clear();
+        if (_network)
+            _accumulators->reset(*_network, game);
+
+        for (SizeType d = 1; d <= depth && d < MAX_PLY; ++d)
+        {
+            _score = _alphaBeta(game, -INF_SCORE, INF_SCORE, d, 0);
+
+            #if (DEBUG)
+                cerr << "In Searcher::search(), depth: " << (size_t) d << " score: " << _score
+                    << " nodes: " << _stats.nodes << " first move cutoffs: " 
+                    << _stats.firstMoveRate() << endl;
+            #endif
+        }
+        return _rootBest;
+    }
+
+    int32_t Searcher::score() const
+    {
+        return _score;
+    }
+
+    const OrderingStats& Searcher::stats() const
+    {
+        return _stats;
+    }
+
+    void Searcher::clear()
+    {
+        _tt.clear();
+        _killers.clear();
+        _history.clear();
+        _stats.clear();
+    }
+
+    void Searcher::setNetwork(const Network* network)
+    {
+        _network = network;
+        if (_network && !(_accumulators))
+            _accumulators.reset(new AccumulatorStack());
+    }
+
+    int32_t Searcher::_alphaBeta(Game& game, int32_t alpha, int32_t beta, SizeType depth,
+            const SizeType& ply)
+    {
+        // The previous action captured the commander of the player to move.
+        if (game.getWinner() != Color::None)
+            return -WIN_SCORE + ply;
+
+        // A repeated position is scored as a draw, shuffling can't win anything.
+        if (ply > 0 && game.repetitions() > 0)
+            return DRAW_SCORE;
+
+        if (depth == 0 || ply + 1 >= MAX_PLY)
+            return _quiescence(game, alpha, beta, ply);
+
+        ++_stats.nodes;
+        const Key key = game.getKey();
+        const TTEntry* entry = _tt.probe(key);
+        Action ttMove = entry ? entry->move : NULL_ACTION;
+
+        if (entry && ply > 0 && entry->depth >= depth)
+        {
+            if (entry->bound == Bound::Exact ||
+                    (entry->bound == Bound::Lower && entry->score >= beta) ||
+                    (entry->bound == Bound::Upper && entry->score <= alpha))
+                return entry->score;
+        }
+
+        ActionList& actions = _lists[ply];
+        genActions(game, actions);
+        if (actions.empty())
+            return -WIN_SCORE + ply;
+
+        MovePicker picker(game, actions, ttMove, _killers, _history, ply);
+        const int32_t alphaOrig = alpha;
+        int32_t best = -INF_SCORE;
+        Action bestAction;
+        Action action;
+        size_t moveNumber = 0;
+
+        while (picker.next(action))
+        {
+            ++moveNumber;
+            _make(game, action);
+            int32_t score = -_alphaBeta(game, -beta, -alpha, depth - 1, ply + 1);
+            _unmake(game);
+
+            if (score > best)
+            {
+                best = score;
+                bestAction = action;
+                if (ply == 0)
+                    _rootBest = action;
+            }
+
+            if (score > alpha)
+                alpha = score;
+
+            if (alpha >= beta)
+            {
+                _stats.recordCutoff(moveNumber);
+                if (!(action.onOpponent) && action.type == ActionType::Move)
+                    _rewardQuiet(game, action, depth, ply);
+                break;
+            }
+        }
+
+        Bound bound = best <= alphaOrig ? Bound::Upper : 
+            (best >= beta ? Bound::Lower : Bound::Exact);
+        _tt.store(key, bestAction, best, depth, bound);
+        return best;
+    }
+
+    int32_t Searcher::_quiescence(Game& game, int32_t alpha, int32_t beta, const SizeType& ply)
+    {
+        if (game.getWinner() != Color::None)
+            return -WIN_SCORE + ply;
+
+        ++_stats.nodes;
+        const int32_t standPat = _evaluate(game);
+        if (standPat >= beta || ply + 1 >= MAX_PLY)
+            return standPat;
+
+        if (standPat > alpha)
+            alpha = standPat;
+
+        ActionList& actions = _lists[ply];
+        genCaptures(game, actions);
+
+        const Board& board = *(game.gameBoard());
+        MovePicker picker(game, actions, NULL_ACTION, _killers, _history, ply);
+        Action action;
+
+        while (picker.next(action))
+        {
+            // Skip captures that can't lift the score to alpha even with some slack.
+            const Piece& victim = *(board[action.destination]);
+            bool commander = victim.onHead() && victim.getHead() == Head::Commander;
+            if (!(commander) && standPat + captureGain(victim) + DELTA_MARGIN <= alpha)
+                continue;
+
+            if (!(commander) && see(game, action) < 0)
+                continue;
+
+            _make(game, action);
+            int32_t score = -_quiescence(game, -beta, -alpha, ply + 1);
+            _unmake(game);
+
+            if (score >= beta)
+                return score;
+
+            if (score > alpha)
+                alpha = score;
+        }
+        return alpha;
+    }
+
+    void Searcher::_rewardQuiet(const Game& game, const Action& action, const SizeType& depth,
+            const SizeType& ply)
+    {
+        const Player& player = *(game.currentPlayer());
+        _killers.store(ply, action);
+        _history.reward(player.getColor(), getPieceCode(player.pieceAt(action.index)),
+                squareOf(action.destination), depth);
+    }
+
+    void Searcher::_make(Game& game, const Action& action)
+    {
+        // MAX_PLY keeps the accumulators from running out.
+        if (_network)
+            _accumulators->make(*_network, game, action);
+        else
+            game.make(action);
+    }
+
+    void Searcher::_unmake(Game& game)
+    {
+        if (_network)
+            _accumulators->unmake(game);
+        else
+            game.unmake();
+    }
+
+    int32_t Searcher::_evaluate(const Game& game) const
+    {
+        if (_network)
+            return _network->evaluate(_accumulators->top(), game.currentPlayer()->getColor());
+        return evaluate(game);
+    }
+}
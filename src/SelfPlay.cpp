@@ -0,0 +1,370 @@
+/*
+ * Copyright 2016 Fermin, Yaneury <fermin.yaneury@gmail.com>
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+#include <atomic>
+#include <cstring>
+#include <ctime>
+#include <thread>
+
+#include <GameRecord.hpp>
+#include <Mcts.hpp>
+#include <Search.hpp>
+#include <SelfPlay.hpp>
+
+namespace Gungi
+{
+    namespace
+    {
+        void appendU16(std::vector<uint8_t>& out, const uint16_t& value)
+        {
+            out.push_back(static_cast<uint8_t>(value));
+            out.push_back(static_cast<uint8_t>(value >> 8));
+        }
+
+        void appendU32(std::vector<uint8_t>& out, const uint32_t& value)
+        {
+            for (SizeType i = 0; i < 4; ++i)
+                out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+        }
+
+        void appendPieces(std::vector<uint8_t>& out, const Player& player)
+        {
+            const PieceSet& pieces = player.getFullSet();
+            for (SizeType i = 0; i < pieces.Set.size(); ++i)
+            {
+                // The packed state keeps the hidden side, so variants can be rebuilt.
+                const uint16_t location = locationOf(pieces.pointAt(i));
+                appendU16(out, static_cast<uint16_t>(location << 6 |
+                            packedState(pieces.pieceAt(i))));
+            }
+        }
+
+        /**
+         * The state of one self-play thread.
+         */
+        class Worker
+        {
+            public:
+
+                Worker(const SelfPlayConfig& config, const SizeType& id,
+                        std::atomic<uint32_t>& next, const Network* network)
+                : _config    (config)
+                , _id        (id)
+                , _next      (next)
+                , _rng       (config.seed + 0x9E3779B97F4A7C15ull * (id + 1))
+                , _playout   (config.seed ^ (id + 1))
+                , _rollout   ()
+                , _static    ()
+                , _ok        (true)
+                {
+                    if (config.engine == SelfPlayEngine::Mcts)
+                    {
+                        MctsConfig mcts;
+                        mcts.threads = 1;
+                        mcts.playouts = config.playouts;
+                        mcts.maxNodes = config.maxNodes;
+                        mcts.seed = _rng.next();
+                        _mcts.reset(new Mcts(mcts, config.rollouts ?
+                                    static_cast<const LeafEvaluator&>(_rollout) : _static));
+                    }
+                    else
+                    {
+                        _searcher.reset(new Searcher(1 << 18));
+                        _searcher->setNetwork(network);
+                    }
+
+                    _payload.reserve(1 << 16);
+                }
+
+                void run()
+                {
+                    const std::string path = _config.prefix + "-" + std::to_string(_id);
+                    if (!(_writer.open(path + ".bin")) || !(_records.open(path + ".rec")))
+                    {
+                        _ok = false;
+                        return;
+                    }
+
+                    for (uint32_t game = _next.fetch_add(1); game < _config.games;
+                            game = _next.fetch_add(1))
+                        if (!(_play(game)))
+                        {
+                            _ok = false;
+                            break;
+                        }
+
+                    _ok = _writer.close() && _ok;
+                    _ok = _records.close() && _ok;
+                }
+
+                bool ok() const
+                {
+                    return _ok;
+                }
+
+            private:
+                bool _play(const uint32_t& number)
+                {
+                    // The log starts with the placement phase, so records hold the drops.
+                    Game game;
+                    game.start();
+                    _log.begin(game);
+                    for (SizeType i = 0; i < 2 * _config.placements; ++i)
+                    {
+                        Action action;
+                        if (!(_playout.pick(game, action)))
+                            break;
+                        _log.record(game, action);
+                        game.make(action);
+                    }
+                    game.start();
+
+                    if (_searcher)
+                        _searcher->clear();
+
+                    _payload.clear();
+                    _payload.push_back(RECORD_VERSION);
+                    _payload.push_back(0);
+                    appendU16(_payload, 0);
+
+                    uint16_t plies = 0;
+                    bool repeated = false;
+                    while (!(repeated) && plies < _config.maxPlies && 
+                            game.getWinner() == Color::None)
+                    {
+                        Action chosen = _choose(game, plies);
+                        if (chosen == NULL_ACTION)
+                            break;
+
+                        appendPosition(_payload, game);
+                        appendAction(_payload, chosen);
+                        appendU16(_payload, static_cast<uint16_t>(_visits.size()));
+                        for (const RootStat& stat : _visits)
+                        {
+                            appendAction(_payload, stat.action);
+                            appendU32(_payload, stat.visits);
+                        }
+
+                        _log.record(game, chosen);
+                        game.make(chosen);
+                        ++plies;
+                        repeated = game.repetitions() >= _config.repetitions;
+                    }
+
+                    RecordHeader header;
+                    header.id = _config.seed ^ number;
+                    header.time = static_cast<uint32_t>(std::time(nullptr));
+                    header.termination = game.getWinner() != Color::None ? Termination::Commander :
+                        repeated ? Termination::Repetition : plies >= _config.maxPlies ?
+                        Termination::PlyLimit : Termination::NoActions;
+
+                    Color winner = game.getWinner();
+                    if (header.termination == Termination::NoActions)
+                        winner = game.idlePlayer()->getColor();
+                    header.result = winner;
+
+                    _payload[1] = winner == Color::Black ? 1 : winner == Color::White ? 2 : 0;
+                    _payload[2] = static_cast<uint8_t>(plies);
+                    _payload[3] = static_cast<uint8_t>(plies >> 8);
+                    return _writer.write(_payload.data(), static_cast<uint32_t>(_payload.size())) &&
+                        _records.write(header, _log);
+                }
+
+                Action _choose(Game& game, const uint16_t& ply)
+                {
+                    _visits.clear();
+                    if (_searcher)
+                    {
+                        Action best = _searcher->search(game, _config.depth);
+                        if (best != NULL_ACTION)
+                        {
+                            RootStat stat;
+                            stat.action = best;
+                            stat.visits = 1;
+                            stat.value = 0.0f;
+                            _visits.push_back(stat);
+                        }
+                        return best;
+                    }
+
+                    Action best = _mcts->search(game);
+                    _visits = _mcts->rootStats();
+                    if (best == NULL_ACTION || ply >= _config.samplingPlies)
+                        return best;
+
+                    uint64_t total = 0;
+                    for (const RootStat& stat : _visits)
+                        total += stat.visits;
+                    if (total == 0)
+                        return best;
+
+                    uint64_t pick = _rng.next() % total;
+                    for (const RootStat& stat : _visits)
+                    {
+                        if (pick < stat.visits)
+                            return stat.action;
+                        pick -= stat.visits;
+                    }
+                    return best;
+                }
+
+                const SelfPlayConfig& _config;
+                SizeType _id;
+                std::atomic<uint32_t>& _next; /**< Index of the next game to play. */
+                Rng _rng;
+                Playout _playout; /**< Picks the random placement drops. */
+                RolloutEvaluator _rollout;
+                StaticEvaluator _static;
+                std::unique_ptr<Mcts> _mcts;
+                std::unique_ptr<Searcher> _searcher;
+                RecordWriter _writer;
+                GameRecordWriter _records; /**< Game record file of the shard. */
+                GameLog _log; /**< Actions of the game being played. */
+                std::vector<uint8_t> _payload;
+                std::vector<RootStat> _visits;
+                bool _ok;
+        };
+    }
+
+    RecordWriter::RecordWriter()
+    : _file   (nullptr)
+    , _buffer (new uint8_t[RECORD_BUFFER])
+    , _used   (0)
+    {}
+
+    RecordWriter::~RecordWriter()
+    {
+        close();
+    }
+
+    bool RecordWriter::open(const std::string& path)
+    {
+        close();
+        _file = std::fopen(path.c_str(), "wb");
+        if (_file != nullptr)
+            std::setvbuf(_file, nullptr, _IONBF, 0);
+        return _file != nullptr;
+    }
+
+    bool RecordWriter::write(const uint8_t* data, const uint32_t& size)
+    {
+        if (_file == nullptr)
+            return false;
+
+        uint8_t prefix[4];
+        for (SizeType i = 0; i < 4; ++i)
+            prefix[i] = static_cast<uint8_t>(size >> (8 * i));
+
+        if (_used + sizeof (prefix) + size > RECORD_BUFFER && !(flush()))
+            return false;
+
+        // A record bigger than the buffer goes straight to the file.
+        if (sizeof (prefix) + size > RECORD_BUFFER)
+            return std::fwrite(prefix, 1, sizeof (prefix), _file) == sizeof (prefix) &&
+                std::fwrite(data, 1, size, _file) == size;
+
+        std::memcpy(_buffer.get() + _used, prefix, sizeof (prefix));
+        std::memcpy(_buffer.get() + _used + sizeof (prefix), data, size);
+        _used += sizeof (prefix) + size;
+        return true;
+    }
+
+    bool RecordWriter::flush()
+    {
+        if (_file == nullptr)
+            return false;
+
+        const bool written = std::fwrite(_buffer.get(), 1, _used, _file) == _used;
+        _used = 0;
+        return written;
+    }
+
+    bool RecordWriter::close()
+    {
+        if (_file == nullptr)
+            return true;
+
+        const bool flushed = flush();
+        const bool closed = std::fclose(_file) == 0;
+        _file = nullptr;
+        return flushed && closed;
+    }
+
+    void appendAction(std::vector<uint8_t>& out, const Action& action)
+    {
+        const uint8_t bytes[8] = {
+            static_cast<uint8_t>(action.type), action.index,
+            action.origin.x, action.origin.z, action.origin.y,
+            action.destination.x, action.destination.z, action.destination.y };
+        out.insert(out.end(), bytes, bytes + sizeof (bytes));
+    }
+
+    void appendPosition(std::vector<uint8_t>& out, const Game& game)
+    {
+        out.push_back(game.currentPlayer()->getColor() == Color::White ? 1 : 0);
+        out.push_back(game.playerOne()->getFullSet().Set.size() +
+                game.playerTwo()->getFullSet().Set.size());
+        appendPieces(out, *(game.playerOne()));
+        appendPieces(out, *(game.playerTwo()));
+    }
+
+    SelfPlayConfig::SelfPlayConfig()
+    : engine        (SelfPlayEngine::Mcts)
+    , games         (100)
+    , threads       (static_cast<SizeType>(std::min(255u,
+                    std::max(1u, std::thread::hardware_concurrency()))))
+    , playouts      (800)
+    , maxNodes      (1 << 20)
+    , rollouts      (false)
+    , depth         (2)
+    , maxPlies      (400)
+    , repetitions   (2)
+    , placements    (23)
+    , samplingPlies (30)
+    , seed          (0x5E1F91A7ull)
+    , prefix        ("selfplay")
+    , network       ()
+    {}
+
+    bool runSelfPlay(const SelfPlayConfig& config)
+    {
+        // The weights are mapped once and shared by every searcher.
+        Network network;
+        if (!(config.network.empty()) && !(network.load(config.network)))
+            return false;
+
+        std::atomic<uint32_t> next(0);
+        std::vector<std::unique_ptr<Worker>> workers;
+        const SizeType threads = std::max<SizeType>(config.threads, 1);
+        for (SizeType t = 0; t < threads; ++t)
+            workers.emplace_back(new Worker(config, t, next,
+                        network.loaded() ? &network : nullptr));
+
+        std::vector<std::thread> pool;
+        for (auto& worker : workers)
+            pool.emplace_back(&Worker::run, worker.get());
+
+        bool ok = true;
+        for (SizeType t = 0; t < threads; ++t)
+        {
+            pool[t].join();
+            ok = workers[t]->ok() && ok;
+        }
+        return ok;
+    }
+}
@@ -0,0 +1,370 @@
+/*
+ * Copyright 2016 Fermin, Yaneury <fermin.yaneury@gmail.com>
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cmath>
+#include <cstdio>
+#include <memory>
+
+#include <Analytics.hpp>
+#include <Notation.hpp>
+#include <Parallel.hpp>
+#include <Pattern.hpp>
+#include <Tuner.hpp>
+
+namespace Gungi
+{
+    namespace
+    {
+        constexpr double ADAM_BETA1       = 0.9;
+        constexpr double ADAM_BETA2       = 0.999;
+        constexpr double ADAM_EPSILON     = 1e-8;
+        constexpr double SCALE_LOW        = 1e-3; /**< Smallest scale fitScale() tries. */
+        constexpr double SCALE_HIGH       = 10; /**< Largest scale fitScale() tries. */
+        constexpr size_t SCALE_STEPS      = 48; /**< Golden section steps of fitScale(). */
+
+        /**
+         * Names of the rank constants by active piece code, the commander having none.
+         */
+        const char* const RANK_NAMES[TUNE_WEIGHTS] =
+        {
+            nullptr, "CAPTAIN_RANK", "SAMURAI_RANK", "NINJA_RANK", "CATAPULT_RANK",
+            "FORTRESS_RANK", "HIDDEN_DRAGON_RANK", "PRODIGY_RANK", "ARCHER_RANK",
+            "SOLDIER_RANK",
+            "PISTOL_RANK", "PIKE_RANK", "JOUNIN_RANK", "LANCE_RANK", "DRAGON_KING_RANK",
+            "PHOENIX_RANK", "ARROW_RANK", "GOLD_RANK", "SILVER_RANK", "BRONZE_RANK"
+        };
+
+        /**
+         * This function returns the score of a game for the player to move.
+         */
+        float targetOf(const Color& result, const Color& toMove)
+        {
+            if (result == Color::None)
+                return 0.5f;
+            return result == toMove ? 1.0f : 0.0f;
+        }
+
+        /**
+         * This function appends the position of a game to a set, as evaluate() sees it.
+         */
+        void addGame(const Game& game, const Color& result, TuneSet& set)
+        {
+            const Player* toMove = game.currentPlayer();
+            if (toMove == nullptr)
+                return;
+
+            int32_t counts[TUNE_WEIGHTS] = {};
+            for (const Player* player : { game.playerOne(), game.playerTwo() })
+            {
+                const int32_t sign = player == toMove ? 1 : -1;
+                const PieceSet& pieces = player->getFullSet();
+                for (SizeType i = 0; i < pieces.Set.size(); ++i)
+                {
+                    // A captured commander has no code and evaluate() gives it no value.
+                    const SizeType code = getPieceCode(pieces.pieceAt(i));
+                    if (code < TUNE_WEIGHTS)
+                        counts[code] += sign;
+                }
+            }
+            addSample(counts, targetOf(result, toMove->getColor()), set);
+        }
+
+        /**
+         * This function appends the positions of a store chunk to a set.
+         */
+        void addChunk(const PositionStore& store, const size_t& k, TuneSet& set)
+        {
+            const size_t count = store.chunkSize(k);
+            const uint8_t* toMove = store.toMove(k);
+            const uint8_t* results = store.results(k);
+            std::vector<TierColumns> tiers;
+            for (SizeType tier = 0; tier < BOARD_HEIGHT; ++tier)
+                tiers.emplace_back(store, k, tier);
+
+            for (size_t i = 0; i < count; ++i)
+            {
+                const Color side = static_cast<Color>(toMove[i]);
+                if (side == Color::None)
+                    continue;
+
+                // Counts are Black's less White's, flipped for White to move.
+                int32_t counts[TUNE_WEIGHTS] = {};
+                for (SizeType code = 0; code < PIECE_CODE_CT; ++code)
+                    counts[code] = store.hands(k, handColumn(Color::Black, code))[i] -
+                        store.hands(k, handColumn(Color::White, code))[i];
+
+                for (const TierColumns& columns : tiers)
+                {
+                    Bitboard occupied = columns.occupied(i);
+                    const Bitboard white = columns.white(i);
+                    while (!(occupied.empty()))
+                    {
+                        const uint32_t square = occupied.popLowest();
+                        counts[std::min(columns.codeAt(i, square), PIECE_CODE_CT)] +=
+                            white.test(square) ? -1 : 1;
+                    }
+                }
+
+                if (side == Color::White)
+                    for (int32_t& c : counts)
+                        c = -c;
+                addSample(counts, targetOf(static_cast<Color>(results[i]), side), set);
+            }
+        }
+
+        /**
+         * This function appends sets to a set, in order.
+         */
+        void appendSets(const std::vector<TuneSet>& parts, TuneSet& set)
+        {
+            for (const TuneSet& part : parts)
+            {
+                const uint64_t base = set.features.size();
+                set.features.insert(set.features.end(), part.features.begin(),
+                        part.features.end());
+                for (const uint64_t& end : part.ends)
+                    set.ends.push_back(base + end);
+                set.targets.insert(set.targets.end(), part.targets.begin(),
+                        part.targets.end());
+            }
+        }
+
+        /**
+         * This function sums the loss of the positions [begin, end) of a set and, when
+         * gradient isn't null, adds their gradient to it.
+         */
+        double sliceLoss(const TuneSet& set, const double* weights, const double& scale,
+                const size_t& begin, const size_t& end, double* gradient)
+        {
+            double loss = 0;
+            for (size_t i = begin; i < end; ++i)
+            {
+                const uint64_t first = i == 0 ? 0 : set.ends[i - 1];
+                double evaluation = 0;
+                for (uint64_t f = first; f < set.ends[i]; ++f)
+                    evaluation += weights[set.features[f].code] * set.features[f].count;
+
+                // log(1 + exp(z)) - t * z without overflow.
+                const double z = scale * evaluation;
+                const double target = set.targets[i];
+                loss += std::max(z, 0.0) + std::log1p(std::exp(-std::fabs(z))) - target * z;
+                if (gradient == nullptr)
+                    continue;
+
+                const double error = (1 / (1 + std::exp(-z)) - target) * scale;
+                for (uint64_t f = first; f < set.ends[i]; ++f)
+                    gradient[set.features[f].code] += error * set.features[f].count;
+            }
+            return loss;
+        }
+
+        /**
+         * This function sums the loss and the gradient of a set over threads, each thread
+         * taking a fixed slice.
+         */
+        double setLoss(const TuneSet& set, const double* weights, const double& scale,
+                const SizeType& threads, double* gradient)
+        {
+            const size_t size = set.targets.size();
+            std::vector<double> losses(threads, 0);
+            std::vector<std::vector<double>> gradients(threads,
+                    std::vector<double>(TUNE_WEIGHTS, 0));
+            parallelFor(threads, threads, [&] (const size_t& t)
+            {
+                losses[t] = sliceLoss(set, weights, scale, size * t / threads,
+                        size * (t + 1) / threads, gradient ? gradients[t].data() : nullptr);
+            });
+
+            double loss = 0;
+            for (SizeType t = 0; t < threads; ++t)
+            {
+                loss += losses[t];
+                for (size_t w = 0; gradient != nullptr && w < TUNE_WEIGHTS; ++w)
+                    gradient[w] += gradients[t][w];
+            }
+            return loss;
+        }
+    }
+
+    TuneConfig::TuneConfig()
+    : iterations (500)
+    , rate       (0.1)
+    , threads    (0)
+    {}
+
+    void addSample(const int32_t counts[TUNE_WEIGHTS], const float& target, TuneSet& set)
+    {
+        for (size_t code = 0; code < TUNE_WEIGHTS; ++code)
+            if (counts[code] != 0)
+                set.features.push_back({ static_cast<uint8_t>(code),
+                        static_cast<int8_t>(std::max(-128, std::min(127, counts[code]))) });
+        set.ends.push_back(set.features.size());
+        set.targets.push_back(target);
+    }
+
+    bool loadRecords(const std::vector<std::string>& paths, TuneSet& set, SizeType threads)
+    {
+        std::vector<std::unique_ptr<GameRecordReader>> readers;
+        std::vector<RecordChunk> chunks;
+        if (!(chunkRecords(paths, readers, chunks, TUNE_CHUNK)))
+            return false;
+
+        threads = std::max<SizeType>(1, std::min<size_t>(threadCount(threads),
+                    std::max<size_t>(chunks.size(), 1)));
+        std::vector<TuneSet> parts(chunks.size());
+        std::vector<std::unique_ptr<Game>> games;
+        for (SizeType t = 0; t < threads; ++t)
+            games.emplace_back(new Game());
+        std::unique_ptr<ActionList[]> actions(new ActionList[threads]);
+        parallelForWorkers(chunks.size(), threads, [&] (const SizeType& t, const size_t& c)
+        {
+            Game& game = *(games[t]);
+            const RecordChunk& chunk = chunks[c];
+            TuneSet& part = parts[c];
+            for (size_t g = chunk.first; g < chunk.first + chunk.count; ++g)
+            {
+                const RecordView record = (*(readers[chunk.file]))[g];
+                const RecordHeader header = record.header();
+                if (!(loadPacked(record.start(), game)))
+                    continue;
+
+                const size_t mark = part.targets.size();
+                const uint64_t featureMark = part.features.size();
+                // The position before a phase advance is the one after it.
+                for (uint16_t ply = 0; ; ++ply)
+                {
+                    const uint32_t code = ply < header.plies ? record.action(ply) : 0;
+                    if (ply == header.plies || code != PHASE_CODE)
+                        addGame(game, header.result, part);
+                    if (ply == header.plies)
+                        break;
+
+                    if (!(playCode(game, code, actions[t])))
+                    {
+                        part.targets.resize(mark);
+                        part.ends.resize(mark);
+                        part.features.resize(featureMark);
+                        break;
+                    }
+                }
+            }
+        });
+
+        appendSets(parts, set);
+        return true;
+    }
+
+    void loadStore(const PositionStore& store, TuneSet& set, SizeType threads)
+    {
+        threads = threadCount(threads);
+        std::vector<TuneSet> parts(store.chunkCount());
+        parallelFor(store.chunkCount(), threads, [&] (const size_t& k)
+        {
+            addChunk(store, k, parts[k]);
+        });
+        appendSets(parts, set);
+    }
+
+    void rankWeights(double weights[TUNE_WEIGHTS])
+    {
+        for (SizeType code = 0; code < TUNE_WEIGHTS; ++code)
+            weights[code] = codeValue(code);
+    }
+
+    double tuneLoss(const TuneSet& set, const double weights[TUNE_WEIGHTS], const double& scale,
+            SizeType threads)
+    {
+        if (set.targets.empty())
+            return 0;
+        return setLoss(set, weights, scale, threadCount(threads), nullptr) /
+            set.targets.size();
+    }
+
+    double fitScale(const TuneSet& set, const double weights[TUNE_WEIGHTS], SizeType threads)
+    {
+        // The loss is convex in the scale, searched on a log axis.
+        const double ratio = (std::sqrt(5.0) - 1) / 2;
+        double low = std::log(SCALE_LOW);
+        double high = std::log(SCALE_HIGH);
+        for (size_t step = 0; step < SCALE_STEPS; ++step)
+        {
+            const double left = high - ratio * (high - low);
+            const double right = low + ratio * (high - low);
+            if (tuneLoss(set, weights, std::exp(left), threads) <
+                    tuneLoss(set, weights, std::exp(right), threads))
+                high = right;
+            else
+                low = left;
+        }
+        return std::exp((low + high) / 2);
+    }
+
+    double tuneWeights(const TuneSet& set, double weights[TUNE_WEIGHTS], const double& scale,
+            const TuneConfig& config)
+    {
+        const SizeType threads = threadCount(config.threads);
+        const double size = std::max<size_t>(set.targets.size(), 1);
+        double moments[TUNE_WEIGHTS] = {};
+        double squares[TUNE_WEIGHTS] = {};
+        double loss = 0;
+        for (uint32_t step = 1; step <= config.iterations; ++step)
+        {
+            double gradient[TUNE_WEIGHTS] = {};
+            loss = setLoss(set, weights, scale, threads, gradient) / size;
+
+            const double unbias1 = 1 - std::pow(ADAM_BETA1, step);
+            const double unbias2 = 1 - std::pow(ADAM_BETA2, step);
+            for (size_t code = 1; code < TUNE_WEIGHTS; ++code)
+            {
+                const double g = gradient[code] / size;
+                moments[code] = ADAM_BETA1 * moments[code] + (1 - ADAM_BETA1) * g;
+                squares[code] = ADAM_BETA2 * squares[code] + (1 - ADAM_BETA2) * g * g;
+
+                // Ranks stay within what a SizeType holds.
+                weights[code] -= config.rate * (moments[code] / unbias1) /
+                    (std::sqrt(squares[code] / unbias2) + ADAM_EPSILON);
+                weights[code] = std::max(0.0, std::min(255.0, weights[code]));
+            }
+        }
+        return config.iterations != 0 ? tuneLoss(set, weights, scale, threads) : loss;
+    }
+
+    bool writeRankHeader(const std::string& path, const double weights[TUNE_WEIGHTS])
+    {
+        std::FILE* file = std::fopen(path.c_str(), "w");
+        if (file == nullptr)
+            return false;
+
+        std::fprintf(file, "/*\n * Generated by the tune tool, do not edit. Protocol.hpp "
+                "includes this file inside\n * namespace Gungi in place of its own rank "
+                "constants when built with\n * -DTUNED_RANKS=1.\n */\n\n#pragma once\n\n");
+        for (size_t code = 1; code < TUNE_WEIGHTS; ++code)
+        {
+            std::string name = pieceCodeName(static_cast<SizeType>(code));
+            std::replace(name.begin(), name.end(), '-', ' ');
+            const long rank = std::lround(weights[code]);
+            std::fprintf(file, "    constexpr SizeType %-21s = %ld; /**< Rank value of %s. */\n",
+                    RANK_NAMES[code], std::max(0L, std::min(255L, rank)), name.c_str());
+
+            if (code + 1 == FRONT_PCS_CT)
+                std::fprintf(file, "    constexpr SizeType %-21s = 0; /**< Indicates piece "
+                        "without head. */\n", "NO_HEAD");
+        }
+        std::fprintf(file, "    constexpr SizeType %-21s = 0; /**< Indicates piece without "
+                "tail. */\n", "NO_TAIL");
+        return std::fclose(file) == 0;
+    }
+}
@@ -0,0 +1,82 @@
+/*
+ * Copyright 2016 Fermin, Yaneury <fermin.yaneury@gmail.com>
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <Zobrist.hpp>
+
+namespace Gungi
+{
+    namespace
+    {
+        struct KeyTable
+        {
+            KeyTable()
+            {
+                uint64_t state = 0x9E3779B97F4A7C15ull;
+                for (auto& color : pieces)
+                    for (auto& kind : color)
+                        for (auto& key : kind)
+                            key = next(state);
+
+                for (auto& color : hands)
+                    for (auto& key : color)
+                        key = next(state);
+
+                side = next(state);
+            }
+
+            // splitmix64, good enough for hashing and deterministic across builds.
+            static uint64_t next(uint64_t& state)
+            {
+                uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+                z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+                z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+                return z ^ (z >> 31);
+            }
+
+            Key pieces[2][HAND_KIND_CT][BOARD_SQUARES * BOARD_HEIGHT];
+            Key hands[2][HAND_KIND_CT];
+            Key side;
+        };
+
+        const KeyTable& table()
+        {
+            static const KeyTable keys;
+            return keys;
+        }
+
+        SizeType colorIndex(const Color& color)
+        {
+            return color == Color::White ? 1 : 0;
+        }
+    }
+
+    Key pieceKey(const Piece& piece, const SmallPoint3& pt3)
+    {
+        return table().pieces[colorIndex(piece.getActiveColor())][getHandKind(piece)]
+            [pt3.y * BOARD_SQUARES + squareOf(pt3)];
+    }
+
+    Key handKey(const Color& owner, const SizeType& kind)
+    {
+        return table().hands[colorIndex(owner)][kind];
+    }
+
+    Key sideKey()
+    {
+        return table().side;
+    }
+}
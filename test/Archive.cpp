@@ -0,0 +1,158 @@
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include <sys/stat.h>
+
+#include <Archive.hpp>
+#include <Parallel.hpp>
+
+/**
+ * archive [-t threads] compress records archive
+ * archive [-t threads] extract archive records
+ * archive [-t threads] check records archive
+ * Codes a record file into an archive, decodes an archive back into a record file, or
+ * checks that every game of an archive decodes to the game of the same number in a record
+ * file: its header, start position and every action code.
+ */
+
+using std::cout;
+using std::cerr;
+using std::endl;
+using namespace Gungi;
+
+void usage()
+{
+    cerr << "usage: archive [-t threads] compress|extract|check path path" << endl;
+}
+
+/**
+ * Returns the size of a file, 0 if it can't be read.
+ */
+uint64_t fileSize(const std::string& path)
+{
+    struct stat info;
+    return ::stat(path.c_str(), &info) == 0 ? static_cast<uint64_t>(info.st_size) : 0;
+}
+
+/**
+ * Returns true if a decoded game is the recorded one.
+ */
+bool sameGame(const RecordView& record, const RecordHeader& header,
+        const PackedPosition& start, const std::vector<uint32_t>& actions)
+{
+    const RecordHeader expected = record.header();
+    if (header.id != expected.id || header.time != expected.time ||
+            header.plies != expected.plies || header.result != expected.result ||
+            header.termination != expected.termination || actions.size() != header.plies ||
+            std::memcmp(start.bytes, record.start().bytes, PACKED_SIZE) != 0)
+        return false;
+
+    for (uint16_t ply = 0; ply < header.plies; ++ply)
+        if (actions[ply] != record.action(ply))
+            return false;
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    SizeType threads = 0;
+    int at = 1;
+    if (at + 1 < argc && std::strcmp(argv[at], "-t") == 0)
+    {
+        threads = std::strtoul(argv[at + 1], nullptr, 10);
+        at += 2;
+    }
+
+    if (argc - at != 3)
+    {
+        usage();
+        return 1;
+    }
+
+    const std::string command = argv[at];
+    const std::string first = argv[at + 1];
+    const std::string second = argv[at + 2];
+
+    if (command == "compress")
+    {
+        GameRecordReader records;
+        if (!(records.open(first)))
+        {
+            cerr << "archive: couldn't open " << first << endl;
+            return 1;
+        }
+
+        if (!(writeArchive(records, second, threads)))
+        {
+            cerr << "archive: couldn't code every game into " << second << endl;
+            return 1;
+        }
+
+        const uint64_t before = fileSize(first);
+        const uint64_t after = fileSize(second);
+        cout << records.size() << " games, " << before << " bytes to " << after << " bytes";
+        if (after > 0)
+            cout << ", " << static_cast<double>(before) / after << "x";
+        cout << endl;
+        return 0;
+    }
+
+    if (command == "extract")
+    {
+        ArchiveReader archive;
+        GameRecordWriter writer;
+        if (!(archive.open(first)) || !(writer.open(second)))
+        {
+            cerr << "archive: couldn't open " << first << " or " << second << endl;
+            return 1;
+        }
+
+        if (!(extractArchive(archive, writer, threads)) || !(writer.close()))
+        {
+            cerr << "archive: couldn't extract every game of " << first << endl;
+            return 1;
+        }
+
+        cout << archive.size() << " games written to " << second << endl;
+        return 0;
+    }
+
+    if (command != "check")
+    {
+        usage();
+        return 1;
+    }
+
+    GameRecordReader records;
+    ArchiveReader archive;
+    if (!(records.open(first)) || !(archive.open(second)))
+    {
+        cerr << "archive: couldn't open " << first << " or " << second << endl;
+        return 1;
+    }
+
+    if (records.size() != archive.size())
+    {
+        cout << "game counts differ: " << records.size() << " recorded, " << archive.size()
+            << " archived" << endl;
+        return 2;
+    }
+
+    // Blocks decode independently, each thread takes a block at a time.
+    std::atomic<size_t> failed(0);
+    parallelFor(archive.blockCount(), threadCount(threads), [&] (const size_t& b)
+    {
+        RecordHeader header;
+        PackedPosition start;
+        std::vector<uint32_t> actions;
+        for (size_t i = archive.blockStart(b); i < archive.blockStart(b + 1); ++i)
+            if (!(archive.game(i, header, start, actions)) ||
+                    !(sameGame(records[i], header, start, actions)))
+                ++failed;
+    });
+
+    cout << archive.size() << " games, " << failed << " differ" << endl;
+    return failed == 0 ? 0 : 2;
+}
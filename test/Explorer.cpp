@@ -0,0 +1,142 @@
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include <sys/stat.h>
+
+#include <Explorer.hpp>
+#include <Replay.hpp>
+
+/**
+ * explorer build [-t threads] table path...
+ * explorer query table notation
+ * Builds a position table from record files, directories meaning every record file in
+ * them, or prints what a table knows of a position given in text notation.
+ */
+
+using std::cout;
+using std::cerr;
+using std::endl;
+using namespace Gungi;
+
+void usage()
+{
+    cerr << "usage: explorer build [-t threads] table path..." << endl;
+    cerr << "       explorer query table notation" << endl;
+}
+
+void printPoint(const SmallPoint3& pt3)
+{
+    if (isUnbounded(pt3))
+        cout << "hand";
+    else
+        cout << "(" << +pt3.x << ", " << +pt3.z << ", " << +pt3.y << ")";
+}
+
+int build(int argc, char** argv)
+{
+    SizeType threads = 0;
+    int i = 2;
+    if (i + 1 < argc && std::strcmp(argv[i], "-t") == 0)
+    {
+        threads = std::strtoul(argv[i + 1], nullptr, 10);
+        i += 2;
+    }
+
+    if (i + 1 >= argc)
+    {
+        usage();
+        return 1;
+    }
+
+    const std::string table = argv[i++];
+    std::vector<std::string> paths;
+    for (; i < argc; ++i)
+    {
+        struct stat info;
+        if (::stat(argv[i], &info) == 0 && S_ISDIR(info.st_mode))
+        {
+            if (!(listRecordFiles(argv[i], paths)))
+            {
+                cerr << "explorer: couldn't read " << argv[i] << endl;
+                return 1;
+            }
+        }
+        else
+            paths.push_back(argv[i]);
+    }
+
+    ExplorerBuild totals;
+    if (!(buildExplorer(paths, table, totals, threads)))
+    {
+        cerr << "explorer: couldn't build " << table << endl;
+        return 1;
+    }
+
+    cout << totals.games << " games, " << totals.skipped << " skipped, " << totals.positions
+        << " positions, " << totals.entries << " written to " << table << endl;
+    return 0;
+}
+
+int query(int argc, char** argv)
+{
+    if (argc != 4)
+    {
+        usage();
+        return 1;
+    }
+
+    Explorer explorer;
+    Game game;
+    ExplorerEntry entry;
+    if (!(explorer.open(argv[2])))
+    {
+        cerr << "explorer: couldn't open " << argv[2] << endl;
+        return 1;
+    }
+
+    if (!(readNotation(argv[3], std::strlen(argv[3]), game)))
+    {
+        cerr << "explorer: bad notation" << endl;
+        return 1;
+    }
+
+    if (!(explorer.find(game, entry)))
+    {
+        cout << "position not found" << endl;
+        return 0;
+    }
+
+    cout << "seen " << entry.count << " times, black "
+        << entry.results[static_cast<size_t>(Color::Black)] << ", white "
+        << entry.results[static_cast<size_t>(Color::White)] << ", undecided "
+        << entry.results[static_cast<size_t>(Color::None)] << endl;
+
+    static const char* const TYPES[] = { "none", "drop", "move", "immobile" };
+    for (size_t k = 0; k < entry.actionCt; ++k)
+    {
+        Action action;
+        if (!(decodeAction(game, entry.actions[k], action)))
+            continue;
+
+        const Piece& piece = game.currentPlayer()->getFullSet().pieceAt(action.index);
+        cout << TYPES[static_cast<size_t>(action.type)] << " piece " << +getPieceCode(piece)
+            << " ";
+        printPoint(action.origin);
+        cout << " -> ";
+        printPoint(action.destination);
+        cout << ": " << entry.actionCounts[k] << endl;
+    }
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc > 1 && std::strcmp(argv[1], "build") == 0)
+        return build(argc, argv);
+    if (argc > 1 && std::strcmp(argv[1], "query") == 0)
+        return query(argc, argv);
+
+    usage();
+    return 1;
+}
@@ -0,0 +1,107 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include <Heatmap.hpp>
+#include <Pattern.hpp>
+
+/**
+ * heatmap [-t threads] [-m min] archive...
+ * Counts every position of the games of the archives given and prints, as CSV, how often
+ * each piece kind stands on each square of each tier from its owner's side, the outcomes
+ * of those games for the owner and the lift of the owner's win rate over the baseline,
+ * then how often each square holds a tower at least as high as each tier. Cells seen fewer
+ * than min times (1 by default) are left out of the piece rows.
+ */
+
+using std::cout;
+using std::cerr;
+using std::endl;
+using namespace Gungi;
+
+void usage()
+{
+    cerr << "usage: heatmap [-t threads] [-m min] archive..." << endl;
+}
+
+int main(int argc, char** argv)
+{
+    SizeType threads = 0;
+    uint64_t least = 1;
+    int i = 1;
+    while (i + 1 < argc && argv[i][0] == '-')
+    {
+        if (std::strcmp(argv[i], "-t") == 0)
+            threads = std::strtoul(argv[i + 1], nullptr, 10);
+        else if (std::strcmp(argv[i], "-m") == 0)
+            least = std::max<uint64_t>(1, std::strtoull(argv[i + 1], nullptr, 10));
+        else
+            break;
+        i += 2;
+    }
+
+    if (i >= argc || argv[i][0] == '-')
+    {
+        usage();
+        return 1;
+    }
+
+    Heatmap map;
+    const auto begin = std::chrono::steady_clock::now();
+    for (; i < argc; ++i)
+    {
+        ArchiveReader archive;
+        if (!(archive.open(argv[i])))
+        {
+            cerr << "heatmap: couldn't open " << argv[i] << endl;
+            return 1;
+        }
+        buildHeatmap(archive, map, threads);
+    }
+    const double seconds = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - begin).count();
+
+    const uint64_t sides = map.sides[0] + map.sides[1] + map.sides[2];
+    const double baseline = sides != 0 ? static_cast<double>(map.sides[0]) / sides : 0;
+    cout << "piece,tier,x,z,count,wins,draws,losses,win rate,lift" << endl;
+    for (SizeType code = 0; code < PIECE_CODE_CT; ++code)
+    {
+        for (SizeType y = 0; y < BOARD_HEIGHT; ++y)
+        {
+            for (SizeType square = 0; square < BOARD_SQUARES; ++square)
+            {
+                const size_t cell = heatmapCell(code, y, square);
+                const uint64_t wins = map.cells[static_cast<size_t>(Outcome::Win)][cell];
+                const uint64_t draws = map.cells[static_cast<size_t>(Outcome::Draw)][cell];
+                const uint64_t losses = map.cells[static_cast<size_t>(Outcome::Loss)][cell];
+                const uint64_t count = wins + draws + losses;
+                if (count < least)
+                    continue;
+
+                const double rate = static_cast<double>(wins) / count;
+                cout << pieceCodeName(code) << "," << y + 1 << "," << square % BOARD_WIDTH
+                    << "," << square / BOARD_WIDTH << "," << count << "," << wins << ","
+                    << draws << "," << losses << "," << rate << "," << rate - baseline
+                    << endl;
+            }
+        }
+    }
+
+    cout << endl << "tier,x,z,towers,frequency" << endl;
+    for (SizeType y = 0; y < BOARD_HEIGHT; ++y)
+    {
+        for (SizeType square = 0; square < BOARD_SQUARES; ++square)
+        {
+            const uint64_t towers = map.towers[y * BOARD_SQUARES + square];
+            cout << y + 1 << "," << square % BOARD_WIDTH << "," << square / BOARD_WIDTH << ","
+                << towers << "," << (map.positions != 0 ?
+                        static_cast<double>(towers) / map.positions : 0) << endl;
+        }
+    }
+
+    cerr << map.games << " games, " << map.skipped << " skipped, " << map.positions
+        << " positions, " << seconds << " s" << endl;
+    return 0;
+}
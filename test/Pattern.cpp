@@ -0,0 +1,182 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include <sys/stat.h>
+
+#include <Analytics.hpp>
+#include <Pattern.hpp>
+#include <Replay.hpp>
+
+/**
+ * pattern build [-t threads] store path...
+ * pattern query [-t threads] [-l limit] store pattern
+ * pattern heights [-t threads] store
+ * pattern material [-t threads] store
+ * Builds a position store from record files, directories meaning every record file in
+ * them, prints the positions of a store matching a pattern, such as
+ * "black:fortress@1 white:archer@2", or prints the tower heights or the average material
+ * by ply of a store.
+ */
+
+using std::cout;
+using std::cerr;
+using std::endl;
+using namespace Gungi;
+
+void usage()
+{
+    cerr << "usage: pattern build [-t threads] store path..." << endl;
+    cerr << "       pattern query [-t threads] [-l limit] store pattern" << endl;
+    cerr << "       pattern heights [-t threads] store" << endl;
+    cerr << "       pattern material [-t threads] store" << endl;
+}
+
+int build(const SizeType& threads, int i, int argc, char** argv)
+{
+    if (i + 1 >= argc)
+    {
+        usage();
+        return 1;
+    }
+
+    const std::string store = argv[i++];
+    std::vector<std::string> paths;
+    for (; i < argc; ++i)
+    {
+        struct stat info;
+        if (::stat(argv[i], &info) == 0 && S_ISDIR(info.st_mode))
+        {
+            if (!(listRecordFiles(argv[i], paths)))
+            {
+                cerr << "pattern: couldn't read " << argv[i] << endl;
+                return 1;
+            }
+        }
+        else
+            paths.push_back(argv[i]);
+    }
+
+    if (!(buildPositionStore(paths, store, threads)))
+    {
+        cerr << "pattern: couldn't build " << store << endl;
+        return 1;
+    }
+
+    PositionStore positions;
+    positions.open(store);
+    cout << positions.size() << " positions written to " << store << endl;
+    return 0;
+}
+
+int query(const SizeType& threads, const uint64_t& limit, int i, int argc, char** argv)
+{
+    if (i + 2 != argc)
+    {
+        usage();
+        return 1;
+    }
+
+    PositionStore store;
+    Pattern pattern;
+    std::vector<CompiledClause> clauses;
+    if (!(store.open(argv[i])))
+    {
+        cerr << "pattern: couldn't open " << argv[i] << endl;
+        return 1;
+    }
+
+    if (!(parsePattern(argv[i + 1], pattern)) || !(compilePattern(pattern, clauses)))
+    {
+        cerr << "pattern: bad pattern" << endl;
+        return 1;
+    }
+
+    uint64_t printed = 0;
+    const auto begin = std::chrono::steady_clock::now();
+    const uint64_t matches = scanPattern(store, clauses,
+            [&] (const uint64_t* positions, const size_t& count)
+            {
+                for (size_t k = 0; k < count && printed < limit; ++k, ++printed)
+                    cout << positions[k] << endl;
+            }, threads);
+    const double seconds = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - begin).count();
+
+    cout << matches << " of " << store.size() << " positions match, " << seconds << " s"
+        << endl;
+    return 0;
+}
+
+int analyse(const SizeType& threads, const bool& heights, int i, int argc, char** argv)
+{
+    if (i + 1 != argc)
+    {
+        usage();
+        return 1;
+    }
+
+    PositionStore store;
+    if (!(store.open(argv[i])))
+    {
+        cerr << "pattern: couldn't open " << argv[i] << endl;
+        return 1;
+    }
+
+    const auto begin = std::chrono::steady_clock::now();
+    if (heights)
+    {
+        uint64_t counts[BOARD_HEIGHT + 1];
+        towerHeights(store, counts, threads);
+        for (SizeType h = 0; h <= BOARD_HEIGHT; ++h)
+            cout << "height " << static_cast<int>(h) << ": " << counts[h] << endl;
+    }
+    else
+    {
+        std::vector<MaterialPoint> curve;
+        materialCurve(store, curve, threads);
+        for (size_t ply = 0; ply < curve.size(); ++ply)
+        {
+            const double positions = std::max<uint64_t>(curve[ply].positions, 1);
+            cout << ply << " " << curve[ply].positions << " "
+                << curve[ply].material[0] / positions << " "
+                << curve[ply].material[1] / positions << endl;
+        }
+    }
+    const double seconds = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - begin).count();
+
+    cout << store.size() << " positions, " << seconds << " s" << endl;
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    SizeType threads = 0;
+    uint64_t limit = 20;
+    int i = 2;
+    while (i + 1 < argc && argv[i][0] == '-')
+    {
+        if (std::strcmp(argv[i], "-t") == 0)
+            threads = std::strtoul(argv[i + 1], nullptr, 10);
+        else if (std::strcmp(argv[i], "-l") == 0)
+            limit = std::strtoull(argv[i + 1], nullptr, 10);
+        else
+            break;
+        i += 2;
+    }
+
+    if (argc > 1 && std::strcmp(argv[1], "build") == 0)
+        return build(threads, i, argc, argv);
+    if (argc > 1 && std::strcmp(argv[1], "query") == 0)
+        return query(threads, limit, i, argc, argv);
+    if (argc > 1 && std::strcmp(argv[1], "heights") == 0)
+        return analyse(threads, true, i, argc, argv);
+    if (argc > 1 && std::strcmp(argv[1], "material") == 0)
+        return analyse(threads, false, i, argc, argv);
+
+    usage();
+    return 1;
+}
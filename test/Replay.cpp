@@ -0,0 +1,82 @@
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include <sys/stat.h>
+
+#include <Replay.hpp>
+
+/**
+ * replay [-t threads] [-q] path...
+ * Replays every game of the record files given, directories meaning every record file in
+ * them, and prints the failing games, the results and the throughput.
+ */
+
+using std::cout;
+using std::cerr;
+using std::endl;
+using namespace Gungi;
+
+void usage()
+{
+    cerr << "usage: replay [-t threads] [-q] path..." << endl;
+}
+
+int main(int argc, char** argv)
+{
+    SizeType threads = 0;
+    bool quiet = false;
+    std::vector<std::string> paths;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const char* arg = argv[i];
+        struct stat info;
+        if (std::strcmp(arg, "-q") == 0)
+            quiet = true;
+        else if (std::strcmp(arg, "-t") == 0 && i + 1 < argc)
+            threads = std::strtoul(argv[++i], nullptr, 10);
+        else if (arg[0] == '-')
+        {
+            usage();
+            return 1;
+        }
+        else if (::stat(arg, &info) == 0 && S_ISDIR(info.st_mode))
+        {
+            if (!(listRecordFiles(arg, paths)))
+            {
+                cerr << "replay: couldn't read " << arg << endl;
+                return 1;
+            }
+        }
+        else
+            paths.push_back(arg);
+    }
+
+    if (paths.empty())
+    {
+        usage();
+        return 1;
+    }
+
+    ReplayReport report;
+    if (!(replayFiles(paths, report, threads)))
+    {
+        cerr << "replay: couldn't open every record file" << endl;
+        return 1;
+    }
+
+    if (!(quiet))
+        for (const ReplayIssue& issue : report.issues)
+            cout << paths[issue.file] << " game " << issue.game << " id " << issue.id
+                << " ply " << issue.ply << ": " << replayStatusName(issue.status) << endl;
+
+    cout << report.files << " files, " << report.games << " games, " << report.plies
+        << " plies, " << report.valid << " valid, " << report.issues.size() << " failed" << endl;
+    cout << "black " << report.results[static_cast<size_t>(Color::Black)] << ", white "
+        << report.results[static_cast<size_t>(Color::White)] << ", undecided "
+        << report.results[static_cast<size_t>(Color::None)] << endl;
+    cout << report.seconds << " s, " << (report.seconds > 0 ? report.plies / report.seconds : 0)
+        << " plies/s" << endl;
+    return report.issues.empty() ? 0 : 2;
+}
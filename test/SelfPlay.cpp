@@ -0,0 +1,83 @@
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include <SelfPlay.hpp>
+
+/**
+ * selfplay [-g games] [-t threads] [-e mcts|ab] [-p playouts] [-n nodes] [-r]
+ *          [-d depth] [-m maxPlies] [-s seed] [-o prefix] [-w weights]
+ * Plays games on a thread pool and writes one record shard and one game record file per
+ * thread. Alpha-beta scores positions with the network of the weight file when one is given.
+ */
+
+using std::cout;
+using std::cerr;
+using std::endl;
+using namespace Gungi;
+
+void usage()
+{
+    cerr << "usage: selfplay [-g games] [-t threads] [-e mcts|ab] [-p playouts] [-n nodes]"
+        << " [-r] [-d depth] [-m maxPlies] [-s seed] [-o prefix] [-w weights]" << endl;
+}
+
+int main(int argc, char** argv)
+{
+    SelfPlayConfig config;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const char* flag = argv[i];
+        if (std::strcmp(flag, "-r") == 0)
+        {
+            config.rollouts = true;
+            continue;
+        }
+
+        if (i + 1 >= argc)
+        {
+            usage();
+            return 1;
+        }
+
+        const char* value = argv[++i];
+        if (std::strcmp(flag, "-g") == 0)
+            config.games = std::strtoul(value, nullptr, 10);
+        else if (std::strcmp(flag, "-t") == 0)
+            config.threads = std::strtoul(value, nullptr, 10);
+        else if (std::strcmp(flag, "-e") == 0 && std::strcmp(value, "mcts") == 0)
+            config.engine = SelfPlayEngine::Mcts;
+        else if (std::strcmp(flag, "-e") == 0 && std::strcmp(value, "ab") == 0)
+            config.engine = SelfPlayEngine::AlphaBeta;
+        else if (std::strcmp(flag, "-p") == 0)
+            config.playouts = std::strtoul(value, nullptr, 10);
+        else if (std::strcmp(flag, "-n") == 0)
+            config.maxNodes = std::strtoull(value, nullptr, 10);
+        else if (std::strcmp(flag, "-d") == 0)
+            config.depth = std::strtoul(value, nullptr, 10);
+        else if (std::strcmp(flag, "-m") == 0)
+            config.maxPlies = std::strtoul(value, nullptr, 10);
+        else if (std::strcmp(flag, "-s") == 0)
+            config.seed = std::strtoull(value, nullptr, 10);
+        else if (std::strcmp(flag, "-o") == 0)
+            config.prefix = value;
+        else if (std::strcmp(flag, "-w") == 0)
+            config.network = value;
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+
+    if (!(runSelfPlay(config)))
+    {
+        cerr << "selfplay: couldn't load the weights or write the shards of " << config.prefix
+            << endl;
+        return 1;
+    }
+
+    cout << config.games << " games written to " << config.prefix << "-*.bin and .rec" << endl;
+    return 0;
+}
@@ -0,0 +1,110 @@
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include <sys/stat.h>
+
+#include <Pattern.hpp>
+#include <Replay.hpp>
+#include <Tuner.hpp>
+
+/**
+ * tune [-t threads] [-i iterations] [-r rate] [-o header] path...
+ * Loads the positions of position stores and record files, directories meaning every record
+ * file in them, labels them with the results of their games and tunes the rank values of
+ * the evaluation to them. The tuned ranks are written as a header for Protocol.hpp,
+ * TunedRanks.hpp by default; build with -DTUNED_RANKS=1 and the header on the include path
+ * to use them.
+ */
+
+using std::cout;
+using std::cerr;
+using std::endl;
+using namespace Gungi;
+
+void usage()
+{
+    cerr << "usage: tune [-t threads] [-i iterations] [-r rate] [-o header] path..." << endl;
+}
+
+int main(int argc, char** argv)
+{
+    TuneConfig config;
+    std::string header = "TunedRanks.hpp";
+    int i = 1;
+    while (i + 1 < argc && argv[i][0] == '-')
+    {
+        if (std::strcmp(argv[i], "-t") == 0)
+            config.threads = std::strtoul(argv[i + 1], nullptr, 10);
+        else if (std::strcmp(argv[i], "-i") == 0)
+            config.iterations = std::strtoul(argv[i + 1], nullptr, 10);
+        else if (std::strcmp(argv[i], "-r") == 0)
+            config.rate = std::strtod(argv[i + 1], nullptr);
+        else if (std::strcmp(argv[i], "-o") == 0)
+            header = argv[i + 1];
+        else
+            break;
+        i += 2;
+    }
+
+    if (i >= argc || argv[i][0] == '-')
+    {
+        usage();
+        return 1;
+    }
+
+    // Stores are loaded as they come, record files together.
+    TuneSet set;
+    std::vector<std::string> records;
+    const auto begin = std::chrono::steady_clock::now();
+    for (; i < argc; ++i)
+    {
+        struct stat info;
+        PositionStore store;
+        if (::stat(argv[i], &info) == 0 && S_ISDIR(info.st_mode))
+        {
+            if (!(listRecordFiles(argv[i], records)))
+            {
+                cerr << "tune: couldn't read " << argv[i] << endl;
+                return 1;
+            }
+        }
+        else if (store.open(argv[i]))
+            loadStore(store, set, config.threads);
+        else
+            records.push_back(argv[i]);
+    }
+
+    if (!(records.empty()) && !(loadRecords(records, set, config.threads)))
+    {
+        cerr << "tune: couldn't open the record files" << endl;
+        return 1;
+    }
+
+    if (set.targets.empty())
+    {
+        cerr << "tune: no positions" << endl;
+        return 1;
+    }
+
+    double weights[TUNE_WEIGHTS];
+    rankWeights(weights);
+    const double scale = fitScale(set, weights, config.threads);
+    const double before = tuneLoss(set, weights, scale, config.threads);
+    const double after = tuneWeights(set, weights, scale, config);
+    const double seconds = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - begin).count();
+
+    for (SizeType code = 1; code < TUNE_WEIGHTS; ++code)
+        cout << pieceCodeName(code) << " " << weights[code] << endl;
+    cout << set.targets.size() << " positions, scale " << scale << ", loss " << before
+        << " -> " << after << ", " << seconds << " s" << endl;
+
+    if (!(writeRankHeader(header, weights)))
+    {
+        cerr << "tune: couldn't write " << header << endl;
+        return 1;
+    }
+    return 0;
+}